@@ -0,0 +1,1866 @@
+#include "btree.h"
+#include "btree_concurrent.h"
+#include "btree_fixed.h"
+#include "btree_frozen.h"
+#include "btree_paged.h"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <sys/resource.h>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+// Throughput benchmark for BTree insert/remove
+// usage: ./bench_btree [t] [n] [ops]
+//   t   minimum degree of the tree (default 16)
+//   n   number of keys inserted before the mixed phase (default 1000000)
+//   ops number of operations in the mixed phase, half inserts and half removes (default 1000000)
+// usage: ./bench_btree fixed [t] [n] [ops]
+//   runs the insert, mixed and remove phases on BTree and on AnyBTree (compile-time degree when t is 2, 3, 4, 8, 16, 32 or 64)
+// usage: ./bench_btree image [t] [n]
+//   times save_image, open_image with and without checksum verification, lookups on the mapping and the first write
+// usage: ./bench_btree load [t] [n]
+//   writes a random tree in the level-order text format and times loading it with BTree(filename)
+// usage: ./bench_btree dump [t] [n]
+//   times dump() in both formats against one stream operation per key, the way print() used to write
+// usage: ./bench_btree purge [t] [n] [m]
+//   removes the same m sorted random keys (default n/10) from two copies of an n-key tree, one remove() at a time and with remove_many
+// usage: ./bench_btree range [t] [n] [m]
+//   removes one contiguous range of m keys (default n/10) from a generated n-key tree with a loop of remove(),
+//   with remove_many and with remove_range
+// usage: ./bench_btree concurrent [t] [n] [ops]
+//   runs ops operations spread over 1 .. 64 threads on ConcurrentBTree and on a BTree behind one mutex,
+//   read-only, 90% reads and 50% inserts / 50% removes, on a tree preloaded with n keys
+// usage: ./bench_btree snapshot [t] [n] [ops]
+//   times snapshot() and ops random removes with no snapshot, one snapshot held throughout and a fresh snapshot every
+//   100 removes, and reports how many nodes the removes had to copy
+// usage: ./bench_btree rank
+//   times every rank kernel find_k can use on a single full node, for t = 2 .. 1024
+// usage: ./bench_btree suite [t] [n] [ops]
+//   generates an n-key tree and runs the regression scenarios on it: build_tree, dump, lookups, random, sequential
+//   and zipfian removes, find_k per degree. Also writes one row per scenario to bench_results.tsv with ops/s,
+//   latency percentiles and peak RSS
+// usage: ./bench_btree lazy [t] [n] [ops] [budget]
+//   remove latency percentiles with eager and lazy remove, then compact() with budget keys per call until no
+//   tombstone is left (one latency sample per call)
+// usage: ./bench_btree frozen [t] [n] [ops]
+//   times freeze(), ops random contains() and a full range scan on a generated n-key tree and on its frozen copy,
+//   then save/load of the frozen copy and thawing it back into a BTree, and prints the memory of both
+// usage: ./bench_btree order [t] [n] [ops]
+//   random inserts and removes with and without order statistics, then ops rank/select/count_range calls against
+//   counting the same ranges with an iterator, and the pool memory of both trees
+// usage: ./bench_btree paged [t] [n] [ops]
+//   inserts n random keys into a PagedBTree file (t = 0 picks the largest degree for 4 KiB pages), then runs ops
+//   random lookups and ops/10 removes with pools of 1%, 10% and 100% of its pages and prints the buffer pool counters
+// usage: ./bench_btree buffered [t] [n] [ops] [per_node]
+//   ops random removes, then ops random inserts, on an n-key tree without and with buffered updates (per_node messages
+//   per buffer, 0 picks 16t), then flush_messages() and ops contains() calls with the messages still pending, and
+//   nodes visited per update when built with -DBTREE_STATS
+// usage: ./bench_btree bulk [t] [n] [threads]
+//   builds a tree from n sorted keys with n single inserts in ascending and in random order, and with bulk_load at
+//   fill factors 1.0 and 0.7 on one thread and on threads threads (default every hardware thread), and prints the
+//   height and bytes per key of each tree
+// usage: ./bench_btree values [n] [ops]
+//   degree 16 FixedBTree: n inserts and ops lookups of 16 byte records kept in an unordered_map next to the tree
+//   against records stored with their keys, then inserts and lookups of 25 byte string keys as std::string and as
+//   PrefixKey, once with distinct first bytes and once with a 9 byte prefix shared by every key
+// usage: ./bench_btree delete [t] [n] [ops]
+//   for each delete policy (strict, min_fill t/4, merge_at_empty without and with rebuilds below 40% fill): ops
+//   random removes (about half miss) each followed by a random insert on an n-key tree, then removes 90% of the
+//   keys, and prints throughput, node count, average fill and pool memory after each phase
+// usage: ./bench_btree split [t] [n] [ops]
+//   ops times: split_at a random key of an n-key tree and join the halves back, against cutting and merging by
+//   reading the keys out and bulk_load-ing the halves and the whole tree again, then splits the tree into 16
+//   shards and joins them back, with node count and pool memory before and after
+// usage: ./bench_btree memory [t] [n] [ops]
+//   bytes per key of an n-key tree built by random inserts and by bulk_load (slab memory and the blocks of the nodes,
+//   leaves take smaller blocks), then of frozen copies with plain and frame-of-reference keys for keys 1, 1000 and
+//   100000 apart on average (8-, 16- and 32-bit offsets, the gap shrinks until n keys fit in an int), with ops
+//   random contains() on each
+// usage: ./bench_btree generate t n filename
+//   writes a valid tree of degree t with the keys 0 .. n-1 in the level-order text format
+// Results are printed and also written to bench_output.txt
+
+using bench_clock = std::chrono::steady_clock;
+
+// Helper: seconds elapsed since start
+double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Helper: print one result line to both outputs
+void report(std::ostream &out, const std::string &name, long long ops, double secs)
+{
+    std::ostringstream line;
+    line << name << "\t" << ops << " ops\t" << secs << " s\t" << (long long)(ops / secs) << " ops/s\n";
+    std::cout << line.str();
+    out << line.str();
+}
+
+// Time every rank kernel on one full node (2t-1 keys) per degree t
+int bench_rank()
+{
+    std::ofstream out("bench_output.txt");
+    std::vector<RankKernel> kernels = rank_kernels();
+    std::cout << "node_rank uses " << node_rank_kernel() << "\n";
+    out << "node_rank uses " << node_rank_kernel() << "\n";
+
+    const int queries = 1 << 20;
+    std::mt19937 rng(271);
+    for (int t = 2; t <= 1024; t *= 2)
+    {
+        int n = 2 * t - 1;
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; i++)
+        {
+            keys[i] = 2 * i;
+        }
+        std::uniform_int_distribution<int> key(-1, 2 * n);
+        std::vector<int> qs(queries);
+        for (int &q : qs)
+        {
+            q = key(rng);
+        }
+
+        long long expected = -1;
+        for (const RankKernel &kernel : kernels)
+        {
+            long long sum = 0;
+            auto start = bench_clock::now();
+            for (int q : qs)
+            {
+                sum += kernel.fn(keys.data(), n, q);
+            }
+            double secs = seconds_since(start);
+            if (expected >= 0 && sum != expected)
+            {
+                std::cerr << "Error: kernel " << kernel.name << " disagrees at t=" << t << "\n";
+                return 1;
+            }
+            expected = sum;
+            report(out, "rank t=" + std::to_string(t) + " " + kernel.name, queries, secs);
+        }
+    }
+    return 0;
+}
+
+// Insert, mixed and remove phases on any tree type with insert/remove/contains
+template <typename Tree>
+void bench_updates(Tree &tree, std::ostream &out, const std::string &label, long long n, long long ops)
+{
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    std::bernoulli_distribution is_insert(0.5);
+
+    auto start = bench_clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        tree.insert(key(rng));
+    }
+    report(out, label + " insert", n, seconds_since(start));
+
+    start = bench_clock::now();
+    for (long long i = 0; i < ops; i++)
+    {
+        if (is_insert(rng))
+            tree.insert(key(rng));
+        else
+            tree.remove(key(rng));
+    }
+    report(out, label + " mixed", ops, seconds_since(start));
+
+    long long hits = 0;
+    start = bench_clock::now();
+    for (long long i = 0; i < ops; i++)
+    {
+        hits += tree.contains(key(rng));
+    }
+    report(out, label + " contains", ops, seconds_since(start));
+
+    start = bench_clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        tree.remove(key(rng));
+    }
+    report(out, label + " remove", n, seconds_since(start));
+}
+
+// Same workload on the runtime-degree and the compile-time-degree tree
+int bench_fixed(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    BTree plain(t);
+    bench_updates(plain, out, "BTree", n, ops);
+    AnyBTree fixed(t);
+    bench_updates(fixed, out, fixed.specialized() ? "FixedBTree" : "AnyBTree (fallback)", n, ops);
+    return 0;
+}
+
+// Save a random tree as a binary image and time opening and using it
+int bench_image(int t, long long n)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << "\n";
+    std::cout << "t=" << t << " n=" << n << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    const std::string filename = "bench_image.bin";
+    {
+        BTree tree(t);
+        for (long long i = 0; i < n; i++)
+        {
+            tree.insert(key(rng));
+        }
+        auto start = bench_clock::now();
+        tree.save_image(filename);
+        report(out, "save_image", 1, seconds_since(start));
+    }
+
+    for (bool verify : {true, false})
+    {
+        BTree tree(t);
+        auto start = bench_clock::now();
+        tree.open_image(filename, verify);
+        report(out, verify ? "open_image verify" : "open_image", 1, seconds_since(start));
+
+        start = bench_clock::now();
+        long long hits = 0;
+        for (long long i = 0; i < n; i++)
+        {
+            hits += tree.contains(key(rng));
+        }
+        report(out, "mapped contains", n, seconds_since(start));
+
+        start = bench_clock::now();
+        tree.insert(key(rng)); // first write materializes the image
+        report(out, "materialize", 1, seconds_since(start));
+    }
+    std::remove(filename.c_str());
+    return 0;
+}
+
+// Write a random tree in the level-order text format and time loading it
+int bench_load(int t, long long n)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << "\n";
+    std::cout << "t=" << t << " n=" << n << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    const std::string filename = "bench_tree.txt";
+    {
+        BTree tree(t);
+        for (long long i = 0; i < n; i++)
+        {
+            tree.insert(key(rng));
+        }
+        std::ofstream file(filename);
+        tree.dump(file, DumpFormat::Loader);
+    }
+
+    auto start = bench_clock::now();
+    BTree loaded(filename);
+    report(out, "build_tree", n, seconds_since(start));
+    std::remove(filename.c_str());
+    return 0;
+}
+
+// Time dump() in both formats, and one stream operation per key as a reference
+int bench_dump(int t, long long n)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << "\n";
+    std::cout << "t=" << t << " n=" << n << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    BTree tree(t);
+    for (long long i = 0; i < n; i++)
+    {
+        tree.insert(key(rng));
+    }
+
+    auto start = bench_clock::now();
+    std::ostringstream per_key;
+    for (int k : tree)
+    {
+        per_key << k << ",";
+    }
+    report(out, "per-key <<", n, seconds_since(start));
+
+    start = bench_clock::now();
+    std::ostringstream debug;
+    tree.dump(debug, DumpFormat::Debug);
+    report(out, "dump debug ostream", n, seconds_since(start));
+
+    const std::string filename = "bench_dump.txt";
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    start = bench_clock::now();
+    tree.dump(fd, DumpFormat::Loader);
+    report(out, "dump loader fd", n, seconds_since(start));
+    close(fd);
+    std::remove(filename.c_str());
+    return 0;
+}
+
+// Remove one batch of sorted keys with a loop of remove() and with one remove_many
+int bench_purge(int t, long long n, long long m)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " m=" << m << "\n";
+    std::cout << "t=" << t << " n=" << n << " m=" << m << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    std::vector<int> keys(n);
+    for (int &k : keys)
+    {
+        k = key(rng);
+    }
+    std::vector<int> batch(m);
+    for (int &k : batch)
+    {
+        k = key(rng);
+    }
+    std::sort(batch.begin(), batch.end());
+
+    BTree one_by_one(t);
+    BTree batched(t);
+    for (int k : keys)
+    {
+        one_by_one.insert(k);
+        batched.insert(k);
+    }
+
+    auto start = bench_clock::now();
+    for (int k : batch)
+    {
+        one_by_one.remove(k);
+    }
+    report(out, "remove loop", m, seconds_since(start));
+
+    start = bench_clock::now();
+    size_t removed = batched.remove_many(batch);
+    report(out, "remove_many", m, seconds_since(start));
+    std::cout << removed << " keys were in the tree\n";
+    return 0;
+}
+
+// BTree shared between threads the simple way: one mutex around every operation
+struct MutexBTree
+{
+    BTree tree;
+    std::mutex m;
+
+    MutexBTree(int t) : tree(t) {}
+    void insert(int k)
+    {
+        std::lock_guard<std::mutex> guard(m);
+        tree.insert(k);
+    }
+    void remove(int k)
+    {
+        std::lock_guard<std::mutex> guard(m);
+        tree.remove(k);
+    }
+    bool contains(int k)
+    {
+        std::lock_guard<std::mutex> guard(m);
+        return tree.contains(k);
+    }
+};
+
+// Preload n keys, then run ops operations split over 1 .. 64 threads, read_pct percent of them lookups
+template <typename Tree>
+void bench_threads(std::ostream &out, const std::string &label, int t, long long n, long long ops, int read_pct)
+{
+    for (int threads = 1; threads <= 64; threads *= 2)
+    {
+        Tree tree(t);
+        std::mt19937 rng(271);
+        std::uniform_int_distribution<int> key(0, (int)(2 * n));
+        for (long long i = 0; i < n; i++)
+        {
+            tree.insert(key(rng));
+        }
+
+        std::vector<std::thread> workers;
+        std::atomic<long long> hits(0);
+        auto start = bench_clock::now();
+        for (int w = 0; w < threads; w++)
+        {
+            workers.emplace_back([&tree, &hits, w, threads, n, ops, read_pct]() {
+                std::mt19937 rng(1000 + w);
+                std::uniform_int_distribution<int> key(0, (int)(2 * n));
+                std::uniform_int_distribution<int> pct(0, 99);
+                long long found = 0;
+                for (long long i = w; i < ops; i += threads)
+                {
+                    int op = pct(rng);
+                    if (op < read_pct)
+                        found += tree.contains(key(rng));
+                    else if (op % 2 == 0)
+                        tree.insert(key(rng));
+                    else
+                        tree.remove(key(rng));
+                }
+                hits += found;
+            });
+        }
+        for (std::thread &w : workers)
+        {
+            w.join();
+        }
+        report(out, label + " reads=" + std::to_string(read_pct) + "% threads=" + std::to_string(threads), ops,
+               seconds_since(start));
+    }
+}
+
+// Scaling of ConcurrentBTree against one mutex around a BTree
+int bench_concurrent(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << " hardware threads=" << std::thread::hardware_concurrency() << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << " hardware threads=" << std::thread::hardware_concurrency() << "\n";
+
+    for (int read_pct : {100, 90, 0})
+    {
+        bench_threads<ConcurrentBTree>(out, "ConcurrentBTree", t, n, ops, read_pct);
+        bench_threads<MutexBTree>(out, "BTree+mutex", t, n, ops, read_pct);
+    }
+    return 0;
+}
+
+// Remove ops random keys from an n-key tree while snapshots keep old versions alive
+// refresh: take a new snapshot every refresh removes (0: none, -1: one snapshot for the whole run)
+void bench_snapshot_removes(std::ostream &out, const std::string &label, int t, long long n, long long ops, long long refresh)
+{
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    BTree tree(t);
+    for (long long i = 0; i < n; i++)
+    {
+        tree.insert(key(rng));
+    }
+    std::vector<int> victims(ops);
+    for (int &k : victims)
+    {
+        k = key(rng);
+    }
+
+    std::vector<BTree::Snapshot> held;
+    if (refresh < 0)
+    {
+        held.push_back(tree.snapshot());
+    }
+    size_t nodes_before = tree.node_count();
+    auto start = bench_clock::now();
+    for (long long i = 0; i < ops; i++)
+    {
+        if (refresh > 0 && i % refresh == 0)
+        {
+            held.push_back(tree.snapshot());
+        }
+        tree.remove(victims[i]);
+    }
+    double secs = seconds_since(start);
+    report(out, label, ops, secs);
+
+    std::ostringstream line;
+    line << "  nodes " << nodes_before << " -> " << tree.node_count() << ", "
+         << double(tree.node_count()) / nodes_before << "x memory, " << double(tree.node_count() - std::min(tree.node_count(), nodes_before)) / ops
+         << " nodes kept per remove\n";
+    std::cout << line.str();
+    out << line.str();
+}
+
+// Cost of snapshot() and the write amplification it causes
+int bench_snapshot(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    {
+        BTree tree(t);
+        std::mt19937 rng(271);
+        std::uniform_int_distribution<int> key(0, (int)(2 * n));
+        for (long long i = 0; i < n; i++)
+        {
+            tree.insert(key(rng));
+        }
+        const long long snaps = 1000000;
+        auto start = bench_clock::now();
+        for (long long i = 0; i < snaps; i++)
+        {
+            BTree::Snapshot snap = tree.snapshot();
+        }
+        report(out, "snapshot+drop", snaps, seconds_since(start));
+    }
+
+    bench_snapshot_removes(out, "remove, no snapshot", t, n, ops, 0);
+    bench_snapshot_removes(out, "remove, one snapshot", t, n, ops, -1);
+    bench_snapshot_removes(out, "remove, snapshot every 100", t, n, ops, 100);
+    return 0;
+}
+
+// Write a valid tree of minimum degree t holding the keys 0, gap, 2*gap, .. (n keys) in the level-order text format
+// The height is the smallest that fits n keys, every node splits its keys as evenly as it can among
+// as few children as the degree allows, so the levels are written one at a time without building the tree.
+// Precondition: t >= 2, n >= 0, gap >= 1 and (n-1)*gap fits in an int
+// Postcondition: returns true if filename holds the tree, BTree(filename) loads it
+
+bool generate_tree(const std::string &filename, int t, long long n, int gap)
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Error: cannot write " << filename << "\n";
+        return false;
+    }
+    file << t;
+
+    // max_keys[h]: most keys a subtree of height h can hold, (2t)^(h+1) - 1
+    std::vector<long long> max_keys = {2LL * t - 1};
+    while (max_keys.back() < n)
+    {
+        max_keys.push_back((max_keys.back() + 1) * 2 * t - 1);
+    }
+
+    // one level of subtrees as (first key index, number of keys)
+    std::vector<std::pair<long long, long long>> level;
+    std::vector<std::pair<long long, long long>> next;
+    if (n > 0)
+    {
+        level.push_back({0, n});
+    }
+    std::string line;
+    char num[16];
+    const int top = (int)max_keys.size() - 1;
+    for (int h = top; h >= 0 && !level.empty(); h--)
+    {
+        line += '\n';
+        next.clear();
+        for (size_t s = 0; s < level.size(); s++)
+        {
+            auto [lo, m] = level[s];
+            if (s > 0)
+                line += '-';
+            // a leaf holds its keys, an internal node keeps one key between each pair of children
+            long long children = 1;
+            if (h > 0)
+            {
+                long long fits = max_keys[h - 1] + 1;
+                children = std::max<long long>(h == top ? 2 : t, (m + fits) / fits);
+            }
+            long long child_keys = m - (children - 1);
+            long long pos = lo;
+            for (long long j = 0; j < children; j++)
+            {
+                long long share = child_keys / children + (j < child_keys % children ? 1 : 0);
+                if (h == 0)
+                {
+                    for (long long k = pos; k < pos + share; k++)
+                    {
+                        if (k > lo)
+                            line += ',';
+                        line.append(num, std::to_chars(num, num + sizeof(num), (int)(k * gap)).ptr);
+                    }
+                    break;
+                }
+                next.push_back({pos, share});
+                pos += share;
+                if (j + 1 < children)
+                {
+                    if (j > 0)
+                        line += ',';
+                    line.append(num, std::to_chars(num, num + sizeof(num), (int)(pos * gap)).ptr);
+                    pos++; // the key between child j and child j+1
+                }
+            }
+            if (line.size() > (1 << 20))
+            {
+                file << line;
+                line.clear();
+            }
+        }
+        level.swap(next);
+    }
+    file << line;
+    return bool(file);
+}
+
+// Zipfian ranks in [0, n) with skew theta (Gray et al., "Quickly generating billion-record synthetic databases")
+// Rank 0 is the most frequent, ranks are scattered over the key space by the caller.
+class ZipfGenerator
+{
+private:
+    long long n;
+    double theta, alpha, zetan, eta;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+
+public:
+    ZipfGenerator(long long n, double theta) : n(n), theta(theta)
+    {
+        zetan = 0;
+        for (long long i = 1; i <= n; i++)
+        {
+            zetan += 1.0 / std::pow((double)i, theta);
+        }
+        double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    long long operator()(std::mt19937 &rng)
+    {
+        double u = uniform(rng);
+        double uz = u * zetan;
+        if (uz < 1.0)
+            return 0;
+        if (uz < 1.0 + std::pow(0.5, theta))
+            return 1;
+        return std::min(n - 1, (long long)(n * std::pow(eta * u - eta + 1.0, alpha)));
+    }
+};
+
+// One scenario of the suite: throughput, latency percentiles and the process's peak RSS so far
+struct SuiteResult
+{
+    std::string scenario;
+    int t;
+    long long n;
+    long long ops;
+    double secs;
+    std::vector<double> latency_ns; // one sample per op or per batch of ops, may be empty
+};
+
+// Helper: p-th percentile (0..100) of sorted samples
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t i = std::min(sorted.size() - 1, (size_t)(p / 100.0 * sorted.size()));
+    return sorted[i];
+}
+
+// Helper: append one result row to the tab-separated results file and a readable line to the other outputs
+void report_row(std::ostream &tsv, std::ostream &out, SuiteResult &r)
+{
+    std::sort(r.latency_ns.begin(), r.latency_ns.end());
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long peak_rss_kb = usage.ru_maxrss; // kilobytes on Linux
+
+    tsv << r.scenario << "\t" << r.t << "\t" << r.n << "\t" << r.ops << "\t" << r.secs << "\t"
+        << (long long)(r.ops / r.secs) << "\t" << percentile(r.latency_ns, 50) << "\t" << percentile(r.latency_ns, 90)
+        << "\t" << percentile(r.latency_ns, 99) << "\t" << percentile(r.latency_ns, 99.9) << "\t"
+        << (r.latency_ns.empty() ? 0 : r.latency_ns.back()) << "\t" << peak_rss_kb << "\n";
+
+    report(out, r.scenario + " t=" + std::to_string(r.t), r.ops, r.secs);
+    if (!r.latency_ns.empty())
+    {
+        std::ostringstream line;
+        line << "  p50 " << percentile(r.latency_ns, 50) << " ns  p99 " << percentile(r.latency_ns, 99) << " ns  p99.9 "
+             << percentile(r.latency_ns, 99.9) << " ns  max " << r.latency_ns.back() << " ns  peak RSS " << peak_rss_kb
+             << " KB\n";
+        std::cout << line.str();
+        out << line.str();
+    }
+}
+
+// Remove every key of victims from a freshly loaded copy of the generated tree, timing each remove
+SuiteResult suite_removes(const std::string &scenario, const std::string &filename, int t, long long n,
+                          const std::vector<int> &victims)
+{
+    BTree tree(filename);
+    SuiteResult r{scenario, t, n, (long long)victims.size(), 0, {}};
+    r.latency_ns.reserve(victims.size());
+    auto start = bench_clock::now();
+    for (int k : victims)
+    {
+        auto op_start = bench_clock::now();
+        tree.remove(k);
+        r.latency_ns.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - op_start).count());
+    }
+    r.secs = seconds_since(start);
+    return r;
+}
+
+// Repeatable scenarios on a generated tree, results go to bench_results.tsv
+int bench_suite(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    std::ofstream tsv("bench_results.tsv");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    tsv << "scenario\tt\tn\tops\tseconds\tops_per_sec\tp50_ns\tp90_ns\tp99_ns\tp999_ns\tmax_ns\tpeak_rss_kb\n";
+
+    // keys 0, 2, 4, ..: odd keys are never in the tree
+    const std::string filename = "bench_suite_tree.txt";
+    auto start = bench_clock::now();
+    if (!generate_tree(filename, t, n, 2))
+    {
+        return 1;
+    }
+    SuiteResult gen{"generate", t, n, n, seconds_since(start), {}};
+    report_row(tsv, out, gen);
+
+    start = bench_clock::now();
+    {
+        BTree loaded(filename);
+        SuiteResult load{"build_tree", t, n, n, seconds_since(start), {}};
+        report_row(tsv, out, load);
+
+        int fd = open("/dev/null", O_WRONLY);
+        start = bench_clock::now();
+        loaded.dump(fd, DumpFormat::Loader);
+        SuiteResult dump{"dump", t, n, n, seconds_since(start), {}};
+        report_row(tsv, out, dump);
+        close(fd);
+
+        // lookups in batches of 64, one latency sample per batch
+        std::mt19937 rng(271);
+        std::uniform_int_distribution<int> key(0, (int)(2 * n));
+        SuiteResult lookups{"contains", t, n, ops, 0, {}};
+        long long hits = 0;
+        start = bench_clock::now();
+        for (long long i = 0; i < ops; i += 64)
+        {
+            auto batch_start = bench_clock::now();
+            for (long long j = i; j < std::min(ops, i + 64); j++)
+            {
+                hits += loaded.contains(key(rng));
+            }
+            lookups.latency_ns.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - batch_start).count() /
+                                         (std::min(ops, i + 64) - i));
+        }
+        lookups.secs = seconds_since(start);
+        report_row(tsv, out, lookups);
+    }
+
+    long long m = std::min(ops, n);
+    std::mt19937 rng(271);
+    std::vector<int> victims(m);
+    std::uniform_int_distribution<long long> index(0, n - 1);
+    for (int &k : victims)
+    {
+        k = (int)(2 * index(rng));
+    }
+    SuiteResult random_removes = suite_removes("remove random", filename, t, n, victims);
+    report_row(tsv, out, random_removes);
+
+    for (long long i = 0; i < m; i++)
+    {
+        victims[i] = (int)(2 * i);
+    }
+    SuiteResult sequential_removes = suite_removes("remove sequential", filename, t, n, victims);
+    report_row(tsv, out, sequential_removes);
+
+    // hot keys are removed early, later draws of them miss like they would in a real purge
+    ZipfGenerator zipf(n, 0.99);
+    for (int &k : victims)
+    {
+        long long rank = zipf(rng);
+        k = (int)(2 * ((rank * 2654435761LL) % n));
+    }
+    SuiteResult zipf_removes = suite_removes("remove zipfian", filename, t, n, victims);
+    report_row(tsv, out, zipf_removes);
+    std::remove(filename.c_str());
+
+    // find_k on one full node per degree, batches of 256 ranks per latency sample
+    const int queries = 1 << 20;
+    for (int d = 2; d <= 1024; d *= 2)
+    {
+        int keys_n = 2 * d - 1;
+        std::vector<int> keys(keys_n);
+        for (int i = 0; i < keys_n; i++)
+        {
+            keys[i] = 2 * i;
+        }
+        std::uniform_int_distribution<int> key(-1, 2 * keys_n);
+        std::vector<int> qs(queries);
+        for (int &q : qs)
+        {
+            q = key(rng);
+        }
+        SuiteResult rank{std::string("find_k ") + node_rank_kernel(), d, keys_n, queries, 0, {}};
+        long long sum = 0;
+        start = bench_clock::now();
+        for (int i = 0; i < queries; i += 256)
+        {
+            auto batch_start = bench_clock::now();
+            for (int j = i; j < i + 256; j++)
+            {
+                sum += node_rank(keys.data(), keys_n, qs[j]);
+            }
+            rank.latency_ns.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - batch_start).count() / 256);
+        }
+        rank.secs = seconds_since(start);
+        if (sum < 0)
+        {
+            return 1; // keeps the loop from being optimized away
+        }
+        report_row(tsv, out, rank);
+    }
+    std::cout << "results written to bench_results.tsv\n";
+    return 0;
+}
+
+// Remove latency with eager and lazy remove, and the cost of compacting the tombstones budget keys at a time
+int bench_lazy(int t, long long n, long long ops, long long budget)
+{
+    std::ofstream out("bench_output.txt");
+    std::ofstream tsv("bench_results.tsv");
+    out << "t=" << t << " n=" << n << " ops=" << ops << " budget=" << budget << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << " budget=" << budget << "\n";
+    tsv << "scenario\tt\tn\tops\tseconds\tops_per_sec\tp50_ns\tp90_ns\tp99_ns\tp999_ns\tmax_ns\tpeak_rss_kb\n";
+
+    const std::string filename = "bench_lazy_tree.txt";
+    if (!generate_tree(filename, t, n, 1))
+    {
+        return 1;
+    }
+    std::mt19937 rng(271);
+    std::vector<int> victims(std::min(ops, n));
+    std::uniform_int_distribution<long long> index(0, n - 1);
+    for (int &k : victims)
+    {
+        k = (int)index(rng);
+    }
+
+    SuiteResult eager = suite_removes("remove eager", filename, t, n, victims);
+    report_row(tsv, out, eager);
+
+    BTree tree(filename);
+    tree.set_lazy_remove(true);
+    SuiteResult lazy{"remove lazy", t, n, (long long)victims.size(), 0, {}};
+    auto start = bench_clock::now();
+    for (int k : victims)
+    {
+        auto op_start = bench_clock::now();
+        tree.remove(k);
+        lazy.latency_ns.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - op_start).count());
+    }
+    lazy.secs = seconds_since(start);
+    report_row(tsv, out, lazy);
+
+    // one latency sample per compact() call, ops counts the tombstones it removed
+    SuiteResult compaction{"compact budget=" + std::to_string(budget), t, n, (long long)tree.tombstone_count(), 0, {}};
+    start = bench_clock::now();
+    while (tree.tombstone_count() > 0)
+    {
+        auto call_start = bench_clock::now();
+        tree.compact(budget);
+        compaction.latency_ns.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - call_start).count());
+    }
+    compaction.secs = seconds_since(start);
+    report_row(tsv, out, compaction);
+    std::remove(filename.c_str());
+    return 0;
+}
+
+// Remove one contiguous range of m keys with a loop of remove(), with remove_many and with remove_range
+int bench_range(int t, long long n, long long m)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " m=" << m << "\n";
+    std::cout << "t=" << t << " n=" << n << " m=" << m << "\n";
+
+    const std::string filename = "bench_range_tree.txt";
+    if (!generate_tree(filename, t, n, 1))
+    {
+        return 1;
+    }
+    int lo = (int)(n / 4);
+    int hi = (int)(n / 4 + m); // remove_range(lo, hi) removes [lo, hi)
+    std::vector<int> batch;
+    for (long long k = lo; k < hi; k++)
+    {
+        batch.push_back((int)k);
+    }
+
+    {
+        BTree tree(filename);
+        auto start = bench_clock::now();
+        for (int k : batch)
+        {
+            tree.remove(k);
+        }
+        report(out, "remove loop", m, seconds_since(start));
+    }
+    {
+        BTree tree(filename);
+        auto start = bench_clock::now();
+        tree.remove_many(batch);
+        report(out, "remove_many", m, seconds_since(start));
+    }
+    {
+        BTree tree(filename);
+        size_t before = tree.node_count();
+        auto start = bench_clock::now();
+        size_t removed = tree.remove_range(lo, hi);
+        report(out, "remove_range", m, seconds_since(start));
+        std::cout << removed << " keys removed, " << before - tree.node_count() << " nodes freed\n";
+    }
+    std::remove(filename.c_str());
+    return 0;
+}
+
+int bench_frozen(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    const std::string filename = "bench_frozen_tree.txt";
+    if (!generate_tree(filename, t, n, 2)) // even keys, so about half the probes miss
+    {
+        return 1;
+    }
+    BTree tree(filename);
+    std::remove(filename.c_str());
+
+    auto start = bench_clock::now();
+    FrozenBTree frozen = tree.freeze();
+    report(out, "freeze", n, seconds_since(start));
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    std::vector<int> probes(ops);
+    for (int &k : probes)
+    {
+        k = key(rng);
+    }
+    long long hits = 0;
+    start = bench_clock::now();
+    for (int k : probes)
+    {
+        hits += tree.contains(k);
+    }
+    report(out, "btree contains", ops, seconds_since(start));
+    long long frozen_hits = 0;
+    start = bench_clock::now();
+    for (int k : probes)
+    {
+        frozen_hits += frozen.contains(k);
+    }
+    report(out, "frozen contains", ops, seconds_since(start));
+
+    long long sum = 0;
+    start = bench_clock::now();
+    for (int k : tree)
+    {
+        sum += k;
+    }
+    report(out, "btree scan", n, seconds_since(start));
+    long long frozen_sum = 0;
+    start = bench_clock::now();
+    for (int k : frozen.keys())
+    {
+        frozen_sum += k;
+    }
+    report(out, "frozen scan", n, seconds_since(start));
+
+    const std::string frozen_file = "bench_frozen.bin";
+    start = bench_clock::now();
+    frozen.save(frozen_file);
+    report(out, "frozen save", n, seconds_since(start));
+    FrozenBTree loaded;
+    start = bench_clock::now();
+    loaded.load(frozen_file);
+    report(out, "frozen load", n, seconds_since(start));
+    std::remove(frozen_file.c_str());
+    start = bench_clock::now();
+    BTree thawed(loaded, t);
+    report(out, "thaw", n, seconds_since(start));
+
+    std::ostringstream memory;
+    memory << "btree " << tree.stats().bytes << " bytes, frozen " << frozen.bytes() << " bytes\n";
+    std::cout << memory.str();
+    out << memory.str();
+    if (hits != frozen_hits || sum != frozen_sum || loaded.size() != frozen.size())
+    {
+        std::cerr << "frozen tree disagrees with the btree\n";
+        return 1;
+    }
+    return 0;
+}
+
+int bench_order(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    std::vector<int> keys(n);
+    for (int &k : keys)
+    {
+        k = key(rng);
+    }
+
+    BTree plain(t);
+    BTree counted(t);
+    counted.set_order_stats(true);
+    for (BTree *tree : {&plain, &counted})
+    {
+        std::string label = tree == &plain ? "plain" : "counted";
+        auto start = bench_clock::now();
+        for (int k : keys)
+        {
+            tree->insert(k);
+        }
+        report(out, label + " insert", n, seconds_since(start));
+        start = bench_clock::now();
+        for (long long i = 0; i < n / 2; i++)
+        {
+            tree->remove(keys[i]);
+        }
+        report(out, label + " remove", n / 2, seconds_since(start));
+    }
+
+    std::vector<int> probes(ops);
+    for (int &k : probes)
+    {
+        k = key(rng);
+    }
+    size_t total = counted.count_range(INT_MIN, INT_MAX);
+    long long sum = 0;
+    auto start = bench_clock::now();
+    for (int k : probes)
+    {
+        sum += counted.rank(k);
+    }
+    report(out, "rank", ops, seconds_since(start));
+    start = bench_clock::now();
+    for (int k : probes)
+    {
+        sum += *counted.select((size_t)k % total);
+    }
+    report(out, "select", ops, seconds_since(start));
+
+    // ranges of about 1% of the keys, counted from the subtree counts and by walking an iterator
+    int width = (int)(2 * n / 100);
+    long long fast = 0;
+    start = bench_clock::now();
+    for (int k : probes)
+    {
+        fast += counted.count_range(k, k + width);
+    }
+    report(out, "count_range", ops, seconds_since(start));
+    long long walk_ops = std::min<long long>(ops, 10000);
+    long long fast_prefix = 0;
+    for (long long i = 0; i < walk_ops; i++)
+    {
+        fast_prefix += counted.count_range(probes[i], probes[i] + width);
+    }
+    long long walked = 0;
+    start = bench_clock::now();
+    for (long long i = 0; i < walk_ops; i++)
+    {
+        for (auto it = plain.lower_bound(probes[i]); it != plain.end() && *it < probes[i] + width; ++it)
+        {
+            walked++;
+        }
+    }
+    report(out, "iterator count", walk_ops, seconds_since(start));
+
+    std::ostringstream memory;
+    memory << "plain " << plain.stats().bytes << " bytes, counted " << counted.stats().bytes << " bytes\n";
+    std::cout << memory.str();
+    out << memory.str();
+    if (walked != fast_prefix || sum == 0 || fast < 0)
+    {
+        std::cerr << "count_range disagrees with the iterator\n";
+        return 1;
+    }
+    return 0;
+}
+
+int bench_paged(int t, long long n, long long ops)
+{
+    if (t == 0)
+    {
+        t = PagedBTree::degree_for_page(4096);
+    }
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    const std::string filename = "bench_paged.bin";
+    std::remove(filename.c_str());
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    uint64_t pages;
+    {
+        PagedBTree tree(filename, t, 1024);
+        auto start = bench_clock::now();
+        for (long long i = 0; i < n; i++)
+        {
+            tree.insert(key(rng));
+        }
+        tree.flush();
+        report(out, "insert pool=1024", n, seconds_since(start));
+        pages = tree.page_count();
+    }
+
+    std::vector<int> probes(ops);
+    for (int &k : probes)
+    {
+        k = key(rng);
+    }
+    long long removed_from = 0; // every pool size removes keys the earlier ones did not
+    for (int percent : {1, 10, 100})
+    {
+        size_t frames = std::max<size_t>(pages * percent / 100, 8);
+        std::string label = "pool=" + std::to_string(frames);
+        PagedBTree tree(filename, t, frames);
+        long long hits = 0;
+        auto start = bench_clock::now();
+        for (int k : probes)
+        {
+            hits += tree.contains(k);
+        }
+        report(out, label + " contains", ops, seconds_since(start));
+        BufferPoolStats lookups = tree.stats();
+        tree.reset_stats();
+        start = bench_clock::now();
+        for (long long i = 0; i < ops / 10; i++)
+        {
+            tree.remove(probes[removed_from + i]);
+        }
+        removed_from += ops / 10;
+        tree.flush();
+        report(out, label + " remove", ops / 10, seconds_since(start));
+        BufferPoolStats removes = tree.stats();
+
+        std::ostringstream line;
+        line << label << " lookups: hit ratio " << double(lookups.hits) / double(lookups.hits + lookups.misses)
+             << ", reads " << lookups.reads << "; removes: hit ratio "
+             << double(removes.hits) / double(removes.hits + removes.misses) << ", reads " << removes.reads
+             << ", writes " << removes.writes << "\n";
+        std::cout << line.str();
+        out << line.str();
+    }
+    std::cout << pages << " pages of " << (pages > 0 ? std::filesystem::file_size(filename) / pages : 0) << " bytes\n";
+    std::remove(filename.c_str());
+    return 0;
+}
+
+// Random removes and inserts with and without buffered updates (set_buffered), then lookups against the pending messages
+int bench_buffered(int t, long long n, long long ops, long long per_node)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << " per_node=" << per_node << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << " per_node=" << per_node << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    std::vector<int> keys(n);
+    for (int &k : keys)
+    {
+        k = key(rng);
+    }
+    std::vector<int> updates(ops);
+    for (int &k : updates)
+    {
+        k = key(rng);
+    }
+
+    BTree plain(t);
+    BTree buffered(t);
+    for (int k : keys)
+    {
+        plain.insert(k);
+        buffered.insert(k);
+    }
+    buffered.set_buffered(true, per_node);
+
+    std::vector<bool> found[2];
+    for (BTree *tree : {&plain, &buffered})
+    {
+        std::string label = tree == &plain ? "plain" : "buffered";
+        reset_op_counters();
+        auto start = bench_clock::now();
+        for (int k : updates)
+        {
+            tree->remove(k);
+        }
+        report(out, label + " remove", ops, seconds_since(start));
+        start = bench_clock::now();
+        for (int k : updates)
+        {
+            tree->insert(k + 1);
+        }
+        report(out, label + " insert", ops, seconds_since(start));
+        OpCounters counters = op_counters();
+        if (counters.enabled)
+        {
+            std::ostringstream line;
+            line << label << " nodes visited per update "
+                 << double(counters.count[NODES_VISITED]) / double(std::max(2 * ops, 1LL)) << "\n";
+            std::cout << line.str();
+            out << line.str();
+        }
+
+        // lookups read the highest pending message for the key before the nodes
+        std::vector<bool> &hits = found[tree == &buffered];
+        start = bench_clock::now();
+        for (int k : keys)
+        {
+            hits.push_back(tree->contains(k));
+        }
+        report(out, label + " contains", n, seconds_since(start));
+    }
+
+    std::ostringstream pending;
+    pending << buffered.pending_messages() << " messages pending\n";
+    std::cout << pending.str();
+    out << pending.str();
+    auto start = bench_clock::now();
+    buffered.flush_messages();
+    report(out, "flush_messages", ops, seconds_since(start));
+
+    std::vector<int> a(plain.begin(), plain.end());
+    std::vector<int> b(buffered.begin(), buffered.end());
+    if (a != b || found[0] != found[1])
+    {
+        std::cerr << "buffered tree disagrees with the plain tree\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Building a tree from sorted keys with single inserts and with bulk_load
+int bench_bulk(int t, long long n, unsigned threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " threads=" << threads << "\n";
+    std::cout << "t=" << t << " n=" << n << " threads=" << threads << "\n";
+
+    std::vector<int> sorted(n);
+    for (long long i = 0; i < n; i++)
+    {
+        sorted[i] = (int)(2 * i);
+    }
+    std::vector<int> shuffled = sorted;
+    std::mt19937 rng(271);
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    // Helper: one line with the shape of the tree just built
+    auto shape = [&](const std::string &label, BTree &tree) {
+        TreeStats s = tree.stats();
+        std::ostringstream line;
+        line << label << ": height " << s.height << ", " << double(s.bytes) / double(std::max<size_t>(s.keys, 1))
+             << " bytes per key\n";
+        std::cout << line.str();
+        out << line.str();
+    };
+
+    for (const std::vector<int> *order : {&sorted, &shuffled})
+    {
+        std::string label = order == &sorted ? "insert ascending" : "insert random";
+        BTree tree(t);
+        auto start = bench_clock::now();
+        for (int k : *order)
+        {
+            tree.insert(k);
+        }
+        report(out, label, n, seconds_since(start));
+        shape(label, tree);
+    }
+    for (double fill : {1.0, 0.7})
+    {
+        for (unsigned workers : {1u, threads})
+        {
+            std::ostringstream label;
+            label << "bulk_load fill=" << fill << " threads=" << workers;
+            BTree tree(t);
+            auto start = bench_clock::now();
+            tree.bulk_load(sorted, fill, workers);
+            report(out, label.str(), n, seconds_since(start));
+            shape(label.str(), tree);
+            if (workers == threads)
+            {
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+// a 16 byte record, small enough to sit in the node next to its key
+struct BenchRecord
+{
+    long long id;
+    double score;
+};
+
+int bench_values(long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=16 n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=16 n=" << n << " ops=" << ops << "\n";
+
+    std::mt19937 rng(314);
+    std::vector<int> keys(n);
+    for (long long i = 0; i < n; i++)
+    {
+        keys[i] = (int)(2 * i);
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::vector<int> probes(ops);
+    for (long long i = 0; i < ops; i++)
+    {
+        probes[i] = keys[rng() % n];
+    }
+
+    // keys in the tree, records in a hash map next to it: every lookup searches twice
+    {
+        FixedBTree<int, 16> tree;
+        std::unordered_map<int, BenchRecord> records;
+        auto start = bench_clock::now();
+        for (int k : keys)
+        {
+            tree.insert(k);
+            records[k] = BenchRecord{k, k * 0.5};
+        }
+        report(out, "insert keys + side map", n, seconds_since(start));
+        double sum = 0;
+        start = bench_clock::now();
+        for (int k : probes)
+        {
+            if (tree.contains(k))
+            {
+                sum += records.find(k)->second.score;
+            }
+        }
+        report(out, "lookup keys + side map", ops, seconds_since(start));
+        out << "(checksum " << sum << ")\n";
+    }
+    // records stored with their keys
+    {
+        FixedBTree<int, 16, BenchRecord> tree;
+        auto start = bench_clock::now();
+        for (int k : keys)
+        {
+            tree.insert(k, BenchRecord{k, k * 0.5});
+        }
+        report(out, "insert key/value", n, seconds_since(start));
+        double sum = 0;
+        start = bench_clock::now();
+        for (int k : probes)
+        {
+            if (BenchRecord *r = tree.find(k))
+            {
+                sum += r->score;
+            }
+        }
+        report(out, "lookup key/value", ops, seconds_since(start));
+        out << "(checksum " << sum << ")\n";
+    }
+
+    // string keys too long for the small string buffer of std::string, as std::string and as PrefixKey: first with
+    // distinct leading bytes (prefix compares decide), then with a shared 9 byte prefix (every compare reads the tail)
+    for (bool shared : {false, true})
+    {
+        // Helper: the string key for the int key k
+        auto name = [shared](int k) {
+            char hex[17];
+            std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)k * 0x9E3779B97F4A7C15ull);
+            return shared ? "user:1000/" + std::string(hex) : std::string(hex) + "/profile";
+        };
+        std::vector<std::string> names(n);
+        for (long long i = 0; i < n; i++)
+        {
+            names[i] = name(keys[i]);
+        }
+        std::vector<std::string> probe_names(ops);
+        for (long long i = 0; i < ops; i++)
+        {
+            probe_names[i] = name(probes[i]);
+        }
+        std::string kind = shared ? " (shared prefix)" : " (distinct prefix)";
+        {
+            FixedBTree<std::string, 16> tree;
+            auto start = bench_clock::now();
+            for (const std::string &s : names)
+            {
+                tree.insert(s);
+            }
+            report(out, "insert std::string" + kind, n, seconds_since(start));
+            long long found = 0;
+            start = bench_clock::now();
+            for (const std::string &s : probe_names)
+            {
+                found += tree.contains(s);
+            }
+            report(out, "lookup std::string" + kind, ops, seconds_since(start));
+            out << "(found " << found << ")\n";
+        }
+        {
+            FixedBTree<PrefixKey, 16> tree;
+            auto start = bench_clock::now();
+            for (const std::string &s : names)
+            {
+                tree.insert(PrefixKey(s));
+            }
+            report(out, "insert PrefixKey" + kind, n, seconds_since(start));
+            long long found = 0;
+            start = bench_clock::now();
+            for (const std::string &s : probe_names)
+            {
+                found += tree.contains(PrefixKey::view(s));
+            }
+            report(out, "lookup PrefixKey" + kind, ops, seconds_since(start));
+            out << "(found " << found << ")\n";
+        }
+    }
+    return 0;
+}
+
+int bench_delete(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    std::vector<int> keys(n);
+    for (int &k : keys)
+    {
+        k = key(rng);
+    }
+    std::vector<int> updates(ops); // about half of the removes miss
+    for (int &k : updates)
+    {
+        k = key(rng);
+    }
+    std::vector<int> shrink = keys; // then remove 90% of the keys in random order
+    std::shuffle(shrink.begin(), shrink.end(), rng);
+    shrink.resize(n * 9 / 10);
+
+    struct Policy
+    {
+        std::string label;
+        DeletePolicy policy;
+        int min_keys;
+        double rebuild_below;
+    };
+    std::vector<Policy> policies = {
+        {"strict", DeletePolicy::Strict, 0, 0.0},
+        {"min_fill " + std::to_string(std::max(1, t / 4)), DeletePolicy::MinFill, std::max(1, t / 4), 0.0},
+        {"merge_at_empty", DeletePolicy::MergeAtEmpty, 1, 0.0},
+        {"merge_at_empty rebuild<0.4", DeletePolicy::MergeAtEmpty, 1, 0.4},
+    };
+
+    // Helper: one line with the node count and fill of the tree, the pool keeps its slabs so bytes only grow
+    auto shape = [&](const std::string &label, BTree &tree) {
+        TreeStats s = tree.stats();
+        std::ostringstream line;
+        line << label << ": height " << s.height << ", " << s.nodes << " nodes, "
+             << 100.0 * double(s.keys) / double(std::max<size_t>(s.nodes, 1) * (2 * t - 1)) << "% full, "
+             << s.bytes / 1024 << " KiB pool, " << tree.rebuild_count() << " rebuilds\n";
+        std::cout << line.str();
+        out << line.str();
+    };
+
+    for (const Policy &p : policies)
+    {
+        BTree tree(t);
+        for (int k : keys)
+        {
+            tree.insert(k);
+        }
+        tree.set_delete_policy(p.policy, p.min_keys, p.rebuild_below);
+
+        auto start = bench_clock::now();
+        for (int k : updates)
+        {
+            tree.remove(k);
+            tree.insert(key(rng));
+        }
+        report(out, p.label + " churn remove+insert", 2 * ops, seconds_since(start));
+        shape(p.label + " after churn", tree);
+
+        start = bench_clock::now();
+        for (int k : shrink)
+        {
+            tree.remove(k);
+        }
+        report(out, p.label + " remove 90%", (long long)shrink.size(), seconds_since(start));
+        shape(p.label + " after remove 90%", tree);
+    }
+    return 0;
+}
+
+int bench_split(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    std::mt19937 rng(271);
+    std::vector<int> keys(n);
+    for (long long i = 0; i < n; i++)
+    {
+        keys[i] = (int)(2 * i); // sorted, every other int, so a split key may or may not be in the tree
+    }
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+    BTree tree(t);
+    tree.bulk_load(keys);
+
+    // Helper: node count and pool memory of the tree
+    auto shape = [&](const std::string &label) {
+        TreeStats s = tree.stats();
+        std::ostringstream line;
+        line << label << ": " << s.keys << " keys, height " << s.height << ", " << tree.node_count() << " nodes, "
+             << s.bytes / 1024 << " KiB pool\n";
+        std::cout << line.str();
+        out << line.str();
+    };
+    shape("before");
+
+    auto start = bench_clock::now();
+    for (long long i = 0; i < ops; i++)
+    {
+        BTree upper = tree.split_at(key(rng));
+        BTree::join(tree, upper);
+    }
+    report(out, "split_at + join", ops, seconds_since(start));
+    shape("after split_at + join");
+
+    // the same cut and merge by reading the keys out and building the trees again
+    long long rebuilds = std::max(1LL, std::min(ops, 5LL));
+    start = bench_clock::now();
+    for (long long i = 0; i < rebuilds; i++)
+    {
+        int k = key(rng);
+        std::vector<int> all(tree.begin(), tree.end());
+        auto cut = std::lower_bound(all.begin(), all.end(), k);
+        BTree lower(t);
+        BTree upper(t);
+        lower.bulk_load(std::span<const int>(all.data(), cut - all.begin()));
+        upper.bulk_load(std::span<const int>(cut, all.end()));
+        std::vector<int> merged(lower.begin(), lower.end());
+        merged.insert(merged.end(), upper.begin(), upper.end());
+        tree.bulk_load(merged);
+    }
+    report(out, "dump + bulk_load split and merge", rebuilds, seconds_since(start));
+
+    // 16 shards of about the same size, cut from the top, joined back in order
+    const int shards = 16;
+    start = bench_clock::now();
+    std::vector<std::unique_ptr<BTree>> parts;
+    for (int s = shards - 1; s > 0; s--)
+    {
+        BTree shard = tree.split_at(keys[n * s / shards]);
+        parts.push_back(std::make_unique<BTree>(t));
+        BTree::join(*parts.back(), shard); // into an empty tree: the shard's nodes move over
+    }
+    for (int s = shards - 2; s >= 0; s--)
+    {
+        BTree::join(tree, *parts[s]);
+    }
+    report(out, "16 shards split and joined", shards - 1, seconds_since(start));
+    shape("after 16 shards");
+    return 0;
+}
+
+int bench_memory(int t, long long n, long long ops)
+{
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    // Helper: memory per key of tree
+    auto tree_memory = [&](const std::string &label, BTree &tree) {
+        TreeStats s = tree.stats();
+        std::ostringstream line;
+        line << label << ": " << s.keys << " keys, " << s.nodes << " nodes (" << s.leaves << " leaves), "
+             << double(s.bytes) / std::max<size_t>(s.keys, 1) << " slab bytes/key, "
+             << double(s.node_bytes) / std::max<size_t>(s.keys, 1) << " node bytes/key\n";
+        std::cout << line.str();
+        out << line.str();
+    };
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> any(0, INT_MAX);
+    BTree inserted(t);
+    for (long long i = 0; i < n; i++)
+    {
+        inserted.insert(any(rng));
+    }
+    tree_memory("random inserts", inserted);
+    std::vector<int> sorted(inserted.begin(), inserted.end());
+    BTree loaded(t);
+    loaded.bulk_load(sorted);
+    tree_memory("bulk_load", loaded);
+
+    // the same number of keys at three densities, frozen with both encodings
+    for (long long gap : {1, 1000, 100000})
+    {
+        gap = std::max(1LL, std::min(gap, INT_MAX / std::max(n, 1LL) / 2));
+        std::vector<int> keys(n);
+        long long k = 0;
+        for (long long i = 0; i < n; i++)
+        {
+            keys[i] = (int)std::min<long long>(k, INT_MAX - n + i); // still ascending if the gaps ran over
+            k += gap == 1 ? 1 : 1 + rng() % (2 * gap);
+        }
+        std::uniform_int_distribution<int> probe(0, keys.back());
+        std::vector<int> probes(ops);
+        for (int &p : probes)
+        {
+            p = probe(rng);
+        }
+        long long hits[2] = {0, 0};
+        for (FrozenEncoding encoding : {FrozenEncoding::Plain, FrozenEncoding::FrameOfReference})
+        {
+            bool packed = encoding == FrozenEncoding::FrameOfReference;
+            FrozenBTree frozen(keys, encoding);
+            std::string label = std::string(packed ? "frame of reference" : "plain") + ", gap " + std::to_string(gap);
+            auto start = bench_clock::now();
+            for (int p : probes)
+            {
+                hits[packed] += frozen.contains(p);
+            }
+            report(out, label + " contains", ops, seconds_since(start));
+            std::ostringstream line;
+            line << label << ": " << double(frozen.bytes()) / std::max<long long>(n, 1) << " bytes/key\n";
+            std::cout << line.str();
+            out << line.str();
+        }
+        if (hits[0] != hits[1])
+        {
+            std::cerr << "frame of reference keys disagree with plain keys\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "memory")
+    {
+        return bench_memory(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                            argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "split")
+    {
+        return bench_split(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                           argc > 4 ? std::stoll(argv[4]) : 100000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "delete")
+    {
+        return bench_delete(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                            argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "values")
+    {
+        return bench_values(argc > 2 ? std::stoll(argv[2]) : 1000000, argc > 3 ? std::stoll(argv[3]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "range")
+    {
+        long long n = argc > 3 ? std::stoll(argv[3]) : 1000000;
+        return bench_range(argc > 2 ? std::stoi(argv[2]) : 16, n, argc > 4 ? std::stoll(argv[4]) : n / 10);
+    }
+    if (argc > 1 && std::string(argv[1]) == "bulk")
+    {
+        return bench_bulk(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 10000000,
+                          argc > 4 ? (unsigned)std::stoul(argv[4]) : 0);
+    }
+    if (argc > 1 && std::string(argv[1]) == "buffered")
+    {
+        return bench_buffered(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                              argc > 4 ? std::stoll(argv[4]) : 1000000, argc > 5 ? std::stoll(argv[5]) : 0);
+    }
+    if (argc > 1 && std::string(argv[1]) == "paged")
+    {
+        return bench_paged(argc > 2 ? std::stoi(argv[2]) : 0, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                           argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "order")
+    {
+        return bench_order(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                           argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "frozen")
+    {
+        return bench_frozen(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                            argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "lazy")
+    {
+        return bench_lazy(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                          argc > 4 ? std::stoll(argv[4]) : 1000000, argc > 5 ? std::stoll(argv[5]) : 256);
+    }
+    if (argc > 1 && std::string(argv[1]) == "suite")
+    {
+        return bench_suite(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                           argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "generate")
+    {
+        if (argc < 5)
+        {
+            std::cerr << "usage: ./bench_btree generate t n filename\n";
+            return 1;
+        }
+        return generate_tree(argv[4], std::stoi(argv[2]), std::stoll(argv[3]), 1) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "snapshot")
+    {
+        return bench_snapshot(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                              argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "rank")
+    {
+        return bench_rank();
+    }
+    if (argc > 1 && std::string(argv[1]) == "concurrent")
+    {
+        return bench_concurrent(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                                argc > 4 ? std::stoll(argv[4]) : 4000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "dump")
+    {
+        return bench_dump(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "purge")
+    {
+        long long n = argc > 3 ? std::stoll(argv[3]) : 1000000;
+        return bench_purge(argc > 2 ? std::stoi(argv[2]) : 16, n, argc > 4 ? std::stoll(argv[4]) : n / 10);
+    }
+    if (argc > 1 && std::string(argv[1]) == "load")
+    {
+        return bench_load(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "image")
+    {
+        return bench_image(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "fixed")
+    {
+        return bench_fixed(argc > 2 ? std::stoi(argv[2]) : 16, argc > 3 ? std::stoll(argv[3]) : 1000000,
+                           argc > 4 ? std::stoll(argv[4]) : 1000000);
+    }
+
+    int t = argc > 1 ? std::stoi(argv[1]) : 16;
+    long long n = argc > 2 ? std::stoll(argv[2]) : 1000000;
+    long long ops = argc > 3 ? std::stoll(argv[3]) : 1000000;
+
+    std::ofstream out("bench_output.txt");
+    out << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+    std::cout << "t=" << t << " n=" << n << " ops=" << ops << "\n";
+
+    std::mt19937 rng(271);
+    std::uniform_int_distribution<int> key(0, (int)(2 * n));
+
+    std::unique_ptr<BTree> tree(new BTree(t));
+
+    // Phase 1: grow the tree from empty with random keys
+    auto start = bench_clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        tree->insert(key(rng));
+    }
+    report(out, "insert", n, seconds_since(start));
+
+    // Phase 2: mixed workload, every operation hits a random key in the same range
+    std::bernoulli_distribution is_insert(0.5);
+    start = bench_clock::now();
+    for (long long i = 0; i < ops; i++)
+    {
+        if (is_insert(rng))
+            tree->insert(key(rng));
+        else
+            tree->remove(key(rng));
+    }
+    report(out, "mixed", ops, seconds_since(start));
+
+    // Phase 3: point lookups, one at a time and in batches
+    std::vector<int> probes(ops);
+    for (int &k : probes)
+    {
+        k = key(rng);
+    }
+    long long hits = 0;
+    start = bench_clock::now();
+    for (int k : probes)
+    {
+        hits += tree->contains(k);
+    }
+    report(out, "contains", ops, seconds_since(start));
+
+    const size_t batch = 4096;
+    std::unique_ptr<bool[]> found(new bool[batch]);
+    long long batch_hits = 0;
+    start = bench_clock::now();
+    for (size_t j = 0; j < probes.size(); j += batch)
+    {
+        size_t len = std::min(batch, probes.size() - j);
+        tree->lookup_many(std::span<const int>(probes.data() + j, len), std::span<bool>(found.get(), len));
+        batch_hits += std::count(found.get(), found.get() + len, true);
+    }
+    report(out, "lookup_many", ops, seconds_since(start));
+    if (hits != batch_hits)
+    {
+        std::cerr << "Error: lookup_many found " << batch_hits << " keys, contains found " << hits << "\n";
+    }
+
+    // Phase 4: range scans of up to 100 keys from random start points
+    long long scanned = 0;
+    start = bench_clock::now();
+    for (long long i = 0; i < ops / 100; i++)
+    {
+        int count = 0;
+        for (auto it = tree->lower_bound(probes[i]); it != tree->end() && count < 100; ++it)
+        {
+            count++;
+        }
+        scanned += count;
+    }
+    report(out, "range_scan", scanned, seconds_since(start));
+
+    // Phase 5: drain with removes
+    start = bench_clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        tree->remove(key(rng));
+    }
+    report(out, "remove", n, seconds_since(start));
+
+    // Phase 6: refill and drop the whole tree
+    for (long long i = 0; i < n; i++)
+    {
+        tree->insert(key(rng));
+    }
+    start = bench_clock::now();
+    tree.reset();
+    report(out, "drop", 1, seconds_since(start));
+
+    return 0;
+}
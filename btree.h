@@ -1,20 +1,246 @@
+#ifndef BTREE_H
+#define BTREE_H
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <string>
+#include <span>
+#include <iterator>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <map>
+
+// Rank kernels for the sorted keys of one node (btree_search.cpp)
+// Each returns the index of the first key in keys[0..n) that is >= k, or n if there is none
+typedef int (*rank_fn)(const int *keys, int n, int k);
+
+struct RankKernel
+{
+    const char *name;
+    rank_fn fn;
+    int scan_max; // node_rank uses rank_branchless for nodes with more keys than this
+};
+
+int rank_linear(const int *keys, int n, int k);
+int rank_branchless(const int *keys, int n, int k);
+std::vector<RankKernel> rank_kernels(); // every kernel this CPU supports, SIMD ones picked by CPUID
+int node_rank(const int *keys, int n, int k);
+const char *node_rank_kernel();
+int node_rank_comparisons(int n); // key comparisons node_rank makes on n keys
+
+// Operation counters (btree_stats.cpp)
+// Compiled in only with -DBTREE_STATS, otherwise BTREE_COUNT expands to nothing. Every thread counts into its own
+// block, op_counters() adds up the blocks of live threads and what exited threads left behind.
+enum OpCounter
+{
+    NODES_VISITED,      // nodes find_k searched
+    FIND_K_COMPARISONS, // key comparisons node_rank made (a SIMD scan compares every key of the node)
+    REMOVE_CASE_1,      // remove(Node *, int, bool): k found in a leaf
+    REMOVE_CASE_2A,     // k in an internal node, replaced by its predecessor
+    REMOVE_CASE_2B,     // k in an internal node, replaced by its successor
+    REMOVE_CASE_2C,     // k in an internal node, both children merged
+    REMOVE_CASE_3A,     // k not in x, the child borrowed a key from a sibling
+    REMOVE_CASE_3B,     // k not in x, the child merged with a sibling
+    SWAP_LEFT,
+    SWAP_RIGHT,
+    MERGE_LEFT,
+    MERGE_RIGHT,
+    NODES_FREED,
+    ROOT_COLLAPSES,
+    OP_COUNTER_COUNT
+};
+
+struct OpCounters
+{
+    bool enabled; // false when the library was built without BTREE_STATS, every count is 0 then
+    uint64_t count[OP_COUNTER_COUNT];
+};
+
+const char *op_counter_name(OpCounter c);
+OpCounters op_counters();
+void reset_op_counters(); // only while no thread is counting
 
+#ifdef BTREE_STATS
+std::atomic<uint64_t> *local_op_counters(); // the calling thread's block
+
+// Only the owning thread writes its block, so a relaxed load and store is enough, readers never see torn values
+inline void count_op(OpCounter c, uint64_t by)
+{
+    std::atomic<uint64_t> &slot = local_op_counters()[c];
+    slot.store(slot.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+#define BTREE_COUNT(counter, by) count_op(counter, by)
+#else
+#define BTREE_COUNT(counter, by) ((void)0)
+#endif
+
+// Nodes are carved out of a NodePool: keys and c point into the same block as the node itself
 struct Node
 {
     int *keys;
     Node **c;
-    int t;
+    // counts[i]: keys in the subtree under c[i], only in pools of trees with order statistics (nullptr otherwise).
+    // A child never holds every int key, so a subtree count always fits in 32 bits.
+    uint32_t *counts;
     bool leaf;
+    bool leaf_block; // block without child pointers and counts, see NodePool
     int n;
+    int refs; // parents and roots (tree or snapshots) pointing here, updated atomically, see btree_snapshot.cpp
+};
+
+// t >= 2 and at most 2^32 keys keep every tree below this height
+static const int MAX_HEIGHT = 64;
 
-    Node(int t, bool leaf = true);
+// The slabs of a NodePool. Snapshots hold on to it, so nodes they still read outlive the tree and its pool.
+// Nodes a snapshot frees on its own thread go on remote_free and the pool reuses them.
+// The trees split_at cuts apart share one arena, and join keeps the arena of the right tree alive with the left
+// one's (joined), so a node may be freed by a pool other than the one that handed it out.
+struct NodeArena
+{
+    std::mutex lock; // slabs, bytes and joined, pools of split trees may grow the arena from different threads
+    std::vector<char *> slabs;
+    size_t bytes = 0;                                // size of all slabs
+    std::vector<std::shared_ptr<NodeArena>> joined;  // arenas holding nodes that trees joined into ours brought along
+    std::atomic<long long> live{0};                  // nodes handed out minus nodes freed by the pools of this arena
+    std::atomic<Node *> remote_free[2];       // internal [0] and leaf [1] blocks, linked like the pool's free lists
+    std::atomic<size_t> remote_count{0};      // nodes pushed on remote_free since the last release()
 
-    ~Node();
+    NodeArena() = default;
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+    ~NodeArena();
+    void push_free(Node *x);
+};
+
+// Slab allocator for the nodes of one tree
+// An internal node is a single cache-aligned block laid out as [Node | 2t-1 keys | 2t child pointers | 2t counts],
+// the counts only when the pool was reset with counts = true. A leaf block is only [Node | 2t-1 keys].
+// Freed blocks go on the free list of their size and are reused by alloc(), release() drops every slab at once.
+class NodePool
+{
+private:
+    int t;
+    bool with_counts;       // blocks carry a subtree count per child
+    size_t block_bytes[2];  // size of an internal [0] and a leaf [1] block, multiples of the cache line
+    size_t slab_blocks;     // internal blocks that fit in the next slab, doubles up to a cap
+    std::shared_ptr<NodeArena> arena;
+    char *next_block;       // first unused byte in the newest slab
+    size_t bytes_left;      // unused bytes left in the newest slab
+    Node *free_list[2];     // freed internal [0] and leaf [1] blocks, linked through their first word
+
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+    void start_over();
+
+public:
+    NodePool();
+    ~NodePool();
+    void reset(int t, bool counts = false);
+    void swap(NodePool &other);
+    void share(const NodePool &other);
+    bool adopt(NodePool &other);
+    Node *alloc(bool leaf = true);
+    void free(Node *x);
+    void release();
+    size_t live_nodes() const;
+    size_t bytes() const;
+    size_t block_size(const Node *x) const { return block_bytes[x->leaf_block]; }
+    const std::shared_ptr<NodeArena> &shared_arena() const { return arena; }
+};
+
+// Header of a binary tree image (btree_image.cpp), all fields in the byte order of the machine that saved it
+// The header is followed by node_count fixed-size node records, the root is record 0:
+//   int32 n, int32 leaf, int32 keys[2t-1] (padded to 8 bytes), uint64 child[2t] (record index of each child)
+struct ImageHeader
+{
+    char magic[8];         // "BTREEIMG"
+    uint32_t version;      // IMAGE_VERSION
+    uint32_t byte_order;   // 0x01020304
+    uint32_t degree;       // minimum degree t
+    uint32_t record_bytes; // size of one node record
+    uint64_t node_count;
+    uint64_t checksum;     // over all node records
+};
+
+// Shape of a tree and the operation counters at the time BTree::stats() was called
+struct TreeStats
+{
+    int height = 0;       // levels, 0 for an empty tree
+    size_t nodes = 0;     // nodes reachable from the root
+    size_t keys = 0;
+    size_t pool_nodes = 0; // nodes allocated from the pool, including old versions only snapshots still read
+    size_t bytes = 0;      // slab memory held by the pool
+    size_t node_bytes = 0; // blocks of the nodes reachable from the root, leaves have smaller blocks (NodePool)
+    size_t leaves = 0;
+    size_t tombstones = 0; // keys counted in keys that were removed lazily and wait for compact()
+    size_t messages = 0;   // buffered inserts and removes not applied to the nodes yet, see BTree::set_buffered
+    size_t fill[11] = {};  // fill[b]: nodes holding between b*10% and (b+1)*10% of 2t-1 keys, fill[10]: full nodes
+    OpCounters ops;
+
+    void print(std::ostream &out = std::cout) const;
+};
+
+// Output formats of BTree::dump (btree_dump.cpp)
+enum class DumpFormat
+{
+    Debug,  // keys ',' nodes '\t' levels '\n', what print() writes
+    Loader, // degree line, then keys ',' nodes '-' levels '\n', what build_tree reads
+};
+
+// How BTree::remove keeps nodes filled, see BTree::set_delete_policy (btree_relaxed.cpp)
+enum class DeletePolicy
+{
+    Strict,      // CLRS: every node but the root keeps t-1 keys, children are fixed on the way down (the default)
+    MinFill,     // a node is fixed on the way back up, and only once it holds fewer than min_keys keys
+    MergeAtEmpty // a node is fixed only once it holds no key, MinFill with min_keys = 1
+};
+
+// How a FrozenBTree stores its sorted keys (btree_frozen.h)
+enum class FrozenEncoding
+{
+    Plain,           // one int per key, FrozenBTree::keys() is one contiguous array
+    FrameOfReference // each run of FROZEN_B keys as its first key and 8-, 16- or 32-bit offsets from it
+};
+
+class FrozenBTree;
+
+// Buffered messages of one level of internal nodes, key -> true for insert, false for remove (btree_buffered.cpp)
+typedef std::map<int, bool> MessageLevel;
+// The newest message for k over messages[1 ..], the highest level is the newest, and the nearest key past k
+// (larger if forward, else smaller) that any level holds a message for
+bool find_message(const std::vector<MessageLevel> &messages, int k, bool &insert);
+bool next_message(const std::vector<MessageLevel> &messages, long long k, bool forward, int &next);
+
+// The CLRSv4 insert and delete cases (btree_insert.cpp, btree_delete.cpp) for any tree that reaches its nodes through
+// a Tree::NodeRef: Node * for BTree, a pinned PageRef for PagedBTree (btree_paged.h). The tree supplies find_k, own
+// (a child the case changes), child (a child it only reads), mark_dirty, alloc_node, free_node and set_child, and
+// COUNTED if its nodes can keep subtree counts. A child that cannot be read is an empty NodeRef and the case gives up.
+template <typename Tree>
+struct ClrsInsert
+{
+    typedef typename Tree::NodeRef NodeRef;
+    static void insert(Tree &tree, NodeRef x, int k);
+    static void insert_leaf_key(Tree &tree, NodeRef &x, int i, int k);
+    static bool split_child(Tree &tree, NodeRef &x, int i);
+};
+
+template <typename Tree>
+struct ClrsDelete
+{
+    typedef typename Tree::NodeRef NodeRef;
+    static void remove(Tree &tree, NodeRef x, int k);
+    static void remove_leaf_key(Tree &tree, NodeRef &x, int i);
+    static void remove_internal_key(Tree &tree, NodeRef &x, int i, int j);
+    static bool max_key(Tree &tree, const NodeRef &x, int &key);
+    static bool min_key(Tree &tree, const NodeRef &x, int &key);
+    static void merge_left(Tree &tree, NodeRef &x, NodeRef &y, int k);
+    static void swap_left(Tree &tree, NodeRef &x, NodeRef &y, NodeRef &z, int i);
+    static void swap_right(Tree &tree, NodeRef &x, NodeRef &y, NodeRef &z, int i);
 };
 
 class BTree
@@ -22,10 +248,36 @@ class BTree
 private:
     Node *root;
     int t; // minimum degree
-    // Build tree from file
-    bool build_tree(const std::string &filename);
+    NodePool pool;
+    // Read-only image mapped by open_image, root is nullptr until materialize() copies it into nodes
+    const char *image;
+    size_t image_bytes;
+    // Lazy remove (btree_lazy.cpp): keys that are removed but still sit in their nodes until compact()
+    std::unordered_set<int> tombstones;
+    bool lazy_remove = false;
+    // Order statistics (btree_order.cpp): every node keeps the key count of each child subtree
+    bool order_stats = false;
+    // Buffered updates (btree_buffered.cpp): messages[h] holds the messages of every node h levels above the leaves
+    std::vector<MessageLevel> messages;
+    bool buffered = false;
+    size_t buffer_capacity = 0; // messages a node buffers before it is flushed
+    int buffered_height = -1;   // levels above the leaves of the root, -1 until buffer_message measures it
+    // Relaxed delete policies (btree_relaxed.cpp): nodes other than the root keep at least relaxed_min keys
+    DeletePolicy policy = DeletePolicy::Strict;
+    int relaxed_min = 0;
+    double rebuild_below = 0.0;  // rebuild a root subtree whose nodes are on average less full than this
+    size_t relaxed_removes = 0;  // keys removed under a relaxed policy
+    size_t next_fill_check = 0;  // relaxed_removes at which check_fill() measures the root subtrees again
+    size_t rebuilds = 0;
+    // Build tree from file (btree_load.cpp), threads == 0 uses every hardware thread for very large levels
+    bool build_tree(const std::string &filename, unsigned threads = 0);
+
+    bool materialize();
+    void close_image();
+    bool image_contains(int k) const;
 
     void remove(Node *x, int k, bool x_root = false);
+    void remove_lazy(int k);
     int find_k(Node *x, int k);
     void remove_leaf_key(Node *x, int i);
     void remove_internal_key(Node *x, int i, int j);
@@ -36,11 +288,288 @@ private:
     void swap_left(Node *x, Node *y, Node *z, int i);
     void swap_right(Node *x, Node *y, Node *z, int i);
 
+    void insert_now(int k);
+    void remove_now(int k);
+    void insert(Node *x, int k);
+    void insert_leaf_key(Node *x, int i, int k);
+    void split_child(Node *x, int i);
+
+    size_t remove_many(Node *x, const int *first, const int *last);
+    int fix_child(Node *x, int i);
+    void fix_children(Node *x);
+    void collapse_root();
+
+    void remove_relaxed(int k);
+    void repair_child(Node *x, int i);
+    void fill_up(Node *x);
+    void fill_loaded();
+    void check_fill();
+
+    size_t remove_range(Node *x, int lo, int hi, std::vector<int> &displaced);
+    size_t count_keys(Node *x);
+
+    // Bottom-up build from sorted keys (btree_build.cpp)
+    Node *build_sorted(const int *keys, long long m, int h, const std::vector<long long> &max_keys, bool is_root,
+                       int min_keys);
+    void assign_sorted(std::span<const int> sorted_keys);
+
+    void buffer_message(int k, bool insert);
+    void flush_root();
+    long long flush(Node *x, int h, long long lo, long long hi, std::vector<int> &deferred);
+    void settle_messages();
+
+    // A subtree cut off or being glued by split_at and join (btree_split.cpp): its root and the root's height,
+    // 0 for a leaf, nullptr and -1 when it holds no keys
+    struct Piece
+    {
+        Node *root;
+        int h;
+    };
+    BTree(BTree &tree, int k);
+    Piece graft(Piece a, int k, Piece b);
+    void split_node(Node *x, int h, int k, Piece &left, Piece &right);
+    int height() const;
+
+    size_t subtree_size(Node *x) const;
+    void recount(Node *x);
+    Node *clone(Node *x, NodePool &into);
+
+    Node *own(Node *x, int i);
+    Node *own_node(Node *x);
+    void own_root();
+    Node *copy_shared(Node *y);
+    void unref(Node *x);
+
+    bool is_tombstone(int k) const { return !tombstones.empty() && tombstones.count(k); }
+
+    // Hooks of ClrsInsert and ClrsDelete, own copies a child a snapshot shares before the case changes it
+    typedef Node *NodeRef;
+    static constexpr bool COUNTED = true; // nodes keep subtree counts while order_stats is on
+    Node *child(Node *x, int i) const { return x->c[i]; }
+    void mark_dirty(Node *) {}
+    Node *alloc_node(bool leaf) { return pool.alloc(leaf); }
+    void free_node(Node *x) { pool.free(x); }
+    void set_child(Node *x, int i, Node *y) { x->c[i] = y; }
+
     friend void test_helpers(int &correct, int &total);
+    template <typename Tree>
+    friend struct ClrsInsert;
+    template <typename Tree>
+    friend struct ClrsDelete;
+    template <typename Key, int T, typename Value>
+    friend class FixedBTree;
 
 public:
+    class Cursor;
+    class iterator;
+    class Snapshot;
+
     BTree(const std::string &filename);
+    BTree(int t);
+    // Thaw a frozen tree into a mutable tree of minimum degree t, see FrozenBTree
+    BTree(const FrozenBTree &frozen, int t);
+    ~BTree();
+    int degree() const { return t; }
     // For debugging
     void print();
+    // Buffered level-order dump, see DumpFormat. The nodes are written as they are, so every tombstone is compacted
+    // and every buffered message applied first, with no budget
+    bool dump(std::ostream &out, DumpFormat format = DumpFormat::Debug);
+    bool dump(int fd, DumpFormat format = DumpFormat::Debug);
     void remove(int k);
+    void insert(int k);
+    size_t remove_many(std::span<const int> sorted_keys);
+    size_t remove_range(int lo, int hi); // remove the keys in [lo, hi), like count_range and cursors, returns how many
+    bool contains(int k);
+    void lookup_many(std::span<const int> keys, std::span<bool> out);
+    // Replace the keys with strictly ascending sorted_keys, built bottom-up with nodes about fill_factor full
+    // (btree_build.cpp), threads == 0 uses every hardware thread
+    bool bulk_load(std::span<const int> sorted_keys, double fill_factor = 1.0, unsigned threads = 0);
+
+    // Binary images, see ImageHeader
+    bool save_image(const std::string &filename);
+    bool open_image(const std::string &filename, bool verify = true);
+    bool mapped() const { return image != nullptr; }
+
+    // In-order traversal, see BTree::Cursor
+    iterator begin();
+    iterator end();
+    iterator lower_bound(int k);
+
+    // Read-only view of the current keys, see BTree::Snapshot: shares the nodes and copies the tombstones and
+    // buffered messages, O(1) plus O(tombstone_count() + pending_messages()), the tree is unchanged
+    Snapshot snapshot();
+    // nodes allocated from the pool, including old versions only snapshots still read and the nodes of trees
+    // that share its memory since split_at or join
+    size_t node_count() const { return pool.live_nodes(); }
+    // Shape, memory and operation counters, see TreeStats
+    TreeStats stats();
+    // Pointer-free read-only copy of the current keys, see FrozenBTree (btree_frozen.h)
+    FrozenBTree freeze(FrozenEncoding encoding = FrozenEncoding::Plain);
+
+    // Lazy remove: remove() only marks the key, compact() removes marked keys in bounded batches
+    void set_lazy_remove(bool on) { lazy_remove = on; }
+    size_t compact(size_t budget);
+    size_t tombstone_count() const { return tombstones.size(); }
+
+    // Order statistics: off by default, turning them on or off copies the tree into nodes with or without counts
+    void set_order_stats(bool on);
+    bool has_order_stats() const { return order_stats; }
+    // rank and select read the subtree counts of the nodes, so they compact every tombstone and apply every
+    // buffered message first, with no budget
+    size_t rank(int k);                  // number of keys < k
+    iterator select(size_t i);           // the key with i smaller keys, end() if i >= number of keys
+    size_t count_range(int lo, int hi);  // number of keys in [lo, hi)
+
+    // Buffered updates (Bε-tree mode): insert and remove only add a message to the root's buffer, a buffer holding
+    // more than per_node messages (0 picks 16t) is flushed in one batch to the child receiving the most of them
+    void set_buffered(bool on, size_t per_node = 0);
+    bool is_buffered() const { return buffered; }
+    size_t pending_messages() const;
+    void flush_messages(); // apply every pending message to the nodes
+
+    // Delete policy: the relaxed policies skip the borrows and merges of remove() on the way down and only fix a
+    // node that fell below their minimum on the way back up. With rebuild_below > 0, a subtree of the root whose
+    // nodes are on average less than that fraction full is rebuilt packed, checked every few removes.
+    void set_delete_policy(DeletePolicy p, int min_keys = 1, double rebuild_below = 0.0);
+    DeletePolicy delete_policy() const { return policy; }
+    size_t rebuild_count() const { return rebuilds; } // subtrees rebuilt because they were too empty
+
+    // Split and join in O(log n) node operations: split_at moves every key >= k into the returned tree, join moves
+    // every key of right into left when all of them are larger than the keys of left. The trees may share node
+    // memory afterwards, each one can still be written on its own thread (btree_split.cpp).
+    BTree split_at(int k);
+    static bool join(BTree &left, BTree &right);
+};
+
+// Ordered cursor over the keys of a BTree (btree_cursor.cpp)
+// The cursor keeps its root-to-node path, so next() and prev() are amortized O(1) and never restart at the root.
+// Any insert or remove on the tree invalidates every cursor on it. A mapped image is materialized first.
+// A cursor on a snapshot stays valid as long as the snapshot.
+class BTree::Cursor
+{
+private:
+    // One entry per node from the root down. For every entry but the last, i is the child we went down to,
+    // for the last entry i is the index of the current key in that node.
+    struct Step
+    {
+        Node *x;
+        int i;
+    };
+
+    BTree *tree;     // nullptr for a cursor on a snapshot
+    Node *snap_root; // root of the snapshot
+    const std::unordered_set<int> *tombstones; // of the tree or the snapshot, nullptr if a snapshot has none
+    const std::vector<MessageLevel> *messages;
+    std::vector<Step> path;
+    // On a key that only a buffered insert message holds: path is then left where the last search put it
+    bool on_message = false;
+    int message_key = 0;
+
+    Node *root() const { return tree ? tree->root : snap_root; }
+
+    void descend_first(Node *x);
+    void descend_last(Node *x);
+    void ascend_next();
+    void ascend_prev();
+    void step_next();
+    void step_prev();
+    void skip_tombstones(bool forward);
+    void find(int k);
+    void settle(bool forward, long long from);
+
+public:
+    explicit Cursor(BTree &tree);
+    explicit Cursor(const Snapshot &snap);
+    bool seek(int k);
+    bool seek_first();
+    bool seek_last();
+    bool seek_rank(size_t i);
+    bool next();
+    bool prev();
+    bool valid() const { return on_message || !path.empty(); }
+    int key() const { return on_message ? message_key : path.back().x->keys[path.back().i]; }
+    bool operator==(const Cursor &other) const;
+};
+
+// Input iterator over the keys of a BTree in ascending order, so STL algorithms can read ranges.
+// Typical range scan over [lo, hi): for (auto it = tree.lower_bound(lo); it != tree.end() && *it < hi; ++it)
+class BTree::iterator
+{
+private:
+    Cursor cur;
+
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef int value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const int *pointer;
+    typedef int reference;
+
+    explicit iterator(const Cursor &cur) : cur(cur) {}
+    int operator*() const { return cur.key(); }
+    iterator &operator++()
+    {
+        cur.next();
+        return *this;
+    }
+    iterator operator++(int)
+    {
+        iterator old = *this;
+        cur.next();
+        return old;
+    }
+    bool operator==(const iterator &other) const { return cur == other.cur; }
+    bool operator!=(const iterator &other) const { return !(cur == other.cur); }
 };
+
+// Read-only view of a BTree as it was when snapshot() was called (btree_snapshot.cpp)
+// The snapshot shares every node with the tree, later writes to the tree copy a shared node before changing it.
+// A snapshot can be read and destroyed on any thread while the tree keeps changing, snapshot() itself
+// must not run at the same time as a write to the tree.
+class BTree::Snapshot
+{
+private:
+    // Keys the tree had removed lazily and its buffered messages when the snapshot was taken. They live on the
+    // heap so cursors keep pointing at them when the snapshot is moved.
+    struct Pending
+    {
+        std::unordered_set<int> tombstones;
+        std::vector<MessageLevel> messages;
+    };
+
+    Node *root;
+    int t;
+    std::shared_ptr<NodeArena> arena;
+    std::shared_ptr<const Pending> pending; // nullptr if the tree had neither
+
+    Snapshot(Node *root, int t, const std::shared_ptr<NodeArena> &arena, std::shared_ptr<const Pending> pending)
+        : root(root), t(t), arena(arena), pending(std::move(pending))
+    {
+    }
+    friend class BTree;
+    friend class BTree::Cursor;
+
+public:
+    Snapshot(Snapshot &&other) noexcept
+        : root(other.root), t(other.t), arena(std::move(other.arena)), pending(std::move(other.pending))
+    {
+        other.root = nullptr;
+    }
+    Snapshot &operator=(Snapshot &&other) noexcept;
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    ~Snapshot();
+
+    int degree() const { return t; }
+    bool contains(int k) const;
+    // For debugging, same format as BTree::print. A snapshot that holds tombstones or buffered messages is
+    // written as the smallest tree of its keys, the shared nodes cannot be compacted.
+    void print(std::ostream &out = std::cout) const;
+    bool dump(std::ostream &out, DumpFormat format = DumpFormat::Debug) const;
+    iterator begin() const;
+    iterator end() const;
+    iterator lower_bound(int k) const;
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include "btree.h"
+#include <algorithm>
+#include <climits>
+
+/*
+NOTE: Buffered updates, the write-optimized mode of a Bε-tree. With set_buffered(true), insert and remove stop at
+the root: they add a message (the key, insert or remove) to the root's buffer and change no node. Once a buffer
+holds more than buffer_capacity messages, flush() moves every message for the child that receives the most of
+them into that child's buffer in one batch, and flushes the child in turn if that overfills it. A message is
+applied where its key can live: in a node that holds the key, or in the leaf its key belongs to, which takes
+its whole batch in one pass. Full nodes on the way are split before anything moves into them, like insert does,
+and children that lost keys are repaired once per flush with fix_children, like remove_many does. Removing a key
+that an internal node holds needs the CLRS cases, that is left to remove_now once the flush is over.
+The buffers are not stored in the nodes: messages[h] holds the messages of every node h levels above the leaves
+in one ordered map, and the buffer of a node is the slice of that map between the separators around it. Splits,
+merges, borrows and snapshot copies then never move a buffer, the slice follows the keys.
+For one key, a message higher up is newer than one further down, so contains(), lookup_many and cursors read the
+highest message (find_message) before the nodes, cursors walk the message keys (next_message) next to the node
+keys. A snapshot copies the levels and reads them the same way. Everything else that reads keys from the nodes
+(dump, save_image, rank, select) or changes many keys at once (remove_many, remove_range) applies every pending
+message first with flush_messages().
+*/
+
+// Helper: first message of level with a key > lo
+static MessageLevel::iterator level_after(MessageLevel &level, long long lo)
+{
+    return lo < INT_MIN ? level.begin() : level.upper_bound((int)lo);
+}
+
+// Helper: first message of level with a key >= hi
+static MessageLevel::iterator level_before(MessageLevel &level, long long hi)
+{
+    return hi > INT_MAX ? level.end() : level.lower_bound((int)hi);
+}
+
+// Helper: true if more than limit messages of level have a key in (lo, hi)
+static bool level_over(MessageLevel &level, long long lo, long long hi, size_t limit)
+{
+    size_t count = 0;
+    for (auto it = level_after(level, lo), end = level_before(level, hi); it != end; ++it)
+    {
+        if (++count > limit)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// turn buffered updates on or off, per_node is the number of messages a node buffers before it is flushed
+// Precondition: None
+// Postcondition: turning them off applies every pending message, per_node == 0 picks 16t
+
+void BTree::set_buffered(bool on, size_t per_node)
+{
+    if (!on)
+    {
+        flush_messages();
+    }
+    buffered = on;
+    buffer_capacity = per_node > 0 ? per_node : 16 * (size_t)std::max(t, 1);
+}
+
+// return the number of messages waiting in the buffers
+size_t BTree::pending_messages() const
+{
+    size_t count = 0;
+    for (const MessageLevel &level : messages)
+    {
+        count += level.size();
+    }
+    return count;
+}
+
+// find the newest message for k in the levels of messages
+// Precondition: None
+// Postcondition: returns false if no level holds a message for k, else true and insert is that message
+
+bool find_message(const std::vector<MessageLevel> &messages, int k, bool &insert)
+{
+    for (size_t h = messages.size(); h-- > 1;) // the highest message is the newest
+    {
+        auto it = messages[h].find(k);
+        if (it != messages[h].end())
+        {
+            insert = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// find the nearest key past k that some level of messages holds a message for, larger than k if forward, else smaller
+// Precondition: None
+// Postcondition: returns false if there is none, else true and next is that key, O(levels log messages)
+
+bool next_message(const std::vector<MessageLevel> &messages, long long k, bool forward, int &next)
+{
+    bool found = false;
+    for (size_t h = 1; h < messages.size(); h++)
+    {
+        const MessageLevel &level = messages[h];
+        if (forward)
+        {
+            auto it = k < INT_MIN ? level.begin() : level.upper_bound((int)std::min<long long>(k, INT_MAX));
+            if (k <= INT_MAX && it != level.end() && (!found || it->first < next))
+            {
+                next = it->first;
+                found = true;
+            }
+        }
+        else
+        {
+            auto it = k > INT_MAX ? level.end() : level.lower_bound((int)std::max<long long>(k, INT_MIN));
+            if (k >= INT_MIN && it != level.begin() && (!found || std::prev(it)->first > next))
+            {
+                next = std::prev(it)->first;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// add an insert or remove message for k to the root's buffer
+// Precondition: buffered updates are on and the root is an internal node
+// Postcondition: contains(k) reflects the update, no node changed unless the root's buffer overflowed and was flushed
+
+void BTree::buffer_message(int k, bool insert)
+{
+    if (buffered_height < 0)
+    {
+        buffered_height = 0;
+        for (Node *x = root; !x->leaf; x = x->c[0])
+        {
+            buffered_height++;
+        }
+    }
+    if ((int)messages.size() <= buffered_height)
+    {
+        messages.resize(buffered_height + 1);
+    }
+    MessageLevel &top = messages[buffered_height];
+    top[k] = insert; // replaces an older message for k
+    if (top.size() > buffer_capacity)
+    {
+        flush_root();
+    }
+}
+
+// flush the root's buffer one level down
+// Precondition: buffered updates are on, the root is an internal node and buffered_height is its height
+// Postcondition: the root's largest batch moved down (or the full root was split), the tree is a valid BTree
+
+void BTree::flush_root()
+{
+    own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+    int h = buffered_height;
+
+    // Full root: split it like insert does. The new root starts with an empty buffer and the old root's messages
+    // are now the buffers of its two halves, they move on when the new root is flushed.
+    if (root->n == 2 * t - 1)
+    {
+        Node *new_root = pool.alloc(false);
+        new_root->c[0] = root;
+        if (order_stats)
+        {
+            new_root->counts[0] = subtree_size(root);
+        }
+        root = new_root;
+        split_child(root, 0);
+        buffered_height = h + 1;
+        messages.resize(h + 2);
+        return;
+    }
+
+    std::vector<int> deferred;
+    flush(root, h, LLONG_MIN, LLONG_MAX, deferred);
+    collapse_root();
+    for (int k : deferred)
+    {
+        remove_now(k);
+    }
+    settle_messages();
+}
+
+// apply the messages for the keys of x and flush the batch of the child of x that receives the most messages
+// Precondition: x is an internal node h levels above the leaves, owned by the tree and not full, and lies between
+//               the separators lo and hi; every child of x holds at least t-1 keys
+// Postcondition: returns how many keys the subtree of x gained (negative if it lost keys), every child of x holds
+//                at least t-1 keys again, removes of keys held by internal nodes are appended to deferred
+
+long long BTree::flush(Node *x, int h, long long lo, long long hi, std::vector<int> &deferred)
+{
+    // Count the messages each child receives. A message for a key of x is applied here instead: it is newer than
+    // any message for that key further down, which a split or a borrow can leave behind when it moves a key up.
+    MessageLevel &level = messages[h];
+    std::vector<size_t> per_child(x->n + 1, 0);
+    size_t batch = 0;
+    int i = 0;
+    auto it = level_after(level, lo);
+    auto last = level_before(level, hi);
+    while (it != last)
+    {
+        int k = it->first;
+        while (i < x->n && x->keys[i] < k)
+        {
+            i++;
+        }
+        if (i < x->n && x->keys[i] == k)
+        {
+            if (!it->second)
+            {
+                deferred.push_back(k);
+            }
+            else if (!tombstones.empty())
+            {
+                tombstones.erase(k); // k is in x, lazy remove only marked it
+            }
+            for (int g = h - 1; g >= 1; g--)
+            {
+                messages[g].erase(k);
+            }
+            it = level.erase(it);
+            continue;
+        }
+        per_child[i]++;
+        batch++;
+        ++it;
+    }
+    if (batch == 0)
+    {
+        return 0;
+    }
+    int c = (int)(std::max_element(per_child.begin(), per_child.end()) - per_child.begin());
+    long long c_lo = c > 0 ? x->keys[c - 1] : lo;
+    long long c_hi = c < x->n ? x->keys[c] : hi;
+
+    long long delta = 0;
+    Node *y = own(x, c);
+    if (!y->leaf)
+    {
+        // Internal child: the batch joins the child's buffer, where it is newer than every message already there
+        int last_child = c;
+        if (y->n == 2 * t - 1)
+        {
+            split_child(x, c);
+            last_child = c + 1;
+        }
+        MessageLevel &below = messages[h - 1];
+        it = level_after(level, c_lo);
+        auto end = level_before(level, c_hi);
+        while (it != end)
+        {
+            if (last_child > c && it->first == x->keys[c])
+            {
+                ++it; // the median of the split moved up into x, its message stays in the buffer of x
+                continue;
+            }
+            // move the map node itself, an older message for the same key below is overwritten
+            auto moved = below.insert(level.extract(it++));
+            if (!moved.inserted)
+            {
+                moved.position->second = moved.node.mapped();
+            }
+        }
+
+        for (int j = c; j <= last_child; j++)
+        {
+            long long j_lo = j > 0 ? x->keys[j - 1] : lo;
+            long long j_hi = j < x->n ? x->keys[j] : hi;
+            if (level_over(below, j_lo, j_hi, buffer_capacity))
+            {
+                long long gained = flush(own(x, j), h - 1, j_lo, j_hi, deferred);
+                if (order_stats)
+                {
+                    x->counts[j] += gained;
+                }
+                delta += gained;
+            }
+        }
+    }
+    else
+    {
+        // Leaf child: apply the batch in key order. A split may spread the batch over two leaves, so every message
+        // finds its leaf in x again. If the leaf and x are both full, the rest stays in x's buffer until x is split.
+        it = level_after(level, c_lo);
+        while (it != level.end() && it->first < c_hi)
+        {
+            int k = it->first;
+            int j = find_k(x, k);
+            if (j < x->n && x->keys[j] == k)
+            {
+                ++it; // a split moved k up into x, the next flush of x applies it
+                continue;
+            }
+            Node *leaf = own(x, j);
+            int r = find_k(leaf, k);
+            bool present = r < leaf->n && leaf->keys[r] == k;
+            if (it->second && !present)
+            {
+                if (leaf->n == 2 * t - 1)
+                {
+                    if (x->n == 2 * t - 1)
+                    {
+                        break;
+                    }
+                    split_child(x, j);
+                    continue;
+                }
+                insert_leaf_key(leaf, r, k);
+                if (order_stats)
+                {
+                    x->counts[j]++;
+                }
+                delta++;
+            }
+            else if (!it->second && present)
+            {
+                remove_leaf_key(leaf, r);
+                if (order_stats)
+                {
+                    x->counts[j]--;
+                }
+                delta--;
+            }
+            if (present && !tombstones.empty())
+            {
+                tombstones.erase(k); // inserted again, or removed for good
+            }
+            it = level.erase(it);
+        }
+    }
+
+    fix_children(x);
+    return delta;
+}
+
+// match messages to the height of the tree after a flush
+// Precondition: None
+// Postcondition: messages has one level per internal level, buffered_height is the root's height,
+//                every message is applied if the root is no longer an internal node
+
+void BTree::settle_messages()
+{
+    if (!root || root->leaf)
+    {
+        flush_messages(); // no internal node is left to hold them
+        return;
+    }
+    int h = 0;
+    for (Node *x = root; !x->leaf; x = x->c[0])
+    {
+        h++;
+    }
+    // the tree lost levels: the buffers of the removed roots go to the new root, higher (newer) messages win
+    for (size_t g = h + 1; g < messages.size(); g++)
+    {
+        for (const auto &m : messages[g])
+        {
+            messages[h][m.first] = m.second;
+        }
+    }
+    messages.resize(h + 1);
+    buffered_height = h;
+}
+
+// apply every pending message to the nodes
+// Precondition: None
+// Postcondition: pending_messages() is 0 and the tree holds the keys the messages left it with
+
+void BTree::flush_messages()
+{
+    buffered_height = -1;
+    if (messages.empty())
+    {
+        return;
+    }
+    MessageLevel latest;
+    for (const MessageLevel &level : messages) // lowest level first, so the newest message for a key wins
+    {
+        for (const auto &m : level)
+        {
+            latest[m.first] = m.second;
+        }
+    }
+    messages.clear();
+
+    std::vector<int> removes;
+    for (const auto &m : latest)
+    {
+        if (m.second)
+        {
+            insert_now(m.first);
+        }
+        else
+        {
+            removes.push_back(m.first);
+        }
+    }
+    remove_many(removes);
+}
@@ -0,0 +1,245 @@
+#include "btree.h"
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+/*
+NOTE: Building a tree straight from sorted keys, without searching or splitting. The height is the smallest
+that holds every key, and each node spreads its keys as evenly as it can over as few children as the
+degree allows (t, or 2 at the root). Because every child of a node at height h gets at least t^h - 1 keys,
+the result is a valid BTree. The work is O(n) and every node is written once.
+bulk_load builds bottom-up instead, for a target occupancy: the keys are cut into leaves of about
+fill_factor * (2t-1) keys with one separator between neighbours, and every level above groups about
+fill_factor * 2t nodes under one parent and hands its own separators up, until one node is left. The number of
+nodes per level is clamped so every node stays between the minimum and maximum occupancy. Where a node's keys
+and children come from is plain arithmetic on its index, so the nodes of a level are filled on several threads;
+only taking the blocks from the pool is sequential. The shape of every level is known before anything is filled,
+so the threads are started once per bulk_load, each takes its piece of every level and waits for the others at
+a barrier before the level above, which reads what the level below wrote.
+*/
+
+static const size_t PARALLEL_MIN_NODES = 4096; // levels with fewer nodes are filled on one thread
+
+// Helper: call fill(level, from, to) on pieces of [0, counts[level]) for every level in order, one piece per thread
+// The threads start once and meet at a barrier between levels. Levels with fewer than PARALLEL_MIN_NODES nodes
+// (counts only shrink going up) are filled on the calling thread after the threads are done.
+static void parallel_fill(const std::vector<long long> &counts, unsigned threads,
+                          const std::function<void(size_t, long long, long long)> &fill)
+{
+    size_t wide = 0;
+    while (threads > 1 && wide < counts.size() && counts[wide] >= (long long)PARALLEL_MIN_NODES)
+    {
+        wide++;
+    }
+    if (wide > 0)
+    {
+        std::barrier sync(threads);
+        auto work = [&](unsigned j) {
+            for (size_t level = 0; level < wide; level++)
+            {
+                fill(level, counts[level] * j / threads, counts[level] * (j + 1) / threads);
+                sync.arrive_and_wait();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned j = 1; j < threads; j++)
+        {
+            workers.emplace_back(work, j);
+        }
+        work(0); // the calling thread takes the first piece
+        for (std::thread &w : workers)
+        {
+            w.join();
+        }
+    }
+    for (size_t level = wide; level < counts.size(); level++)
+    {
+        fill(level, 0, counts[level]);
+    }
+}
+
+// build the subtree of height h that holds keys[0..m)
+// Precondition: max_keys[h] >= m, and m >= (min_keys+1)^(h+1) - 1 unless the subtree is the root
+// Postcondition: returns the root of a subtree holding exactly keys[0..m), every node but the root of the tree
+//                holds at least min_keys keys (t-1 for a BTree, less under a relaxed delete policy)
+
+Node *BTree::build_sorted(const int *keys, long long m, int h, const std::vector<long long> &max_keys, bool is_root,
+                          int min_keys)
+{
+    Node *x = pool.alloc(h == 0);
+    if (h == 0)
+    {
+        std::copy(keys, keys + m, x->keys);
+        x->n = (int)m;
+        return x;
+    }
+
+    long long fits = max_keys[h - 1] + 1;
+    long long children = std::max<long long>(is_root ? 2 : min_keys + 1, (m + fits) / fits);
+    long long child_keys = m - (children - 1);
+    long long pos = 0;
+    for (long long j = 0; j < children; j++)
+    {
+        long long share = child_keys / children + (j < child_keys % children ? 1 : 0);
+        x->c[j] = build_sorted(keys + pos, share, h - 1, max_keys, false, min_keys);
+        if (order_stats)
+        {
+            x->counts[j] = (uint32_t)share;
+        }
+        pos += share;
+        if (j + 1 < children)
+        {
+            x->keys[j] = keys[pos++];
+        }
+    }
+    x->n = (int)(children - 1);
+    return x;
+}
+
+// replace the keys of the tree with sorted_keys
+// Precondition: sorted_keys is strictly ascending, the tree has a valid degree
+// Postcondition: the tree holds exactly sorted_keys with the smallest possible height
+
+void BTree::assign_sorted(std::span<const int> sorted_keys)
+{
+    close_image();
+    root = nullptr;
+    tombstones.clear();
+    messages.clear();
+    buffered_height = -1;
+    pool.reset(t, order_stats);
+    if (sorted_keys.empty())
+    {
+        return;
+    }
+
+    // max_keys[h]: most keys a subtree of height h can hold, (2t)^(h+1) - 1
+    std::vector<long long> max_keys = {2LL * t - 1};
+    while (max_keys.back() < (long long)sorted_keys.size())
+    {
+        max_keys.push_back((max_keys.back() + 1) * 2 * t - 1);
+    }
+    root = build_sorted(sorted_keys.data(), sorted_keys.size(), (int)max_keys.size() - 1, max_keys, true, t - 1);
+}
+
+// replace the keys of the tree with sorted_keys, packing every node to about fill_factor of its capacity
+// Precondition: the tree has a valid degree, threads == 0 uses every hardware thread
+// Postcondition: returns true and the tree holds exactly sorted_keys with all leaves at the same depth,
+//                or returns false and leaves the tree unchanged if sorted_keys is not strictly ascending
+
+bool BTree::bulk_load(std::span<const int> sorted_keys, double fill_factor, unsigned threads)
+{
+    if (t < 2)
+    {
+        std::cerr << "Error: cannot bulk load a tree without a valid degree\n";
+        return false;
+    }
+    if (std::adjacent_find(sorted_keys.begin(), sorted_keys.end(), std::greater_equal<int>()) != sorted_keys.end())
+    {
+        std::cerr << "Error: bulk_load needs its keys strictly ascending\n";
+        return false;
+    }
+    close_image();
+    root = nullptr;
+    tombstones.clear();
+    messages.clear();
+    buffered_height = -1;
+    pool.reset(t, order_stats);
+    long long n = sorted_keys.size();
+    if (n == 0)
+    {
+        return true;
+    }
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    fill_factor = std::clamp(fill_factor, 0.0, 1.0);
+    long long leaf_keys = std::clamp<long long>(std::llround(fill_factor * (2 * t - 1)), t - 1, 2 * t - 1);
+    long long fanout = std::clamp<long long>(std::llround(fill_factor * 2 * t), t, 2 * t);
+
+    // Leaves: leaf j and the separator after it take keys start .. start+share, shares differ by at most one.
+    // At most (n+1)/t leaves keeps every share at t-1 or more.
+    // Internal levels: parent p takes `count` consecutive nodes and the separators between them,
+    // the separator after its last child goes up. At most m/t parents keeps every count at t or more.
+    std::vector<long long> counts = {std::max(1LL, std::min((n + 1 + leaf_keys) / (leaf_keys + 1), (n + 1) / t))};
+    while (counts.back() > 1)
+    {
+        long long m = counts.back();
+        long long parents = (m + fanout - 1) / fanout;
+        if (parents > 1)
+        {
+            parents = std::min(parents, m / t);
+        }
+        counts.push_back(parents);
+    }
+    size_t levels = counts.size();
+    std::vector<std::vector<Node *>> nodes(levels);
+    std::vector<std::vector<int>> seps(levels);       // seps[l][j]: the key between node j and node j+1 of level l
+    std::vector<std::vector<uint64_t>> sizes(levels); // keys in the subtree of each node, for the counts above
+    for (size_t l = 0; l < levels; l++)
+    {
+        nodes[l].resize(counts[l]);
+        for (Node *&x : nodes[l])
+        {
+            x = pool.alloc(l == 0);
+        }
+        seps[l].resize(counts[l] - 1);
+        sizes[l].resize(counts[l]);
+    }
+
+    const int *keys = sorted_keys.data();
+    parallel_fill(counts, threads, [&](size_t l, long long from, long long to) {
+        long long m = counts[l];
+        if (l == 0)
+        {
+            long long base = (n - (m - 1)) / m;
+            long long extra = (n - (m - 1)) % m;
+            for (long long j = from; j < to; j++)
+            {
+                long long share = base + (j < extra ? 1 : 0);
+                long long start = j * (base + 1) + std::min(j, extra);
+                std::copy(keys + start, keys + start + share, nodes[0][j]->keys);
+                nodes[0][j]->n = (int)share;
+                sizes[0][j] = share;
+                if (j + 1 < m)
+                {
+                    seps[0][j] = keys[start + share];
+                }
+            }
+            return;
+        }
+        long long base = counts[l - 1] / m;
+        long long extra = counts[l - 1] % m;
+        for (long long p = from; p < to; p++)
+        {
+            long long count = base + (p < extra ? 1 : 0);
+            long long first = p * base + std::min(p, extra);
+            Node *x = nodes[l][p];
+            uint64_t size = count - 1;
+            for (long long i = 0; i < count; i++)
+            {
+                x->c[i] = nodes[l - 1][first + i];
+                if (i + 1 < count)
+                {
+                    x->keys[i] = seps[l - 1][first + i];
+                }
+                if (order_stats)
+                {
+                    x->counts[i] = (uint32_t)sizes[l - 1][first + i];
+                }
+                size += sizes[l - 1][first + i];
+            }
+            x->n = (int)(count - 1);
+            sizes[l][p] = size;
+            if (p + 1 < m)
+            {
+                seps[l][p] = seps[l - 1][first + count - 1];
+            }
+        }
+    });
+    root = nodes[levels - 1][0];
+    return true;
+}
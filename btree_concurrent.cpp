@@ -0,0 +1,826 @@
+#include "btree_concurrent.h"
+#include <algorithm>
+#include <new>
+#include <queue>
+#include <type_traits>
+
+/*
+NOTE: Same cases as btree_insert.cpp and btree_delete.cpp (right sibling first in case 3), with these rules on top:
+- A node is read optimistically: remember its version, read, then validate. The child pointer read from a node is
+  only followed after the node validated, and the child's version is read before the parent is validated again,
+  so every step of a descent saw a parent and child that belonged together at one moment.
+- A writer locks a node it read optimistically with upgrade(version), so the lock fails if anybody changed the node
+  after it was read, and everything decided from that read (is the child full, does it have t keys) still holds.
+  Nodes reached from a locked parent are locked with lock(): only the holder of the parent can unlink them.
+- Locks are taken parent before child, and two siblings are only locked by the holder of their parent, so two
+  writers can never wait on each other in a cycle.
+- Case 2a/2b change a separator, which shrinks the key range of every node on the right (left) spine below it
+  without otherwise touching them. Those spine nodes are locked on the way down so their versions move.
+- Freed nodes go on a free list and are reused, but their memory is never released while the tree lives, and
+  a node is always locked (its version moves) when it is unlinked and again when it is reused.
+- The root pointer changes only with root_latch held: when the root splits, when its last key goes, or when its
+  two children merge. Writers that might do this take root_latch before the root.
+- Every field a reader looks at without the lock (root, n, leaf, keys, child pointers) is loaded with racy_load and
+  stored with racy_store, relaxed atomic_ref accesses: the version check orders them, the atomics only make the
+  racing access defined. So readers search keys with racy_rank, not the SIMD node_rank a lock holder uses.
+*/
+
+static const int RESTART = -1; // returned by the try_ helpers when a version check failed, the caller starts over
+
+static const size_t CACHE_LINE = 64;
+static const size_t FIRST_SLAB_BLOCKS = 64;
+static const size_t MAX_SLAB_BYTES = size_t(16) << 20;
+
+// Helper: read a field that a writer may be changing, the version check that follows decides if the value is used
+template <typename T>
+static T racy_load(T &field)
+{
+    return std::atomic_ref<T>(field).load(std::memory_order_relaxed);
+}
+
+// Helper: write a field that readers may load without the lock, the caller holds the lock of its node
+template <typename T>
+static void racy_store(T &field, std::type_identity_t<T> value)
+{
+    std::atomic_ref<T>(field).store(value, std::memory_order_relaxed);
+}
+
+// Helper: key count read without the lock, clamped so a torn value still indexes inside the node
+static int racy_count(LatchedNode *x, int t)
+{
+    return std::clamp(racy_load(x->n), 0, 2 * t - 1);
+}
+
+// Helper: node_rank for a node read without the lock, every key goes through racy_load
+static int racy_rank(LatchedNode *x, int n, int k)
+{
+    int lo = 0;
+    while (n > 0)
+    {
+        int half = n / 2;
+        if (racy_load(x->keys[lo + half]) < k)
+        {
+            lo += half + 1;
+            n -= half + 1;
+        }
+        else
+        {
+            n = half;
+        }
+    }
+    return lo;
+}
+
+ConcurrentBTree::ConcurrentBTree(int t)
+    : t(t < 2 ? 2 : t), root(nullptr), slab_blocks(FIRST_SLAB_BLOCKS), next_block(nullptr), blocks_left(0),
+      free_list(nullptr)
+{
+    size_t keys_end = sizeof(LatchedNode) + sizeof(int) * (2 * this->t - 1);
+    size_t c_start = (keys_end + alignof(LatchedNode *) - 1) & ~(alignof(LatchedNode *) - 1);
+    block_bytes = (c_start + sizeof(LatchedNode *) * 2 * this->t + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+}
+
+ConcurrentBTree::~ConcurrentBTree()
+{
+    for (char *slab : slabs)
+    {
+        ::operator delete(slab, std::align_val_t(CACHE_LINE));
+    }
+}
+
+// hand out an empty node, locked by the caller
+// Precondition: None
+// Postcondition: returns a locked node with n == 0, the given leaf flag and all child pointers set to nullptr
+
+LatchedNode *ConcurrentBTree::alloc(bool leaf)
+{
+    LatchedNode *x;
+    {
+        std::lock_guard<std::mutex> guard(pool_mutex);
+        if (free_list)
+        {
+            x = free_list;
+            free_list = x->next_free;
+        }
+        else
+        {
+            if (blocks_left == 0)
+            {
+                char *slab = static_cast<char *>(::operator new(slab_blocks * block_bytes, std::align_val_t(CACHE_LINE)));
+                slabs.push_back(slab);
+                next_block = slab;
+                blocks_left = slab_blocks;
+                if (slab_blocks * block_bytes * 2 <= MAX_SLAB_BYTES)
+                {
+                    slab_blocks *= 2;
+                }
+            }
+            char *block = next_block;
+            next_block += block_bytes;
+            blocks_left--;
+
+            x = new (block) LatchedNode();
+            x->keys = reinterpret_cast<int *>(block + sizeof(LatchedNode));
+            size_t c_start = (sizeof(LatchedNode) + sizeof(int) * (2 * t - 1) + alignof(LatchedNode *) - 1) &
+                             ~(alignof(LatchedNode *) - 1);
+            x->c = reinterpret_cast<LatchedNode **>(block + c_start);
+        }
+    }
+
+    // A late reader may still be reading a reused block
+    x->latch.lock();
+    racy_store(x->n, 0);
+    racy_store(x->leaf, leaf);
+    for (int i = 0; i < 2 * t; i++)
+    {
+        racy_store(x->c[i], nullptr);
+    }
+    return x;
+}
+
+// put an unlinked node on the free list
+// Precondition: x is locked by the caller and no longer reachable from the root
+// Postcondition: x is unlocked (so late readers see its version move) and may be handed out again by alloc()
+
+void ConcurrentBTree::retire(LatchedNode *x)
+{
+    x->latch.unlock();
+    std::lock_guard<std::mutex> guard(pool_mutex);
+    x->next_free = free_list;
+    free_list = x;
+}
+
+// return true if key k is in the btree
+// Precondition: None
+// Postcondition: the tree is unchanged, no lock is taken
+
+bool ConcurrentBTree::contains(int k)
+{
+    int found;
+    while ((found = find(k)) == RESTART)
+    {
+    }
+    return found;
+}
+
+// insert the key k into the btree
+// Precondition: None (handles empty tree case)
+// Postcondition: Key k is in the BTree (inserting a key that already exists does nothing)
+
+void ConcurrentBTree::insert(int k)
+{
+    while (try_insert(k) == RESTART)
+    {
+    }
+}
+
+// delete the key k from the btree
+// Precondition: None (handles empty tree case)
+// Postcondition: Key k is removed from the BTree if it exists, tree height may decrease if root becomes empty
+
+void ConcurrentBTree::remove(int k)
+{
+    while (try_remove(k) == RESTART)
+    {
+    }
+}
+
+// one optimistic descent looking for k
+// Precondition: None
+// Postcondition: returns 1 if k is in the tree, 0 if not, RESTART if a node changed while it was read
+
+int ConcurrentBTree::find(int k)
+{
+    uint64_t root_v = root_latch.read_begin();
+    LatchedNode *x = racy_load(root);
+    if (!x)
+    {
+        return root_latch.validate(root_v) ? 0 : RESTART;
+    }
+    uint64_t v = x->latch.read_begin();
+    if (!root_latch.validate(root_v))
+    {
+        return RESTART;
+    }
+
+    while (true)
+    {
+        int n = racy_count(x, t);
+        int i = racy_rank(x, n, k);
+        bool hit = i < n && racy_load(x->keys[i]) == k;
+        bool leaf = racy_load(x->leaf);
+        LatchedNode *child = (hit || leaf) ? nullptr : racy_load(x->c[i]);
+        if (!x->latch.validate(v))
+        {
+            return RESTART;
+        }
+        if (hit || leaf)
+        {
+            return hit;
+        }
+
+        uint64_t child_v = child->latch.read_begin();
+        if (!x->latch.validate(v))
+        {
+            return RESTART;
+        }
+        x = child;
+        v = child_v;
+    }
+}
+
+// one descent inserting k, splitting every full child on the way down like BTree::insert
+// Precondition: None
+// Postcondition: returns 1 if k was inserted, 0 if it was already there, RESTART if a node changed under the descent (nothing was changed then)
+
+int ConcurrentBTree::try_insert(int k)
+{
+    uint64_t root_v = root_latch.read_begin();
+    LatchedNode *x = racy_load(root);
+    uint64_t v = 0;
+    if (x)
+    {
+        v = x->latch.read_begin();
+        if (!root_latch.validate(root_v))
+        {
+            return RESTART;
+        }
+    }
+    bool locked = false;
+
+    // An empty tree or a full root changes the root pointer: take the root latch, then the root
+    if (!x || racy_load(x->n) == 2 * t - 1)
+    {
+        if (!root_latch.upgrade(root_v))
+        {
+            return RESTART;
+        }
+        if (!x)
+        {
+            x = alloc(true);
+            racy_store(x->keys[0], k);
+            racy_store(x->n, 1);
+            racy_store(root, x);
+            x->latch.unlock();
+            root_latch.unlock();
+            return 1;
+        }
+        if (!x->latch.upgrade(v))
+        {
+            root_latch.unlock();
+            return RESTART;
+        }
+        LatchedNode *new_root = alloc(false);
+        racy_store(new_root->c[0], x);
+        LatchedNode *z = split_child(new_root, 0);
+        racy_store(root, new_root);
+        x->latch.unlock();
+        z->latch.unlock();
+        root_latch.unlock();
+        x = new_root;
+        locked = true;
+    }
+
+    while (true)
+    {
+        int n = locked ? x->n : racy_count(x, t);
+        int i = locked ? node_rank(x->keys, n, k) : racy_rank(x, n, k);
+
+        // Key k is already in node x, nothing to do
+        if (i < n && racy_load(x->keys[i]) == k)
+        {
+            if (locked)
+            {
+                x->latch.unlock();
+                return 0;
+            }
+            return x->latch.validate(v) ? 0 : RESTART;
+        }
+
+        // x is a leaf and is not full (checked before we descended into it), so k goes at index i
+        if (racy_load(x->leaf))
+        {
+            if (!locked && !x->latch.upgrade(v))
+            {
+                return RESTART;
+            }
+            insert_leaf_key(x, i, k);
+            x->latch.unlock();
+            return 1;
+        }
+
+        LatchedNode *y = racy_load(x->c[i]);
+        if (!locked && !x->latch.validate(v))
+        {
+            return RESTART;
+        }
+        uint64_t y_v = y->latch.read_begin();
+        if (!locked && !x->latch.validate(v))
+        {
+            return RESTART;
+        }
+
+        if (racy_load(y->n) == 2 * t - 1)
+        {
+            // split the full child before descending into it: lock x, then y
+            if (!locked && !x->latch.upgrade(v))
+            {
+                return RESTART;
+            }
+            y->latch.lock();
+            if (y->n == 2 * t - 1)
+            {
+                LatchedNode *z = split_child(x, i);
+                if (k == x->keys[i])
+                {
+                    z->latch.unlock();
+                    y->latch.unlock();
+                    x->latch.unlock();
+                    return 0;
+                }
+                if (k > x->keys[i])
+                {
+                    y->latch.unlock();
+                    y = z;
+                }
+                else
+                {
+                    z->latch.unlock();
+                }
+            }
+            x->latch.unlock();
+            x = y;
+            locked = true;
+            continue;
+        }
+
+        // y has room: let go of x and carry on optimistically
+        if (locked)
+        {
+            x->latch.unlock();
+        }
+        x = y;
+        v = y_v;
+        locked = false;
+    }
+}
+
+// one descent removing k with the CLRS cases of BTree::remove
+// Precondition: None
+// Postcondition: returns 1 if k was removed, 0 if it was not in the tree, RESTART if a node changed under the descent (nothing was changed then)
+
+int ConcurrentBTree::try_remove(int k)
+{
+    uint64_t root_v = root_latch.read_begin();
+    LatchedNode *x = racy_load(root);
+    if (!x)
+    {
+        return root_latch.validate(root_v) ? 0 : RESTART;
+    }
+    uint64_t v = x->latch.read_begin();
+    if (!root_latch.validate(root_v))
+    {
+        return RESTART;
+    }
+
+    // A leaf root can lose its last key and a root with one key loses it when its two children merge,
+    // both replace the root pointer: take the root latch, then the root
+    bool locked = false;
+    bool root_locked = false;
+    if (racy_load(x->n) <= 1)
+    {
+        if (!root_latch.upgrade(root_v))
+        {
+            return RESTART;
+        }
+        if (!x->latch.upgrade(v))
+        {
+            root_latch.unlock();
+            return RESTART;
+        }
+        locked = true;
+        root_locked = true;
+    }
+
+    // Here x is the root or holds at least t keys
+    while (true)
+    {
+        int n = locked ? x->n : racy_count(x, t);
+        int i = locked ? node_rank(x->keys, n, k) : racy_rank(x, n, k);
+        bool hit = i < n && racy_load(x->keys[i]) == k;
+        bool leaf = racy_load(x->leaf);
+
+        // Case 1: Key k in node x, and x is leaf node. Or no key k in the tree.
+        if (leaf)
+        {
+            if (!hit)
+            {
+                if (!locked)
+                {
+                    return x->latch.validate(v) ? 0 : RESTART;
+                }
+                x->latch.unlock();
+                if (root_locked)
+                {
+                    root_latch.unlock();
+                }
+                return 0;
+            }
+            if (!locked && !x->latch.upgrade(v))
+            {
+                return RESTART;
+            }
+            remove_leaf_key(x, i);
+            if (root_locked && x->n == 0)
+            {
+                racy_store(root, nullptr);
+                retire(x);
+            }
+            else
+            {
+                x->latch.unlock();
+            }
+            if (root_locked)
+            {
+                root_latch.unlock();
+            }
+            return 1;
+        }
+
+        // Case 2: Key k in node x, and x is inside node (not leaf).
+        if (hit)
+        {
+            if (!locked && !x->latch.upgrade(v))
+            {
+                return RESTART;
+            }
+            locked = true;
+            LatchedNode *left_node = x->c[i];
+            LatchedNode *right_node = x->c[i + 1];
+            left_node->latch.lock();
+
+            // Case 2-a: left child node left_node has at least t keys
+            if (left_node->n >= t)
+            {
+                remove_max(x, i, left_node, root_locked);
+                return 1;
+            }
+
+            // Case 2-b: left node has t-1 keys but right node has at least t keys
+            right_node->latch.lock();
+            if (right_node->n >= t)
+            {
+                left_node->latch.unlock();
+                remove_min(x, i, right_node, root_locked);
+                return 1;
+            }
+
+            // Case 2-c: both have t-1 keys, merge them around k and remove k from the merged node
+            merge_left(left_node, right_node, k);
+            remove_internal_key(x, i, i + 1);
+            release_parent(x, left_node, root_locked);
+            x = left_node;
+            continue;
+        }
+
+        // Case 3: Key k is not in node x, descend into x->c[i]
+        LatchedNode *next = racy_load(x->c[i]);
+        if (!locked && !x->latch.validate(v))
+        {
+            return RESTART;
+        }
+        uint64_t next_v = next->latch.read_begin();
+        if (!locked && !x->latch.validate(v))
+        {
+            return RESTART;
+        }
+
+        // next has at least t keys: let go of x and carry on optimistically
+        if (racy_load(next->n) >= t)
+        {
+            if (locked)
+            {
+                release_parent(x, next, root_locked);
+            }
+            x = next;
+            v = next_v;
+            locked = false;
+            continue;
+        }
+
+        // next has t-1 keys: lock x and next and give next a key from a sibling (3a) or merge it (3b)
+        if (!locked && !x->latch.upgrade(v))
+        {
+            return RESTART;
+        }
+        locked = true;
+        next->latch.lock();
+        next = fix_child(x, i, next);
+        release_parent(x, next, root_locked);
+        x = next;
+    }
+}
+
+// let go of x once its child y can take a removal by itself, replacing the root if x is a root that lost its last key
+// Precondition: x is locked, root_locked is true if root_latch is held and x is the root, y is x's only child if x->n == 0
+// Postcondition: x is unlocked or retired, root_latch is released, y becomes the root if x had no keys left
+
+void ConcurrentBTree::release_parent(LatchedNode *x, LatchedNode *y, bool &root_locked)
+{
+    if (root_locked && x->n == 0)
+    {
+        racy_store(root, y);
+        retire(x);
+    }
+    else
+    {
+        x->latch.unlock();
+    }
+    if (root_locked)
+    {
+        root_latch.unlock();
+        root_locked = false;
+    }
+}
+
+// make sure the child y = x->c[i] has at least t keys before we descend into it (Case 3 of BTree::remove)
+// Precondition: x and y are locked, y is x->c[i]
+// Postcondition: returns the locked node that now holds y's keys (y, or its left sibling after a merge), it has at least t keys,
+//                every sibling locked on the way is unlocked or retired again
+
+LatchedNode *ConcurrentBTree::fix_child(LatchedNode *x, int i, LatchedNode *y)
+{
+    if (y->n >= t)
+    {
+        return y;
+    }
+    LatchedNode *left_sib = (i > 0) ? x->c[i - 1] : nullptr;
+    LatchedNode *right_sib = (i < x->n) ? x->c[i + 1] : nullptr;
+
+    // Check right sibling first if the right sibling has enough keys
+    if (right_sib)
+    {
+        right_sib->latch.lock();
+        if (right_sib->n > t - 1)
+        {
+            swap_right(x, y, right_sib, i);
+            right_sib->latch.unlock();
+            return y;
+        }
+    }
+
+    // Then check left sibling if the left sibling has enough keys
+    if (left_sib)
+    {
+        left_sib->latch.lock();
+        if (left_sib->n > t - 1)
+        {
+            swap_left(x, y, left_sib, i - 1);
+            left_sib->latch.unlock();
+            if (right_sib)
+            {
+                right_sib->latch.unlock();
+            }
+            return y;
+        }
+    }
+
+    // Both siblings don't have enough keys: merge with right sibling if possible, else with the left one
+    if (right_sib)
+    {
+        merge_left(y, right_sib, x->keys[i]);
+        remove_internal_key(x, i, i + 1);
+        if (left_sib)
+        {
+            left_sib->latch.unlock();
+        }
+        return y;
+    }
+    merge_left(left_sib, y, x->keys[i - 1]);
+    remove_internal_key(x, i - 1, i);
+    return left_sib;
+}
+
+// Case 2-a: replace x->keys[i] with its predecessor and remove the predecessor from the subtree of y
+// Precondition: x and y = x->c[i] are locked, y has at least t keys, root_locked is true if root_latch is held
+// Postcondition: the predecessor replaced x->keys[i] and is gone from y's subtree, every lock is released
+// The right spine of y is locked node by node: the new separator shrinks the key range of all of it.
+
+void ConcurrentBTree::remove_max(LatchedNode *x, int i, LatchedNode *y, bool root_locked)
+{
+    LatchedNode *s = y;
+    while (!s->leaf)
+    {
+        LatchedNode *next = s->c[s->n];
+        next->latch.lock();
+        next = fix_child(s, s->n, next);
+        s->latch.unlock();
+        s = next;
+    }
+
+    // The predecessor is visible in x before it leaves the leaf
+    racy_store(x->keys[i], s->keys[s->n - 1]);
+    x->latch.unlock();
+    if (root_locked)
+    {
+        root_latch.unlock();
+    }
+    racy_store(s->n, s->n - 1);
+    s->latch.unlock();
+}
+
+// Case 2-b: replace x->keys[i] with its successor and remove the successor from the subtree of z
+// Precondition: x and z = x->c[i+1] are locked, z has at least t keys, root_locked is true if root_latch is held
+// Postcondition: the successor replaced x->keys[i] and is gone from z's subtree, every lock is released
+
+void ConcurrentBTree::remove_min(LatchedNode *x, int i, LatchedNode *z, bool root_locked)
+{
+    LatchedNode *s = z;
+    while (!s->leaf)
+    {
+        LatchedNode *next = s->c[0];
+        next->latch.lock();
+        next = fix_child(s, 0, next);
+        s->latch.unlock();
+        s = next;
+    }
+
+    racy_store(x->keys[i], s->keys[0]);
+    x->latch.unlock();
+    if (root_locked)
+    {
+        root_latch.unlock();
+    }
+    remove_leaf_key(s, 0);
+    s->latch.unlock();
+}
+
+// split the full child y = x->c[i] around its median key
+// Precondition: x and y are locked, x is not full, y has exactly 2t-1 keys
+// Postcondition: same as BTree::split_child, returns the new right half z, locked
+
+LatchedNode *ConcurrentBTree::split_child(LatchedNode *x, int i)
+{
+    LatchedNode *y = x->c[i];
+    LatchedNode *z = alloc(y->leaf);
+
+    for (int j = 0; j < t - 1; j++)
+    {
+        racy_store(z->keys[j], y->keys[j + t]);
+    }
+    if (!y->leaf)
+    {
+        for (int j = 0; j < t; j++)
+        {
+            racy_store(z->c[j], y->c[j + t]);
+            racy_store(y->c[j + t], nullptr);
+        }
+    }
+    racy_store(z->n, t - 1);
+    racy_store(y->n, t - 1);
+
+    for (int j = x->n; j > i; j--)
+    {
+        racy_store(x->c[j + 1], x->c[j]);
+    }
+    racy_store(x->c[i + 1], z);
+    for (int j = x->n - 1; j >= i; j--)
+    {
+        racy_store(x->keys[j + 1], x->keys[j]);
+    }
+    racy_store(x->keys[i], y->keys[t - 1]);
+    racy_store(x->n, x->n + 1);
+    return z;
+}
+
+// insert the key k at index i of a locked, non-full leaf x
+void ConcurrentBTree::insert_leaf_key(LatchedNode *x, int i, int k)
+{
+    for (int j = x->n; j > i; j--)
+    {
+        racy_store(x->keys[j], x->keys[j - 1]);
+    }
+    racy_store(x->keys[i], k);
+    racy_store(x->n, x->n + 1);
+}
+
+// remove the key at index i from a locked leaf x
+void ConcurrentBTree::remove_leaf_key(LatchedNode *x, int i)
+{
+    for (int j = i; j < x->n - 1; j++)
+    {
+        racy_store(x->keys[j], x->keys[j + 1]);
+    }
+    racy_store(x->n, x->n - 1);
+}
+
+// remove the key at index i and child at index j from a locked internal node x
+void ConcurrentBTree::remove_internal_key(LatchedNode *x, int i, int j)
+{
+    for (int m = i; m < x->n - 1; m++)
+    {
+        racy_store(x->keys[m], x->keys[m + 1]);
+    }
+    for (int m = j; m < x->n; m++)
+    {
+        racy_store(x->c[m], x->c[m + 1]);
+    }
+    racy_store(x->n, x->n - 1);
+}
+
+// merge separator k and the locked right sibling y into the locked node x, y is retired
+void ConcurrentBTree::merge_left(LatchedNode *x, LatchedNode *y, int k)
+{
+    racy_store(x->keys[x->n], k);
+    for (int i = 0; i < y->n; i++)
+    {
+        racy_store(x->keys[x->n + 1 + i], y->keys[i]);
+    }
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= y->n; i++)
+        {
+            racy_store(x->c[x->n + 1 + i], y->c[i]);
+        }
+    }
+    racy_store(x->n, x->n + y->n + 1);
+    retire(y);
+}
+
+// give y a key through x from its locked LEFT sibling z, x->keys[i] separates z and y
+void ConcurrentBTree::swap_left(LatchedNode *x, LatchedNode *y, LatchedNode *z, int i)
+{
+    for (int j = y->n - 1; j >= 0; j--)
+    {
+        racy_store(y->keys[j + 1], y->keys[j]);
+    }
+    if (!y->leaf)
+    {
+        for (int j = y->n; j >= 0; j--)
+        {
+            racy_store(y->c[j + 1], y->c[j]);
+        }
+        racy_store(y->c[0], z->c[z->n]);
+    }
+    racy_store(y->keys[0], x->keys[i]);
+    racy_store(x->keys[i], z->keys[z->n - 1]);
+    racy_store(y->n, y->n + 1);
+    racy_store(z->n, z->n - 1);
+}
+
+// give y a key through x from its locked RIGHT sibling z, x->keys[i] separates y and z
+void ConcurrentBTree::swap_right(LatchedNode *x, LatchedNode *y, LatchedNode *z, int i)
+{
+    racy_store(y->keys[y->n], x->keys[i]);
+    if (!y->leaf)
+    {
+        racy_store(y->c[y->n + 1], z->c[0]);
+    }
+    racy_store(x->keys[i], z->keys[0]);
+    for (int j = 0; j < z->n - 1; j++)
+    {
+        racy_store(z->keys[j], z->keys[j + 1]);
+    }
+    if (!z->leaf)
+    {
+        for (int j = 0; j < z->n; j++)
+        {
+            racy_store(z->c[j], z->c[j + 1]);
+        }
+    }
+    racy_store(y->n, y->n + 1);
+    racy_store(z->n, z->n - 1);
+}
+
+// For debugging
+void ConcurrentBTree::print(std::ostream &out)
+{
+    if (!root)
+        return;
+
+    std::queue<LatchedNode *> q;
+    q.push(root);
+    while (!q.empty())
+    {
+        int level_n = q.size();
+        for (int i = 0; i < level_n; i++)
+        {
+            LatchedNode *node = q.front();
+            q.pop();
+            for (int j = 0; j < node->n; j++)
+            {
+                out << node->keys[j];
+                if (j < node->n - 1)
+                    out << ",";
+            }
+            if (i < level_n - 1)
+                out << "\t";
+            if (!node->leaf)
+            {
+                for (int j = 0; j <= node->n; j++)
+                    q.push(node->c[j]);
+            }
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef BTREE_CONCURRENT_H
+#define BTREE_CONCURRENT_H
+
+#include "btree.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/*
+NOTE: Thread-safe BTree with optimistic lock coupling. Every node carries a version lock.
+contains() never writes shared memory: it reads a node, then checks that the node's version did not move,
+and starts over from the root if it did. insert() and remove() descend the same way and only lock a node
+when the CLRS single-pass algorithm is about to change it: the node that gets a key, or the parent of a child
+that must be split (insert) or must be given a key (remove, cases 2 and 3). Because CLRS fixes a child
+before descending into it, the parent is released as soon as the child is fixed, so a writer holds at most
+a parent, a child and the child's sibling at once.
+*/
+
+// Version lock: the version is even while the lock is free and odd while a writer holds it, unlock moves it
+// to the next even value. A reader that sees the same even version before and after reading a node read a
+// consistent node.
+class VersionLock
+{
+private:
+    std::atomic<uint64_t> version{0};
+
+public:
+    // wait until no writer holds the lock, return the version
+    uint64_t read_begin() const
+    {
+        uint64_t v = version.load(std::memory_order_acquire);
+        for (int spins = 0; v & 1; spins++)
+        {
+            if (spins > 64)
+                std::this_thread::yield();
+            v = version.load(std::memory_order_acquire);
+        }
+        return v;
+    }
+
+    // true if no writer locked since read_begin returned v
+    bool validate(uint64_t v) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version.load(std::memory_order_relaxed) == v;
+    }
+
+    // lock only if no writer locked since read_begin returned v
+    bool upgrade(uint64_t v)
+    {
+        if (!version.compare_exchange_strong(v, v + 1, std::memory_order_acquire))
+            return false;
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void lock()
+    {
+        while (!upgrade(read_begin()))
+        {
+        }
+    }
+
+    void unlock() { version.fetch_add(1, std::memory_order_release); }
+};
+
+// A node of ConcurrentBTree, one block laid out as [LatchedNode | 2t-1 keys | 2t child pointers]
+// keys and c are set once when the block is first cut from a slab, so a reader holding a stale pointer
+// to a freed block still reads inside the block.
+struct LatchedNode
+{
+    VersionLock latch;
+    int n;
+    bool leaf;
+    int *keys;
+    LatchedNode **c;
+    LatchedNode *next_free; // free list link, apart from the fields a late reader may still look at
+};
+
+class ConcurrentBTree
+{
+private:
+    int t;
+    VersionLock root_latch; // guards the root pointer
+    LatchedNode *root;
+
+    // Node blocks are only given back to the system when the tree is destroyed
+    std::mutex pool_mutex;
+    std::vector<char *> slabs;
+    size_t block_bytes;
+    size_t slab_blocks; // blocks in the next slab
+    char *next_block;
+    size_t blocks_left;
+    LatchedNode *free_list;
+
+    ConcurrentBTree(const ConcurrentBTree &) = delete;
+    ConcurrentBTree &operator=(const ConcurrentBTree &) = delete;
+
+    LatchedNode *alloc(bool leaf);
+    void retire(LatchedNode *x);
+
+    int find(int k);
+    int try_insert(int k);
+    int try_remove(int k);
+    void release_parent(LatchedNode *x, LatchedNode *y, bool &root_locked);
+    LatchedNode *fix_child(LatchedNode *x, int i, LatchedNode *y);
+    void remove_max(LatchedNode *x, int i, LatchedNode *y, bool root_locked);
+    void remove_min(LatchedNode *x, int i, LatchedNode *z, bool root_locked);
+
+    LatchedNode *split_child(LatchedNode *x, int i);
+    void insert_leaf_key(LatchedNode *x, int i, int k);
+    void remove_leaf_key(LatchedNode *x, int i);
+    void remove_internal_key(LatchedNode *x, int i, int j);
+    void merge_left(LatchedNode *x, LatchedNode *y, int k);
+    void swap_left(LatchedNode *x, LatchedNode *y, LatchedNode *z, int i);
+    void swap_right(LatchedNode *x, LatchedNode *y, LatchedNode *z, int i);
+
+public:
+    explicit ConcurrentBTree(int t);
+    ~ConcurrentBTree();
+    int degree() const { return t; }
+
+    // Safe to call from any number of threads at once
+    bool contains(int k);
+    void insert(int k);
+    void remove(int k);
+
+    // For debugging, same format as BTree::print, only while no other thread uses the tree
+    void print(std::ostream &out = std::cout);
+};
+
+#endif
@@ -0,0 +1,385 @@
+#include "btree.h"
+#include <climits>
+
+/*
+NOTE: In-order walk with an explicit path stack instead of parent pointers (nodes do not store them).
+A step either moves within a leaf, goes down one subtree to its first/last key, or pops up to the
+nearest ancestor that still has a key on that side. Every node is pushed and popped at most once
+per full scan, so a step costs O(1) amortized and O(height) at worst.
+Buffered messages are merged in instead of applied: settle skips node keys whose newest message is a remove,
+and stops on the key of an insert message when it comes before the next node key. Stepping off such a key
+searches the nodes again from it, O(height). Only the messages between two keys are read on each step.
+A cursor on a snapshot does the same with the tombstones and messages the snapshot copied from the tree.
+*/
+
+// Helper: true if any level holds a message
+static bool any_message(const std::vector<MessageLevel> *messages)
+{
+    if (messages)
+    {
+        for (const MessageLevel &level : *messages)
+        {
+            if (!level.empty())
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Cursor that is not positioned on any key yet
+// Precondition: None
+// Postcondition: valid() is false until one of the seek functions succeeds
+
+BTree::Cursor::Cursor(BTree &tree)
+    : tree(&tree), snap_root(nullptr), tombstones(&tree.tombstones), messages(&tree.messages)
+{
+    tree.materialize();
+}
+
+BTree::Cursor::Cursor(const Snapshot &snap)
+    : tree(nullptr), snap_root(snap.root), tombstones(snap.pending ? &snap.pending->tombstones : nullptr),
+      messages(snap.pending ? &snap.pending->messages : nullptr)
+{
+}
+
+// move to the first key >= k
+// Precondition: None (handles empty tree case)
+// Postcondition: returns true and the cursor is on the smallest key >= k, or returns false and valid() is false if every key is < k
+
+bool BTree::Cursor::seek(int k)
+{
+    find(k);
+    settle(true, (long long)k - 1);
+    return valid();
+}
+
+// put path on the smallest key >= k in the nodes, tombstones and buffered removes included
+void BTree::Cursor::find(int k)
+{
+    on_message = false;
+    path.clear();
+    Node *x = root();
+    while (x != nullptr)
+    {
+        int i = node_rank(x->keys, x->n, k);
+        path.push_back({x, i});
+        if ((i < x->n && x->keys[i] == k) || x->leaf)
+        {
+            break;
+        }
+        x = x->c[i];
+    }
+    // We stopped in a leaf past its last key, the answer is the next separator up the path
+    if (!path.empty() && path.back().i == path.back().x->n)
+    {
+        ascend_next();
+    }
+}
+
+// move to the smallest key in the tree
+// Precondition: None (handles empty tree case)
+// Postcondition: returns true and the cursor is on the smallest key, or returns false if the tree is empty
+
+bool BTree::Cursor::seek_first()
+{
+    on_message = false;
+    path.clear();
+    if (root() && root()->n > 0)
+    {
+        descend_first(root());
+    }
+    settle(true, LLONG_MIN);
+    return valid();
+}
+
+// move to the largest key in the tree
+// Precondition: None (handles empty tree case)
+// Postcondition: returns true and the cursor is on the largest key, or returns false if the tree is empty
+
+bool BTree::Cursor::seek_last()
+{
+    on_message = false;
+    path.clear();
+    if (root() && root()->n > 0)
+    {
+        descend_last(root());
+    }
+    settle(false, LLONG_MAX);
+    return valid();
+}
+
+// move to the key with exactly i smaller keys
+// Precondition: the tree keeps order statistics (BTree::set_order_stats), has no tombstones and no buffered messages
+// Postcondition: returns true and the cursor is on that key, or returns false and valid() is false if the tree holds i keys or fewer
+
+bool BTree::Cursor::seek_rank(size_t i)
+{
+    on_message = false;
+    path.clear();
+    Node *x = root();
+    while (x != nullptr && !x->leaf)
+    {
+        // skip whole children (and the key right of each) until the one that holds rank i
+        int j = 0;
+        while (j <= x->n && i >= x->counts[j])
+        {
+            i -= x->counts[j];
+            if (j < x->n && i == 0)
+            {
+                path.push_back({x, j});
+                return true;
+            }
+            if (j < x->n)
+            {
+                i--;
+            }
+            j++;
+        }
+        if (j > x->n)
+        {
+            path.clear(); // i is past the last key
+            return false;
+        }
+        path.push_back({x, j});
+        x = x->c[j];
+    }
+    if (x == nullptr || i >= (size_t)x->n)
+    {
+        path.clear();
+        return false;
+    }
+    path.push_back({x, (int)i});
+    return true;
+}
+
+// move to the next larger key
+// Precondition: None
+// Postcondition: returns true and the cursor is on the successor of the current key, or returns false and valid() is false if there is none
+
+bool BTree::Cursor::next()
+{
+    if (!valid())
+    {
+        return false;
+    }
+    int k = key();
+    if (on_message)
+    {
+        find(k); // k is in no node, so this is the next node key
+    }
+    else
+    {
+        step_next();
+    }
+    settle(true, k);
+    return valid();
+}
+
+// move to the next smaller key
+// Precondition: None
+// Postcondition: returns true and the cursor is on the predecessor of the current key, or returns false and valid() is false if there is none
+
+bool BTree::Cursor::prev()
+{
+    if (!valid())
+    {
+        return false;
+    }
+    int k = key();
+    if (on_message)
+    {
+        find(k);
+        if (!path.empty())
+        {
+            step_prev();
+        }
+        else if (root() && root()->n > 0)
+        {
+            descend_last(root()); // every node key is smaller than k
+        }
+    }
+    else
+    {
+        step_prev();
+    }
+    settle(false, k);
+    return valid();
+}
+
+// move to the key right after the current one, tombstones included
+void BTree::Cursor::step_next()
+{
+    Step &top = path.back();
+    if (!top.x->leaf)
+    {
+        // successor is the smallest key in the subtree right of the current key
+        top.i++;
+        descend_first(top.x->c[top.i]);
+    }
+    else if (top.i + 1 < top.x->n)
+    {
+        top.i++;
+    }
+    else
+    {
+        ascend_next();
+    }
+}
+
+// move to the key right before the current one, tombstones included
+void BTree::Cursor::step_prev()
+{
+    Step &top = path.back();
+    if (!top.x->leaf)
+    {
+        // predecessor is the largest key in the subtree left of the current key
+        descend_last(top.x->c[top.i]);
+    }
+    else if (top.i > 0)
+    {
+        top.i--;
+    }
+    else
+    {
+        ascend_prev();
+    }
+}
+
+// step past node keys the tree (or the tree the snapshot was taken of) removed lazily or by a buffered message,
+// forward or backward
+void BTree::Cursor::skip_tombstones(bool forward)
+{
+    bool dead_keys = tombstones && !tombstones->empty();
+    if (!dead_keys && !any_message(messages))
+    {
+        return;
+    }
+    while (!path.empty())
+    {
+        bool insert;
+        if ((messages && find_message(*messages, key(), insert)) ? insert : !(dead_keys && tombstones->count(key())))
+        {
+            break; // the newest message for the key, or else the tombstones, keep it
+        }
+        if (forward)
+            step_next();
+        else
+            step_prev();
+    }
+}
+
+// path is on the first node key past from (larger if forward, else smaller) or empty, move to the first key
+// of the tree past from: skip node keys that are removed, then take the nearest buffered insert before the node key
+void BTree::Cursor::settle(bool forward, long long from)
+{
+    on_message = false;
+    skip_tombstones(forward);
+    if (!any_message(messages))
+    {
+        return;
+    }
+    long long k = from;
+    int m;
+    while (next_message(*messages, k, forward, m))
+    {
+        if (!path.empty() && (forward ? m >= key() : m <= key()))
+        {
+            return; // the node key comes first (or is the same key)
+        }
+        bool insert;
+        find_message(*messages, m, insert);
+        if (insert)
+        {
+            on_message = true;
+            message_key = m;
+            return;
+        }
+        k = m;
+    }
+}
+
+// two cursors are equal when both are past the end or both sit on the same key of the same tree
+bool BTree::Cursor::operator==(const Cursor &other) const
+{
+    if (!valid() || !other.valid())
+    {
+        return valid() == other.valid();
+    }
+    if (on_message || other.on_message)
+    {
+        return on_message == other.on_message && message_key == other.message_key;
+    }
+    return path.back().x == other.path.back().x && path.back().i == other.path.back().i;
+}
+
+// push x and the leftmost path below it, stopping on the first key of the leftmost leaf
+void BTree::Cursor::descend_first(Node *x)
+{
+    while (!x->leaf)
+    {
+        path.push_back({x, 0});
+        x = x->c[0];
+    }
+    path.push_back({x, 0});
+}
+
+// push x and the rightmost path below it, stopping on the last key of the rightmost leaf
+void BTree::Cursor::descend_last(Node *x)
+{
+    while (!x->leaf)
+    {
+        path.push_back({x, x->n});
+        x = x->c[x->n];
+    }
+    path.push_back({x, x->n - 1});
+}
+
+// pop the finished node and every ancestor we left through its last child,
+// then stop on the separator right of the child we came from (path is empty if there is none)
+void BTree::Cursor::ascend_next()
+{
+    path.pop_back();
+    while (!path.empty() && path.back().i == path.back().x->n)
+    {
+        path.pop_back();
+    }
+}
+
+// pop the finished node and every ancestor we left through its first child,
+// then stop on the separator left of the child we came from (path is empty if there is none)
+void BTree::Cursor::ascend_prev()
+{
+    path.pop_back();
+    while (!path.empty() && path.back().i == 0)
+    {
+        path.pop_back();
+    }
+    if (!path.empty())
+    {
+        path.back().i--;
+    }
+}
+
+// iterator on the smallest key
+BTree::iterator BTree::begin()
+{
+    Cursor cur(*this);
+    cur.seek_first();
+    return iterator(cur);
+}
+
+// iterator past the largest key
+BTree::iterator BTree::end()
+{
+    return iterator(Cursor(*this));
+}
+
+// iterator on the smallest key >= k, or end() if there is none
+BTree::iterator BTree::lower_bound(int k)
+{
+    Cursor cur(*this);
+    cur.seek(k);
+    return iterator(cur);
+}
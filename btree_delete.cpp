@@ -1,7 +1,9 @@
 #include "btree.h"
+#include "btree_paged.h"
 
 /*
 NOTE: Please follow logic from CLRSv4 directly. Additionally, in cases 3a and 3b please check for an immediate right sibling first.
+The cases are templates over the tree (ClrsDelete in btree.h) so that PagedBTree runs them on its pages unchanged.
 */
 
 // delete the key k from the btree
@@ -10,13 +12,49 @@ NOTE: Please follow logic from CLRSv4 directly. Additionally, in cases 3a and 3b
 
 void BTree::remove(int k)
 {
+    materialize(); // a mapped image is read-only, copy it into nodes on the first write
 
     if (!root)
     {
         return;
     }
+    if (buffered && !root->leaf)
+    {
+        buffer_message(k, false); // btree_buffered.cpp
+        return;
+    }
+    if (lazy_remove)
+    {
+        remove_lazy(k); // btree_lazy.cpp
+        return;
+    }
+    remove_now(k);
+}
+
+// remove the key k from the nodes right away, the part of remove() that lazy and buffered removes defer
+// Precondition: the tree is materialized
+// Postcondition: same as remove(int) without lazy remove
 
-    remove(root, k, true);
+void BTree::remove_now(int k)
+{
+    if (!root)
+    {
+        return;
+    }
+    if (!tombstones.empty())
+    {
+        tombstones.erase(k); // k may still sit in its node as a tombstone
+    }
+
+    own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+    if (policy == DeletePolicy::Strict)
+    {
+        remove(root, k, true);
+    }
+    else
+    {
+        remove_relaxed(k); // btree_relaxed.cpp
+    }
 
     // removing the node that has key is k
     // 1. If the number of keys (n) on the root node is 0 (root -> n == 0)
@@ -25,32 +63,45 @@ void BTree::remove(int k)
 
     if (root->n == 0 && !root->leaf)
     {
+        BTREE_COUNT(ROOT_COLLAPSES, 1);
         Node *old_Root = root; // temporary save node
         root = root->c[0];     // root = root -> c[0]
-        delete old_Root;       // prevent memory leak
+        pool.free(old_Root);       // prevent memory leak
     }
     else if (root->n == 0 && root->leaf) // if the root is leaf node and has 0 keys
     {
-        delete root; // delete root
+        pool.free(root); // delete root
         root = nullptr;
     }
 }
 
 // delete the key k from the btree rooted at x
-// Precondition: x is a valid node pointer, x is the root if x_root is true
-// Postcondition: Key k is removed from the subtree rooted at x if it exists, node x may be modified to maintain B-Tree properties (minimum t-1 keys except root)
+// Precondition: x is a valid node, changed nodes are owned through tree.own (a BTree root is owned by the caller)
+// Postcondition: Key k is removed from the subtree rooted at x if it exists, node x may be modified to maintain B-Tree properties (minimum t-1 keys except root),
+//                the case gives up where a child cannot be read (a paged tree whose BufferPool failed)
 
-void BTree::remove(Node *x, int k, bool x_root)
+template <typename Tree>
+void ClrsDelete<Tree>::remove(Tree &tree, NodeRef x, int k)
 {
-    while (x != nullptr)
+    const int t = tree.t;
+    // with order statistics, the subtree counts on the path shrink by one once k is found
+    uint32_t *path_counts[MAX_HEIGHT];
+    int depth = 0;
+
+    while (x)
     {
-        int i = find_k(x, k);
+        int i = tree.find_k(x, k);
 
         // Case 1 : Key k in node x, and x is leaf node.
 
         if (i < x->n && x->keys[i] == k && x->leaf)
         {
-            remove_leaf_key(x, i);
+            BTREE_COUNT(REMOVE_CASE_1, 1);
+            remove_leaf_key(tree, x, i);
+            for (int d = 0; d < depth; d++)
+            {
+                (*path_counts[d])--;
+            }
             return;
         }
 
@@ -59,41 +110,93 @@ void BTree::remove(Node *x, int k, bool x_root)
         if (i < x->n && x->keys[i] == k && !x->leaf)
         {
             // left and right node of key k that should delete. (left child= precede k, right child= follows k)
-            Node *left_node = x->c[i];      // Left-side
-            Node *right_node = x->c[i + 1]; // Right-side
+            NodeRef left_node = tree.child(x, i); // Left-side
+            if (!left_node)
+            {
+                return;
+            }
 
             // Case 2-a: left child node left_node has at least t nodes
             if (left_node->n >= t)
             {
+                BTREE_COUNT(REMOVE_CASE_2A, 1);
+                left_node = tree.own(x, i);
                 // find k's predecessor from left_node
-                int pred = max_key(left_node);
+                int pred;
+                if (!max_key(tree, left_node, pred))
+                {
+                    return;
+                }
 
                 // replace x.keys[i] into predecessor
+                tree.mark_dirty(x);
                 x->keys[i] = pred;
 
                 // remove predecessor from left_node (recurssively)
-                remove(left_node, pred, false);
-            }
-
-            // Case 2-b: left node has t-1 keys but right node has at least t keys (left node can not be extracted(min key req) but right node is available)
-            else if (right_node->n >= t)
-            {
-                int succ = min_key(right_node);
-
-                x->keys[i] = succ;
-                // remove predecessor from left_node (recurssively)
-                remove(right_node, succ, false);
+                remove(tree, std::move(left_node), pred);
+                if constexpr (Tree::COUNTED)
+                {
+                    if (tree.order_stats)
+                    {
+                        path_counts[depth++] = &x->counts[i];
+                    }
+                }
             }
-
-            // Case 2-c: both left and right node is not available since both has t-1 keys
             else
             {
+                NodeRef right_node = tree.child(x, i + 1); // Right-side
+                if (!right_node)
+                {
+                    return;
+                }
 
-                merge_left(left_node, right_node, k);
-
-                remove_internal_key(x, i, i + 1);
+                // Case 2-b: left node has t-1 keys but right node has at least t keys (left node can not be extracted(min key req) but right node is available)
+                if (right_node->n >= t)
+                {
+                    BTREE_COUNT(REMOVE_CASE_2B, 1);
+                    right_node = tree.own(x, i + 1);
+                    int succ;
+                    if (!min_key(tree, right_node, succ))
+                    {
+                        return;
+                    }
+
+                    tree.mark_dirty(x);
+                    x->keys[i] = succ;
+                    // remove predecessor from left_node (recurssively)
+                    remove(tree, std::move(right_node), succ);
+                    if constexpr (Tree::COUNTED)
+                    {
+                        if (tree.order_stats)
+                        {
+                            path_counts[depth++] = &x->counts[i + 1];
+                        }
+                    }
+                }
 
-                remove(left_node, k, false);
+                // Case 2-c: both left and right node is not available since both has t-1 keys
+                else
+                {
+                    BTREE_COUNT(REMOVE_CASE_2C, 1);
+                    left_node = tree.own(x, i);
+                    right_node = tree.own(x, i + 1);
+                    merge_left(tree, left_node, right_node, k);
+
+                    remove_internal_key(tree, x, i, i + 1);
+
+                    remove(tree, std::move(left_node), k);
+                    if constexpr (Tree::COUNTED)
+                    {
+                        if (tree.order_stats)
+                        {
+                            path_counts[depth++] = &x->counts[i];
+                        }
+                    }
+                }
+            }
+            for (int d = 0; d < depth; d++)
+            {
+                (*path_counts[d])--;
             }
             return; // Finishing up the Case 2
         }
@@ -110,36 +213,70 @@ void BTree::remove(Node *x, int k, bool x_root)
 
         else // x is an internal node and does not contain key k
         {
-            Node *next = x->c[i];
-            Node *left_sib = (i > 0) ? x->c[i - 1] : nullptr;
-            Node *right_sib = (i < x->n) ? x->c[i + 1] : nullptr;
+            NodeRef next = tree.own(x, i);
+            if (!next)
+            {
+                return;
+            }
 
             if (next->n == (t - 1))
             {
-                // Check right sibling first if the right sibling has enough keys
-                if (right_sib != nullptr && right_sib->n > t - 1)
+                NodeRef right_sib = (i < x->n) ? tree.child(x, i + 1) : NodeRef();
+                if (i < x->n && !right_sib)
                 {
-                    swap_right(x, next, right_sib, i);
+                    return;
                 }
-                // Then check left sibling if the left sibling has enough keys
-                else if (left_sib != nullptr && left_sib->n > t - 1)
+
+                // Check right sibling first if the right sibling has enough keys
+                if (right_sib && right_sib->n > t - 1)
                 {
-                    swap_left(x, next, left_sib, i - 1);
+                    BTREE_COUNT(REMOVE_CASE_3A, 1);
+                    right_sib = tree.own(x, i + 1);
+                    swap_right(tree, x, next, right_sib, i);
                 }
-                // Both siblings don't have enough keys
-                else if (right_sib != nullptr) // merge with right sibling if possible
+                else
                 {
-                    merge_left(next, right_sib, x->keys[i]);
-                    remove_internal_key(x, i, i + 1);
+                    // the left sibling is only read once the right one cannot give a key
+                    NodeRef left_sib = (i > 0) ? tree.child(x, i - 1) : NodeRef();
+                    if (i > 0 && !left_sib)
+                    {
+                        return;
+                    }
+
+                    // Then check left sibling if the left sibling has enough keys
+                    if (left_sib && left_sib->n > t - 1)
+                    {
+                        BTREE_COUNT(REMOVE_CASE_3A, 1);
+                        left_sib = tree.own(x, i - 1);
+                        swap_left(tree, x, next, left_sib, i - 1);
+                    }
+                    // Both siblings don't have enough keys
+                    else if (right_sib) // merge with right sibling if possible
+                    {
+                        BTREE_COUNT(REMOVE_CASE_3B, 1);
+                        right_sib = tree.own(x, i + 1);
+                        merge_left(tree, next, right_sib, x->keys[i]);
+                        remove_internal_key(tree, x, i, i + 1);
+                    }
+                    else // merge with left sibling if possible
+                    {
+                        BTREE_COUNT(REMOVE_CASE_3B, 1);
+                        left_sib = tree.own(x, i - 1);
+                        merge_left(tree, left_sib, next, x->keys[i - 1]);
+                        remove_internal_key(tree, x, i - 1, i);
+                        next = std::move(left_sib);
+                        i--;
+                    }
                 }
-                else // merge with left sibling if possible
+            }
+            if constexpr (Tree::COUNTED)
+            {
+                if (tree.order_stats)
                 {
-                    merge_left(left_sib, next, x->keys[i - 1]);
-                    remove_internal_key(x, i - 1, i);
-                    next = left_sib;
+                    path_counts[depth++] = &x->counts[i];
                 }
             }
-            x = next; // update for the next loop
+            x = std::move(next); // update for the next loop
         }
     }
 }
@@ -150,15 +287,10 @@ void BTree::remove(Node *x, int k, bool x_root)
 
 int BTree::find_k(Node *x, int k)
 {
-
-    int i = 0;
-    // Traverse the node until it finds k. Early termination for performance
-    while (i < x->n && k > x->keys[i])
-    {
-        i++;
-    }
-
-    return i;
+    BTREE_COUNT(NODES_VISITED, 1);
+    BTREE_COUNT(FIND_K_COMPARISONS, node_rank_comparisons(x->n));
+    // node_rank picks a SIMD scan for normal widths and a branchless binary search for very wide nodes
+    return node_rank(x->keys, x->n, k);
 }
 
 // remove the key at index i from a btree leaf node x
@@ -166,12 +298,14 @@ int BTree::find_k(Node *x, int k)
 // Postcondition: key at index i is removed from node x, x->n is decremented by 1,
 //                all keys after index i are shifted left by one position
 
-void BTree::remove_leaf_key(Node *x, int i)
+template <typename Tree>
+void ClrsDelete<Tree>::remove_leaf_key(Tree &tree, NodeRef &x, int i)
 {
     if (!x->leaf) // If x is not leaf, return.
     {
         return;
     }
+    tree.mark_dirty(x);
     for (int j = i; j < x->n - 1; j++)
     {
         x->keys[j] = x->keys[j + 1];
@@ -183,8 +317,10 @@ void BTree::remove_leaf_key(Node *x, int i)
 // Precondition: x is an internal node (x->leaf == false), 0 <= i < x->n, and 0 <= j <= x->n
 // Postcondition: key at index i and child pointer at index j are removed from node x, x->n is decremented by 1, all keys after index i and all child pointers after index j are shifted left by one position
 
-void BTree::remove_internal_key(Node *x, int i, int j)
+template <typename Tree>
+void ClrsDelete<Tree>::remove_internal_key(Tree &tree, NodeRef &x, int i, int j)
 {
+    tree.mark_dirty(x);
     for (int k = i; k < x->n - 1; k++)
     {
         x->keys[k] = x->keys[k + 1];
@@ -193,42 +329,91 @@ void BTree::remove_internal_key(Node *x, int i, int j)
     {
         x->c[k] = x->c[k + 1];
     }
-    x->c[x->n] = nullptr;
+    x->c[x->n] = {};
+    if constexpr (Tree::COUNTED)
+    {
+        if (tree.order_stats)
+        {
+            for (int k = j; k < x->n; k++)
+            {
+                x->counts[k] = x->counts[k + 1];
+            }
+            x->counts[x->n] = 0;
+        }
+    }
     x->n--;
+
+    // the child left at index i took the key (a merge) or is unchanged, either way its own counts are exact
+    if constexpr (Tree::COUNTED)
+    {
+        if (tree.order_stats)
+        {
+            x->counts[i] = tree.subtree_size(x->c[i]);
+        }
+    }
 }
 
-// return the max key in the btree rooted at node x
+// find the max key in the btree rooted at node x
 // Precondition: x is a valid BTree node and x->n > 0
-// Postcondition: returns the maximum key in the subtree rooted at x, the maximum key is found by following rightmost child pointers until reaching a leaf
+// Postcondition: returns true and sets key to the maximum key in the subtree rooted at x, the maximum key is found by following rightmost child pointers until reaching a leaf,
+//                returns false if a node on the way cannot be read
 
-int BTree::max_key(Node *x)
+template <typename Tree>
+bool ClrsDelete<Tree>::max_key(Tree &tree, const NodeRef &x, int &key)
 {
-    while (!x->leaf)
+    if (x->leaf)
     {
-        x = x->c[x->n];
+        key = x->keys[x->n - 1];
+        return true;
     }
-    return x->keys[x->n - 1];
+    NodeRef y = tree.child(x, x->n);
+    while (y && !y->leaf)
+    {
+        y = tree.child(y, y->n);
+    }
+    if (!y)
+    {
+        return false;
+    }
+    key = y->keys[y->n - 1];
+    return true;
 }
 
-// return the min key in the btree rooted at node x
+// find the min key in the btree rooted at node x
 // Precondition: x is a valid BTree node and x->n > 0
-// Postcondition: returns the minimum key in the subtree rooted at x, the minimum key is found by following leftmost child pointers until reaching a leaf
+// Postcondition: returns true and sets key to the minimum key in the subtree rooted at x, the minimum key is found by following leftmost child pointers until reaching a leaf,
+//                returns false if a node on the way cannot be read
 
-int BTree::min_key(Node *x)
+template <typename Tree>
+bool ClrsDelete<Tree>::min_key(Tree &tree, const NodeRef &x, int &key)
 {
-    while (!x->leaf)
+    if (x->leaf)
+    {
+        key = x->keys[0];
+        return true;
+    }
+    NodeRef y = tree.child(x, 0);
+    while (y && !y->leaf)
+    {
+        y = tree.child(y, 0);
+    }
+    if (!y)
     {
-        x = x->c[0];
+        return false;
     }
-    return x->keys[0];
+    key = y->keys[0];
+    return true;
 }
 
 // merge key k and all keys and children from y into y's LEFT sibling x
 // Precondition: x and y are adjacent siblings (x is left of y), both x and y have exactly t-1 keys, k is the separating key in the parent between x and y
-// Postcondition: x contains its original keys, separator key k, and all keys from y (total 2t-1 keys), x also contains all child pointers from y if not a leaf, y is deleted, memory is freed
+// Postcondition: x contains its original keys, separator key k, and all keys from y (total 2t-1 keys), x also contains all child pointers from y if not a leaf, y is given back to the tree
 
-void BTree::merge_left(Node *x, Node *y, int k)
+template <typename Tree>
+void ClrsDelete<Tree>::merge_left(Tree &tree, NodeRef &x, NodeRef &y, int k)
 {
+    BTREE_COUNT(MERGE_LEFT, 1);
+    tree.mark_dirty(x);
     // Add the separating key k to x
     x->keys[x->n] = k;
 
@@ -244,6 +429,13 @@ void BTree::merge_left(Node *x, Node *y, int k)
         for (int i = 0; i <= y->n; i++)
         {
             x->c[x->n + 1 + i] = y->c[i];
+            if constexpr (Tree::COUNTED)
+            {
+                if (tree.order_stats)
+                {
+                    x->counts[x->n + 1 + i] = y->counts[i];
+                }
+            }
         }
     }
 
@@ -251,15 +443,16 @@ void BTree::merge_left(Node *x, Node *y, int k)
     x->n += y->n + 1;
 
     // Delete the now-empty node y
-    delete y;
+    tree.free_node(y);
 }
 
 // merge key k and all keys and children from y into y's RIGHT sibling x
 // Precondition: x and y are adjacent siblings (x is right of y), both x and y have exactly t-1 keys, k is the separating key in the parent between y and x
-// Postcondition: x contains all keys from y, separator key k, and its original keys (total 2t-1 keys), x also contains all child pointers from y if not a leaf, y is deleted, memory is freed
+// Postcondition: x contains all keys from y, separator key k, and its original keys (total 2t-1 keys), x also contains all child pointers from y if not a leaf, y is returned to the node pool
 
 void BTree::merge_right(Node *x, Node *y, int k)
 {
+    BTREE_COUNT(MERGE_RIGHT, 1);
     // Shift x's existing keys right to make room for y's keys and k
     for (int i = x->n - 1; i >= 0; i--)
     {
@@ -272,6 +465,10 @@ void BTree::merge_right(Node *x, Node *y, int k)
         for (int i = x->n; i >= 0; i--)
         {
             x->c[i + y->n + 1] = x->c[i];
+            if (order_stats)
+            {
+                x->counts[i + y->n + 1] = x->counts[i];
+            }
         }
     }
 
@@ -290,6 +487,10 @@ void BTree::merge_right(Node *x, Node *y, int k)
         for (int i = 0; i <= y->n; i++)
         {
             x->c[i] = y->c[i];
+            if (order_stats)
+            {
+                x->counts[i] = y->counts[i];
+            }
         }
     }
 
@@ -297,7 +498,7 @@ void BTree::merge_right(Node *x, Node *y, int k)
     x->n += y->n + 1;
 
     // Delete the now-empty node y
-    delete y;
+    pool.free(y);
 }
 
 // Give y an extra key by moving a key from its parent x down into y
@@ -307,8 +508,13 @@ void BTree::merge_right(Node *x, Node *y, int k)
 // Precondition: x is the parent of y and z, z is the left sibling of y, y has exactly t-1 keys, z has at least t keys, i is the index in x where x->keys[i] separates z and y
 // Postcondition: y->n increases by 1, z->n decreases by 1, z's rightmost key moves to x->keys[i], x->keys[i] moves to y->keys[0], z's rightmost child moves to y->c[0] if internal node
 
-void BTree::swap_left(Node *x, Node *y, Node *z, int i)
+template <typename Tree>
+void ClrsDelete<Tree>::swap_left(Tree &tree, NodeRef &x, NodeRef &y, NodeRef &z, int i)
 {
+    BTREE_COUNT(SWAP_LEFT, 1);
+    tree.mark_dirty(x);
+    tree.mark_dirty(y);
+    tree.mark_dirty(z);
     // Shift y's keys right to make room at the beginning
     for (int j = y->n - 1; j >= 0; j--)
     {
@@ -321,6 +527,13 @@ void BTree::swap_left(Node *x, Node *y, Node *z, int i)
         for (int j = y->n; j >= 0; j--)
         {
             y->c[j + 1] = y->c[j];
+            if constexpr (Tree::COUNTED)
+            {
+                if (tree.order_stats)
+                {
+                    y->counts[j + 1] = y->counts[j];
+                }
+            }
         }
     }
 
@@ -331,6 +544,24 @@ void BTree::swap_left(Node *x, Node *y, Node *z, int i)
     if (!y->leaf)
     {
         y->c[0] = z->c[z->n];
+        z->c[z->n] = {};
+    }
+
+    // One key and the subtree under the moved child go from z (x->c[i]) to y (x->c[i+1])
+    if constexpr (Tree::COUNTED)
+    {
+        if (tree.order_stats)
+        {
+            uint32_t moved = 1;
+            if (!y->leaf)
+            {
+                y->counts[0] = z->counts[z->n];
+                z->counts[z->n] = 0;
+                moved += y->counts[0];
+            }
+            x->counts[i] -= moved;
+            x->counts[i + 1] += moved;
+        }
     }
 
     // Move z's rightmost key up to parent
@@ -348,8 +579,13 @@ void BTree::swap_left(Node *x, Node *y, Node *z, int i)
 // Precondition: x is the parent of y and z, z is the right sibling of y, y has exactly t-1 keys, z has at least t keys, i is the index in x where x->keys[i] separates y and z
 // Postcondition: y->n increases by 1, z->n decreases by 1, z's leftmost key moves to x->keys[i], x->keys[i] moves to y->keys[y->n], z's leftmost child moves to y->c[y->n+1] if internal node
 
-void BTree::swap_right(Node *x, Node *y, Node *z, int i)
+template <typename Tree>
+void ClrsDelete<Tree>::swap_right(Tree &tree, NodeRef &x, NodeRef &y, NodeRef &z, int i)
 {
+    BTREE_COUNT(SWAP_RIGHT, 1);
+    tree.mark_dirty(x);
+    tree.mark_dirty(y);
+    tree.mark_dirty(z);
     // Move parent's separating key down to end of y
     y->keys[y->n] = x->keys[i];
 
@@ -359,6 +595,22 @@ void BTree::swap_right(Node *x, Node *y, Node *z, int i)
         y->c[y->n + 1] = z->c[0];
     }
 
+    // One key and the subtree under the moved child go from z (x->c[i+1]) to y (x->c[i])
+    if constexpr (Tree::COUNTED)
+    {
+        if (tree.order_stats)
+        {
+            uint32_t moved = 1;
+            if (!y->leaf)
+            {
+                y->counts[y->n + 1] = z->counts[0];
+                moved += z->counts[0];
+            }
+            x->counts[i] += moved;
+            x->counts[i + 1] -= moved;
+        }
+    }
+
     // Move z's leftmost key up to parent
     x->keys[i] = z->keys[0];
 
@@ -374,10 +626,75 @@ void BTree::swap_right(Node *x, Node *y, Node *z, int i)
         for (int j = 0; j < z->n; j++)
         {
             z->c[j] = z->c[j + 1];
+            if constexpr (Tree::COUNTED)
+            {
+                if (tree.order_stats)
+                {
+                    z->counts[j] = z->counts[j + 1];
+                }
+            }
         }
+        z->c[z->n] = {};
     }
 
     // Update key counts
     y->n++;
     z->n--;
-}
\ No newline at end of file
+}
+
+// The BTree members below run the cases above on Node *, PagedBTree runs the same cases on pinned pages
+
+// delete the key k from the btree rooted at x, see ClrsDelete::remove
+void BTree::remove(Node *x, int k, bool x_root)
+{
+    ClrsDelete<BTree>::remove(*this, x, k);
+}
+
+// remove the key at index i from the leaf x, see ClrsDelete::remove_leaf_key
+void BTree::remove_leaf_key(Node *x, int i)
+{
+    ClrsDelete<BTree>::remove_leaf_key(*this, x, i);
+}
+
+// remove the key at index i and the child at index j from the internal node x, see ClrsDelete::remove_internal_key
+void BTree::remove_internal_key(Node *x, int i, int j)
+{
+    ClrsDelete<BTree>::remove_internal_key(*this, x, i, j);
+}
+
+// return the max key in the btree rooted at node x
+int BTree::max_key(Node *x)
+{
+    int key = 0;
+    ClrsDelete<BTree>::max_key(*this, x, key);
+    return key;
+}
+
+// return the min key in the btree rooted at node x
+int BTree::min_key(Node *x)
+{
+    int key = 0;
+    ClrsDelete<BTree>::min_key(*this, x, key);
+    return key;
+}
+
+// merge key k and y into its left sibling x, see ClrsDelete::merge_left
+void BTree::merge_left(Node *x, Node *y, int k)
+{
+    ClrsDelete<BTree>::merge_left(*this, x, y, k);
+}
+
+// move a key from the left sibling z of y through their parent x into y, see ClrsDelete::swap_left
+void BTree::swap_left(Node *x, Node *y, Node *z, int i)
+{
+    ClrsDelete<BTree>::swap_left(*this, x, y, z, i);
+}
+
+// move a key from the right sibling z of y through their parent x into y, see ClrsDelete::swap_right
+void BTree::swap_right(Node *x, Node *y, Node *z, int i)
+{
+    ClrsDelete<BTree>::swap_right(*this, x, y, z, i);
+}
+
+template struct ClrsDelete<BTree>;
+template struct ClrsDelete<PagedBTree>;
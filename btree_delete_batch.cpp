@@ -0,0 +1,240 @@
+#include "btree.h"
+#include <algorithm>
+
+/*
+NOTE: Batched delete. Instead of the single-key top-down fix-ups of remove(), remove_many walks the tree once,
+hands every child the slice of the sorted keys that falls between its separators, and repairs nodes on the way
+back up. A child that lost keys is repaired once, with swap_left/swap_right/merge_left, after all of its keys
+are gone, no matter how many keys it lost.
+
+While a subtree is being processed its nodes may drop below t-1 keys. The repair pass of the parent fixes every
+child that has a sibling. A node whose parent has no keys left (n == 0, a single child) cannot be fixed there,
+it is fixed when that parent is merged into a sibling one level up, or removed when the root collapses.
+*/
+
+// remove every key in sorted_keys from the btree
+// Precondition: sorted_keys is sorted ascending (duplicates are fine)
+// Postcondition: returns the number of keys that were in the tree and are now removed, the tree is a valid BTree
+
+size_t BTree::remove_many(std::span<const int> sorted_keys)
+{
+    materialize();
+    flush_messages(); // older buffered updates go first
+    if (!std::is_sorted(sorted_keys.begin(), sorted_keys.end()))
+    {
+        std::cerr << "Error: remove_many needs its keys sorted in ascending order\n";
+        return 0;
+    }
+    if (!root || sorted_keys.empty())
+    {
+        return 0;
+    }
+
+    // tombstoned keys are already gone for the caller but still sit in their nodes
+    size_t already_removed = 0;
+    if (!tombstones.empty())
+    {
+        for (size_t j = 0; j < sorted_keys.size(); j++)
+        {
+            if ((j == 0 || sorted_keys[j] != sorted_keys[j - 1]) && tombstones.erase(sorted_keys[j]))
+            {
+                already_removed++;
+            }
+        }
+    }
+
+    own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+    size_t removed = remove_many(root, sorted_keys.data(), sorted_keys.data() + sorted_keys.size());
+    collapse_root();
+    return removed - already_removed;
+}
+
+// remove every key in [first, last) from the subtree rooted at x
+// Precondition: [first, last) is sorted ascending and lies between the separators around x
+// Postcondition: returns the number of keys removed, every child of x holds at least t-1 keys unless x has no keys left,
+//                x itself may hold fewer than t-1 keys (the caller repairs it)
+
+size_t BTree::remove_many(Node *x, const int *first, const int *last)
+{
+    if (first == last)
+    {
+        return 0;
+    }
+
+    // Leaf: one merge pass over the node keys and the batch keeps every key that is not in the batch
+    if (x->leaf)
+    {
+        size_t removed = 0;
+        int kept = 0;
+        const int *p = first;
+        for (int r = 0; r < x->n; r++)
+        {
+            while (p != last && *p < x->keys[r])
+            {
+                p++;
+            }
+            if (p != last && *p == x->keys[r])
+            {
+                removed++;
+                continue;
+            }
+            x->keys[kept++] = x->keys[r];
+        }
+        x->n = kept;
+        return removed;
+    }
+
+    // Internal node: jump straight to the child of the next batch key, child i receives the keys below x->keys[i],
+    // a key equal to x->keys[i] removes the separator. Children lo..hi are the only ones that can be short of keys.
+    size_t removed = 0;
+    const int *p = first;
+    int lo = find_k(x, *p);
+    int hi = lo;
+    while (p != last)
+    {
+        int i = find_k(x, *p);
+        const int *q = (i < x->n) ? std::lower_bound(p, last, x->keys[i]) : last;
+        if (p != q)
+        {
+            size_t from_child = remove_many(own(x, i), p, q);
+            if (order_stats)
+            {
+                x->counts[i] -= from_child;
+            }
+            removed += from_child;
+            p = q;
+        }
+        hi = i;
+
+        if (p != last && *p == x->keys[i])
+        {
+            while (p != last && *p == x->keys[i])
+            {
+                p++;
+            }
+            removed++;
+
+            Node *y = own(x, i);
+            Node *rightmost = y;
+            while (!rightmost->leaf)
+            {
+                rightmost = rightmost->c[rightmost->n];
+            }
+            if (rightmost->n == 0)
+            {
+                // every key left of the separator is gone too: drop the separator with its empty subtree
+                unref(y);
+                remove_internal_key(x, i, i);
+                continue;
+            }
+
+            // replace the separator with its predecessor like Case 2a
+            int pred = rightmost->keys[rightmost->n - 1];
+            x->keys[i] = pred;
+            remove_many(y, &pred, &pred + 1);
+            if (order_stats)
+            {
+                x->counts[i]--;
+            }
+        }
+    }
+
+    // Repair pass: every child that lost too many keys borrows or merges exactly once here
+    for (int i = lo; i <= hi && i <= x->n; i++)
+    {
+        if (x->c[i]->n < t - 1)
+        {
+            int n_before = x->n;
+            i = fix_child(x, i);
+            hi -= n_before - x->n; // every merge shifts the children after it one slot left
+        }
+    }
+    return removed;
+}
+
+// bring x->c[i] back to at least t-1 keys by borrowing from or merging with its siblings, right sibling first
+// Precondition: x is an internal node
+// Postcondition: returns the index of the child that now holds c[i]'s keys, that child and its children hold at least t-1 keys,
+//                unless x runs out of keys (x->n == 0) and the child has no sibling left to take keys from
+//                (the loop ends because every round merges nodes away or leaves c[i] with enough keys)
+
+int BTree::fix_child(Node *x, int i)
+{
+    while (x->c[i]->n < t - 1 && x->n > 0)
+    {
+        Node *y = own(x, i);
+        if (i < x->n)
+        {
+            Node *z = own(x, i + 1);
+            if (y->n + z->n + 1 <= 2 * t - 1)
+            {
+                merge_left(y, z, x->keys[i]);
+                remove_internal_key(x, i, i + 1);
+            }
+            else
+            {
+                // z has more than enough keys for both, move just enough over
+                while (y->n < t - 1)
+                {
+                    swap_right(x, y, z, i);
+                }
+            }
+        }
+        else
+        {
+            Node *z = own(x, i - 1);
+            if (y->n + z->n + 1 <= 2 * t - 1)
+            {
+                merge_left(z, y, x->keys[i - 1]);
+                remove_internal_key(x, i - 1, i);
+                i--;
+            }
+            else
+            {
+                while (y->n < t - 1)
+                {
+                    swap_left(x, y, z, i - 1);
+                }
+            }
+        }
+
+        // a child that had no keys left brought its lone, still underfull child along, repairing that child
+        // now that it has siblings can merge keys out of x->c[i] again, so check it once more
+        fix_children(x->c[i]);
+    }
+    return i;
+}
+
+// repair every child of x that holds fewer than t-1 keys
+// Precondition: None
+// Postcondition: every child of x holds at least t-1 keys unless x has no keys
+
+void BTree::fix_children(Node *x)
+{
+    if (x->leaf)
+    {
+        return;
+    }
+    for (int i = 0; i <= x->n; i++)
+    {
+        if (x->c[i]->n < t - 1)
+        {
+            i = fix_child(x, i);
+        }
+    }
+}
+
+// drop empty roots after a batch operation
+// Precondition: None
+// Postcondition: root is nullptr or holds at least one key, the tree height shrank by one for every root that had no keys
+
+void BTree::collapse_root()
+{
+    while (root && root->n == 0)
+    {
+        BTREE_COUNT(ROOT_COLLAPSES, 1);
+        Node *old_root = root;
+        root = root->leaf ? nullptr : root->c[0];
+        pool.free(old_root);
+    }
+}
@@ -0,0 +1,193 @@
+#include "btree.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+NOTE: Range delete. remove_range(lo, hi) removes [lo, hi), the keys count_range(lo, hi) counts and a cursor from
+lo to hi visits. The recursion works on the closed range up to the last key hi-1, called hi there: its keys sit
+between two root-to-leaf boundary paths, the path to the first key >= lo and the path to the first key > hi. In a node on those paths the keys in range and every child
+strictly between them are dropped whole (their nodes are only counted and unreferenced, never searched),
+and the walk goes on into the two boundary children, or into one child while both paths still agree.
+Once the boundary children are cut, they become neighbours and need a separator: the largest key left
+on the left side moves up. A side that lost every key is dropped instead. If both sides are empty, the
+node also gives up one key outside the range, which is inserted again once the range is gone. The
+repairs use the same fix_child() as remove_many and only run on nodes along the two paths, so the cost
+is O(t * height) plus the nodes dropped. With order statistics the keys of a dropped subtree are not counted by a
+walk, the parent already holds the count, and each node on the paths recounts its children before the repairs.
+*/
+
+// Helper: x holds no key and no child, it is what is left of a subtree whose keys were all in range
+static bool emptied(const Node *x)
+{
+    return x->n == 0 && x->leaf;
+}
+
+// Helper: remove keys [k, k + count) and children [c, c + count) of x, shifting the rest left
+static void erase_span(Node *x, int k, int c, int count)
+{
+    std::memmove(x->keys + k, x->keys + k + count, sizeof(int) * (x->n - k - count));
+    if (!x->leaf)
+    {
+        std::memmove(x->c + c, x->c + c + count, sizeof(Node *) * (x->n + 1 - c - count));
+    }
+    x->n -= count;
+}
+
+// return the number of keys in the subtree rooted at x
+// Precondition: x is not nullptr
+// Postcondition: the subtree is unchanged
+
+size_t BTree::count_keys(Node *x)
+{
+    size_t keys = x->n;
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            keys += count_keys(x->c[i]);
+        }
+    }
+    return keys;
+}
+
+// remove every key k with lo <= k < hi from the btree
+// Precondition: None (handles empty tree case and lo >= hi)
+// Postcondition: returns the number of keys removed, count_range(lo, hi) before the call, the tree is a valid BTree
+//                holding every other key
+
+size_t BTree::remove_range(int lo, int hi)
+{
+    materialize();
+    flush_messages(); // older buffered updates go first
+    if (!root || lo >= hi)
+    {
+        return 0;
+    }
+
+    // tombstoned keys in range are already gone for the caller
+    size_t already_removed = 0;
+    if (!tombstones.empty())
+    {
+        already_removed = std::erase_if(tombstones, [lo, hi](int k) { return lo <= k && k < hi; });
+    }
+
+    own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+    std::vector<int> displaced;
+    size_t removed = remove_range(root, lo, hi - 1, displaced);
+    collapse_root();
+    for (int k : displaced)
+    {
+        if (!tombstones.erase(k)) // a tombstone that had to move is simply gone
+        {
+            insert(k);
+        }
+    }
+    return removed - already_removed;
+}
+
+// remove every key in [lo, hi] from the subtree rooted at x
+// Precondition: x is owned by the tree, it holds at least one key or has a single child
+// Postcondition: returns the number of keys removed, keys outside the range that had to leave their node are appended
+//                to displaced, every child of x holds at least t-1 keys unless x has no keys left,
+//                x is a leaf with no keys (emptied(x)) if nothing of the subtree is left
+
+size_t BTree::remove_range(Node *x, int lo, int hi, std::vector<int> &displaced)
+{
+    int i = find_k(x, lo); // first key >= lo
+    int j = find_k(x, hi); // first key > hi
+    if (j < x->n && x->keys[j] == hi)
+    {
+        j++;
+    }
+
+    if (x->leaf)
+    {
+        erase_span(x, i, i, j - i);
+        return j - i;
+    }
+
+    if (i == j)
+    {
+        // both boundary paths go through child i
+        Node *y = own(x, i);
+        size_t removed = remove_range(y, lo, hi, displaced);
+        if (emptied(y) && x->n == 0)
+        {
+            // x only had y left
+            pool.free(y);
+            x->leaf = true;
+            return removed;
+        }
+        if (emptied(y))
+        {
+            // drop the empty child with one of its separators, the separator is inserted again later
+            pool.free(y);
+            int k = i < x->n ? i : i - 1;
+            displaced.push_back(x->keys[k]);
+            remove_internal_key(x, k, i);
+        }
+        recount(x);
+        fix_children(x);
+        return removed;
+    }
+
+    // keys i .. j-1 are in range, children i+1 .. j-1 lie completely inside it
+    size_t removed = j - i;
+    for (int c = i + 1; c < j; c++)
+    {
+        removed += order_stats ? x->counts[c] : count_keys(x->c[c]);
+        unref(x->c[c]);
+    }
+    Node *left = own(x, i);
+    Node *right = own(x, j);
+    removed += remove_range(left, lo, hi, displaced);
+    removed += remove_range(right, lo, hi, displaced);
+
+    bool left_empty = emptied(left);
+    bool right_empty = emptied(right);
+    if (!left_empty && !right_empty)
+    {
+        // the largest key left of the range separates the two sides
+        int sep = max_key(left);
+        remove_range(left, sep, sep, displaced);
+        if (emptied(left))
+        {
+            left_empty = true;
+            displaced.push_back(sep);
+        }
+        else
+        {
+            x->keys[i] = sep;
+            erase_span(x, i + 1, i + 1, j - i - 1);
+        }
+    }
+    if (left_empty && right_empty)
+    {
+        pool.free(left);
+        pool.free(right);
+        if (i == 0 && j == x->n)
+        {
+            // nothing of the subtree is left
+            x->n = 0;
+            x->leaf = true;
+            return removed;
+        }
+        // one child less than keys removed: a neighbouring separator leaves too and is inserted again later
+        int k = i > 0 ? i - 1 : i;
+        displaced.push_back(x->keys[i > 0 ? i - 1 : j]);
+        erase_span(x, k, i, j - i + 1);
+    }
+    else if (left_empty)
+    {
+        pool.free(left);
+        erase_span(x, i, i, j - i);
+    }
+    else if (right_empty)
+    {
+        pool.free(right);
+        erase_span(x, i, i + 1, j - i);
+    }
+    recount(x);
+    fix_children(x);
+    return removed;
+}
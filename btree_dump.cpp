@@ -0,0 +1,198 @@
+#include "btree.h"
+#include <cerrno>
+#include <charconv>
+#include <unistd.h>
+
+/*
+NOTE: Level-order dump. Keys are formatted with std::to_chars into one buffer that is handed to the
+ostream or file descriptor only when it is full, so a dump costs one write per DUMP_BUFFER bytes instead
+of one stream operation per key. Levels are walked with two node vectors that are swapped and reused,
+the widest level decides how much they grow.
+    DumpFormat::Debug:  keys ',' nodes '\t' levels '\n' (what print() has always written)
+    DumpFormat::Loader: the degree on the first line, then keys ',' nodes '-' levels '\n',
+                        without a '\n' after the last level like the files in tests/; build_tree reads it back
+*/
+
+static const size_t DUMP_BUFFER = size_t(1) << 20;
+
+namespace
+{
+    // Buffered output to either an ostream or a file descriptor
+    struct DumpWriter
+    {
+        std::ostream *out;
+        int fd;
+        std::vector<char> buf;
+        size_t used = 0;
+        bool ok = true;
+
+        DumpWriter(std::ostream *out, int fd) : out(out), fd(fd), buf(DUMP_BUFFER) {}
+
+        void flush()
+        {
+            if (!ok || used == 0)
+            {
+                used = 0;
+                return;
+            }
+            if (out)
+            {
+                ok = bool(out->write(buf.data(), used));
+            }
+            else
+            {
+                size_t done = 0;
+                while (done < used)
+                {
+                    ssize_t got = ::write(fd, buf.data() + done, used - done);
+                    if (got < 0 && errno == EINTR)
+                        continue;
+                    if (got <= 0)
+                    {
+                        ok = false;
+                        break;
+                    }
+                    done += got;
+                }
+            }
+            used = 0;
+        }
+
+        // make room for at least `bytes` more characters
+        char *reserve(size_t bytes)
+        {
+            if (buf.size() - used < bytes)
+            {
+                flush();
+            }
+            return buf.data() + used;
+        }
+
+        void put(char ch)
+        {
+            *reserve(1) = ch;
+            used++;
+        }
+
+        void put(int k)
+        {
+            char *p = reserve(16);
+            used = std::to_chars(p, p + 16, k).ptr - buf.data();
+        }
+    };
+}
+
+// write the tree rooted at root level by level
+// Precondition: root is nullptr or the root of a valid tree of minimum degree t
+// Postcondition: returns true if every byte was written, false after the first failed write or,
+//                in the loader format, at a negative key (the loader reads '-' as the node separator)
+
+static bool dump_levels(const Node *root, int t, DumpFormat format, DumpWriter &w)
+{
+    bool loader = format == DumpFormat::Loader;
+    char node_sep = loader ? '-' : '\t';
+    if (loader)
+    {
+        w.put(t);
+        w.put('\n');
+    }
+
+    std::vector<const Node *> level;
+    std::vector<const Node *> next;
+    if (root)
+    {
+        level.push_back(root);
+    }
+    while (!level.empty() && w.ok)
+    {
+        next.clear();
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            const Node *node = level[i];
+            for (int j = 0; j < node->n; j++)
+            {
+                if (loader && node->keys[j] < 0)
+                {
+                    w.flush();
+                    std::cerr << "Error: key " << node->keys[j] << " cannot be written in the level-order text format\n";
+                    return false;
+                }
+                if (j > 0)
+                    w.put(',');
+                w.put(node->keys[j]);
+            }
+            if (i + 1 < level.size())
+                w.put(node_sep);
+
+            if (!node->leaf)
+            {
+                for (int j = 0; j <= node->n; j++)
+                {
+                    if (node->c[j])
+                        next.push_back(node->c[j]);
+                }
+            }
+        }
+        if (!loader || !next.empty())
+            w.put('\n');
+        level.swap(next);
+    }
+    w.flush();
+    return w.ok;
+}
+
+// write the tree to out in the given format
+// Precondition: None
+// Postcondition: returns true if the whole dump was written, an empty tree writes nothing (Debug) or only the degree (Loader)
+
+bool BTree::dump(std::ostream &out, DumpFormat format)
+{
+    materialize();
+    compact(tombstones.size()); // a dump writes whole nodes, tombstoned keys would come back
+    flush_messages();           // and buffered updates would be lost
+    DumpWriter w(&out, -1);
+    return dump_levels(root, t, format, w);
+}
+
+// write the tree to the open file descriptor fd in the given format
+// Precondition: fd is open for writing
+// Postcondition: same as dump(std::ostream &, DumpFormat), fd is left open
+
+bool BTree::dump(int fd, DumpFormat format)
+{
+    materialize();
+    compact(tombstones.size()); // a dump writes whole nodes, tombstoned keys would come back
+    flush_messages();           // and buffered updates would be lost
+    DumpWriter w(nullptr, fd);
+    return dump_levels(root, t, format, w);
+}
+
+// For debugging
+void BTree::print()
+{
+    dump(std::cout, DumpFormat::Debug);
+}
+
+// write the snapshot to out in the given format, see BTree::dump
+// Precondition: None
+// Postcondition: returns true if the whole dump was written. With tombstones or buffered messages the shared
+//                nodes do not hold the snapshot's keys, so the smallest tree of those keys (assign_sorted) is written.
+
+bool BTree::Snapshot::dump(std::ostream &out, DumpFormat format) const
+{
+    DumpWriter w(&out, -1);
+    if (!pending)
+    {
+        return dump_levels(root, t, format, w);
+    }
+    std::vector<int> keys(begin(), end());
+    BTree full(t);
+    full.assign_sorted(keys);
+    return dump_levels(full.root, t, format, w);
+}
+
+// For debugging, same format as BTree::print
+void BTree::Snapshot::print(std::ostream &out) const
+{
+    dump(out, DumpFormat::Debug);
+}
@@ -0,0 +1,170 @@
+#include "btree_fixed.h"
+#include <cstring>
+
+template class FixedBTree<int, 2>;
+template class FixedBTree<int, 3>;
+template class FixedBTree<int, 4>;
+template class FixedBTree<int, 8>;
+template class FixedBTree<int, 16>;
+template class FixedBTree<int, 32>;
+template class FixedBTree<int, 64>;
+
+// Key for the string s: the first PREFIX_BYTES bytes big-endian in prefix (zero padded), the whole string in full
+// if it is longer, copied if copy is true and borrowed from s otherwise
+PrefixKey::PrefixKey(std::string_view s, bool copy) : len((uint32_t)s.size())
+{
+    size_t head = std::min(s.size(), PREFIX_BYTES);
+    for (size_t i = 0; i < PREFIX_BYTES; i++)
+    {
+        prefix = (prefix << 8) | (i < head ? (unsigned char)s[i] : 0);
+    }
+    if (s.size() > PREFIX_BYTES)
+    {
+        owned = copy;
+        if (copy)
+        {
+            char *bytes = new char[s.size()];
+            std::memcpy(bytes, s.data(), s.size());
+            full = bytes;
+        }
+        else
+        {
+            full = s.data();
+        }
+    }
+}
+
+PrefixKey::PrefixKey(PrefixKey &&other) noexcept
+    : prefix(other.prefix), len(other.len), owned(other.owned), full(other.full)
+{
+    other.prefix = 0;
+    other.len = 0;
+    other.owned = false;
+    other.full = nullptr;
+}
+
+PrefixKey &PrefixKey::operator=(PrefixKey &&other) noexcept
+{
+    std::swap(prefix, other.prefix);
+    std::swap(len, other.len);
+    std::swap(owned, other.owned);
+    std::swap(full, other.full);
+    return *this;
+}
+
+PrefixKey::~PrefixKey()
+{
+    if (owned)
+    {
+        delete[] full;
+    }
+}
+
+// return the key as a string
+std::string PrefixKey::str() const
+{
+    if (full)
+    {
+        return std::string(full, len);
+    }
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; i++)
+    {
+        s[i] = (char)(prefix >> (8 * (PREFIX_BYTES - 1 - i)));
+    }
+    return s;
+}
+
+// order two keys with equal prefixes by the bytes after the prefix, then by length
+// (a zero padded prefix ties with one that really ends in zero bytes, the length tells them apart)
+bool PrefixKey::tail_less(const PrefixKey &a, const PrefixKey &b)
+{
+    std::string_view ta = a.full ? std::string_view(a.full + PREFIX_BYTES, a.len - PREFIX_BYTES) : std::string_view();
+    std::string_view tb = b.full ? std::string_view(b.full + PREFIX_BYTES, b.len - PREFIX_BYTES) : std::string_view();
+    int order = ta.compare(tb);
+    return order != 0 ? order < 0 : a.len < b.len;
+}
+
+// Load the tree from file, then move it into a FixedBTree if its degree was preinstantiated
+AnyBTree::AnyBTree(const std::string &filename)
+{
+    specialize(std::unique_ptr<BTree>(new BTree(filename)));
+}
+
+// Empty tree of minimum degree t
+AnyBTree::AnyBTree(int t)
+{
+    specialize(std::unique_ptr<BTree>(new BTree(t)));
+}
+
+// pick the representation for a loaded tree
+// Precondition: loaded is not null
+// Postcondition: tree holds a FixedBTree with the same keys and shape if loaded->degree() is preinstantiated, otherwise loaded itself
+
+void AnyBTree::specialize(std::unique_ptr<BTree> loaded)
+{
+    switch (loaded->degree())
+    {
+    case 2:
+        tree = FixedBTree<int, 2>::from(*loaded);
+        break;
+    case 3:
+        tree = FixedBTree<int, 3>::from(*loaded);
+        break;
+    case 4:
+        tree = FixedBTree<int, 4>::from(*loaded);
+        break;
+    case 8:
+        tree = FixedBTree<int, 8>::from(*loaded);
+        break;
+    case 16:
+        tree = FixedBTree<int, 16>::from(*loaded);
+        break;
+    case 32:
+        tree = FixedBTree<int, 32>::from(*loaded);
+        break;
+    case 64:
+        tree = FixedBTree<int, 64>::from(*loaded);
+        break;
+    default:
+        tree = std::move(loaded);
+        break;
+    }
+}
+
+// Helper: the tree behind a variant alternative, so every operation is a single visit
+static BTree &unwrap(std::unique_ptr<BTree> &t)
+{
+    return *t;
+}
+
+static BTree &unwrap(const std::unique_ptr<BTree> &t)
+{
+    return *t;
+}
+
+template <typename Fixed>
+static Fixed &unwrap(Fixed &t)
+{
+    return t;
+}
+
+void AnyBTree::insert(int k)
+{
+    std::visit([k](auto &t) { unwrap(t).insert(k); }, tree);
+}
+
+void AnyBTree::remove(int k)
+{
+    std::visit([k](auto &t) { unwrap(t).remove(k); }, tree);
+}
+
+bool AnyBTree::contains(int k) const
+{
+    return std::visit([k](auto &t) { return unwrap(t).contains(k); }, tree);
+}
+
+void AnyBTree::print() const
+{
+    std::visit([](auto &t) { unwrap(t).print(); }, tree);
+}
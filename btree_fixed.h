@@ -0,0 +1,711 @@
+#ifndef BTREE_FIXED_H
+#define BTREE_FIXED_H
+
+#include "btree.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <queue>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+/*
+NOTE: Same CLRSv4 insert/delete as BTree, but the minimum degree T is a template parameter.
+Every node is a fixed-size struct with inline key and child arrays and no copy of t,
+so the key shifting loops in swap_*, merge_* and remove_internal_key have constant bounds
+the compiler can unroll and vectorize. Keys are only ever moved, never copied, between nodes.
+With a Value type every key carries a value in the same node, so a lookup returns the record without a second
+search. A value of at most FIXED_INLINE_VALUE_BYTES that moves without throwing sits in the node next to its key,
+a bigger one lives behind a unique_ptr and only the pointer moves. Key and value always move together as one
+entry: Case 2a/2b swap the entry with its predecessor/successor instead of copying the predecessor up, so
+move-only keys and values (unique_ptr, PrefixKey) work.
+*/
+
+static const size_t FIXED_INLINE_VALUE_BYTES = 16;
+
+// How FixedBTree stores a value of type V next to its key
+template <typename V>
+struct ValueSlot
+{
+    static constexpr bool INLINE = sizeof(V) <= FIXED_INLINE_VALUE_BYTES && std::is_nothrow_move_constructible_v<V>;
+    typedef std::conditional_t<INLINE, V, std::unique_ptr<V>> type;
+
+    static type wrap(V &&v)
+    {
+        if constexpr (INLINE)
+            return std::move(v);
+        else
+            return std::make_unique<V>(std::move(v));
+    }
+    static V &get(type &slot)
+    {
+        if constexpr (INLINE)
+            return slot;
+        else
+            return *slot;
+    }
+};
+
+// A tree without values stores nothing
+template <>
+struct ValueSlot<void>
+{
+    struct type
+    {
+    };
+};
+
+// String key for FixedBTree. The first PREFIX_BYTES bytes sit in the key itself as one big-endian integer, so most
+// comparisons are a single integer compare. A longer key also keeps the whole string out of line, which is only
+// read when two prefixes tie. A key made with view() borrows the caller's bytes, for lookups without allocating.
+// Move-only, like every key inside a FixedBTree node.
+class PrefixKey
+{
+public:
+    static constexpr size_t PREFIX_BYTES = 8;
+
+private:
+    uint64_t prefix = 0;
+    uint32_t len = 0;
+    bool owned = false;
+    const char *full = nullptr; // the whole key, only when len > PREFIX_BYTES
+
+    PrefixKey(std::string_view s, bool copy);
+    static bool tail_less(const PrefixKey &a, const PrefixKey &b);
+
+public:
+    PrefixKey() = default;
+    explicit PrefixKey(std::string_view s) : PrefixKey(s, true) {}
+    static PrefixKey view(std::string_view s) { return PrefixKey(s, false); } // s must outlive the key
+    PrefixKey(PrefixKey &&other) noexcept;
+    PrefixKey &operator=(PrefixKey &&other) noexcept;
+    PrefixKey(const PrefixKey &) = delete;
+    PrefixKey &operator=(const PrefixKey &) = delete;
+    ~PrefixKey();
+
+    size_t size() const { return len; }
+    std::string str() const;
+
+    friend bool operator<(const PrefixKey &a, const PrefixKey &b)
+    {
+        if (a.prefix != b.prefix)
+        {
+            return a.prefix < b.prefix;
+        }
+        return tail_less(a, b);
+    }
+    friend std::ostream &operator<<(std::ostream &out, const PrefixKey &k) { return out << k.str(); }
+};
+
+template <typename Key, int T, typename Value = void>
+class FixedBTree
+{
+    static_assert(T >= 2, "minimum degree must be at least 2");
+
+public:
+    static constexpr int MAX_KEYS = 2 * T - 1;
+    static constexpr int MIN_KEYS = T - 1;
+    static constexpr bool HAS_VALUES = !std::is_void_v<Value>;
+
+private:
+    typedef typename ValueSlot<Value>::type Slot;
+    struct NoValues
+    {
+    };
+
+    struct alignas(64) Node
+    {
+        int n = 0;
+        bool leaf = true;
+        Key keys[MAX_KEYS] = {};
+        [[no_unique_address]] std::conditional_t<HAS_VALUES, std::array<Slot, MAX_KEYS>, NoValues> vals;
+        Node *c[MAX_KEYS + 1] = {};
+    };
+
+    Node *root = nullptr;
+
+    static int find_k(const Node *x, const Key &k);
+    static bool equal(const Key &a, const Key &b) { return !(a < b) && !(b < a); }
+    static void destroy(Node *x);
+    static Node *copy_from(const ::Node *x);
+    static void move_entry(Node *x, int i, Node *y, int j);
+    static void swap_entry(Node *x, int i, Node *y, int j);
+    static void clear_entry(Node *x, int i);
+    const Node *find_node(const Key &k, int &i) const;
+
+    void insert_entry(Key k, Slot v);
+    void remove(Node *x, const Key &k);
+    void remove_leaf_key(Node *x, int i);
+    void remove_internal_key(Node *x, int i, int j);
+    void merge_left(Node *x, Node *y, Node *p, int i);
+    void swap_left(Node *x, Node *y, Node *z, int i);
+    void swap_right(Node *x, Node *y, Node *z, int i);
+    void split_child(Node *x, int i);
+
+public:
+    FixedBTree() = default;
+    ~FixedBTree() { destroy(root); }
+    FixedBTree(FixedBTree &&other) noexcept : root(other.root) { other.root = nullptr; }
+    FixedBTree &operator=(FixedBTree &&other) noexcept
+    {
+        std::swap(root, other.root);
+        return *this;
+    }
+    FixedBTree(const FixedBTree &) = delete;
+    FixedBTree &operator=(const FixedBTree &) = delete;
+
+    // copy the shape and keys of a runtime-degree tree, its degree must be T (values start default constructed)
+    static FixedBTree from(BTree &tree);
+
+    static constexpr int degree() { return T; }
+    void insert(Key k) { insert_entry(std::move(k), Slot()); }
+    // insert k with the value v, or replace the value of k if k is in the tree
+    template <typename V = Value>
+        requires(!std::is_void_v<V>)
+    void insert(Key k, std::type_identity_t<V> v)
+    {
+        insert_entry(std::move(k), ValueSlot<V>::wrap(std::move(v)));
+    }
+    void remove(const Key &k);
+    bool contains(const Key &k) const;
+    // the value of k, nullptr if k is not in the tree; valid until the next insert or remove
+    template <typename V = Value>
+        requires(!std::is_void_v<V>)
+    V *find(const Key &k)
+    {
+        int i;
+        Node *x = const_cast<Node *>(find_node(k, i));
+        return x ? &ValueSlot<V>::get(x->vals[i]) : nullptr;
+    }
+    // For debugging, same format as BTree::print
+    void print(std::ostream &out = std::cout) const;
+};
+
+// return the index i of the first key in x that is >= k, or x->n if there is none
+// Precondition: x is a valid node
+// Postcondition: 0 <= i <= x->n
+// int keys use the CPUID-dispatched rank kernels of BTree. Other small arithmetic keys compare against all
+// MAX_KEYS slots (unused slots are masked by j < n), a constant trip count loop that vectorizes cleanly.
+
+template <typename Key, int T, typename Value>
+int FixedBTree<Key, T, Value>::find_k(const Node *x, const Key &k)
+{
+    if constexpr (std::is_same_v<Key, int>)
+    {
+        return node_rank(x->keys, x->n, k);
+    }
+    else if constexpr (std::is_arithmetic_v<Key> && MAX_KEYS <= 64)
+    {
+        int i = 0;
+        for (int j = 0; j < MAX_KEYS; j++)
+        {
+            i += (j < x->n) & (x->keys[j] < k);
+        }
+        return i;
+    }
+    else
+    {
+        return (int)(std::lower_bound(x->keys, x->keys + x->n, k) - x->keys);
+    }
+}
+
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::destroy(Node *x)
+{
+    if (!x)
+    {
+        return;
+    }
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            destroy(x->c[i]);
+        }
+    }
+    delete x;
+}
+
+template <typename Key, int T, typename Value>
+typename FixedBTree<Key, T, Value>::Node *FixedBTree<Key, T, Value>::copy_from(const ::Node *x)
+{
+    Node *y = new Node;
+    y->n = x->n;
+    y->leaf = x->leaf;
+    for (int i = 0; i < x->n; i++)
+    {
+        y->keys[i] = Key(x->keys[i]);
+    }
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            y->c[i] = copy_from(x->c[i]);
+        }
+    }
+    return y;
+}
+
+template <typename Key, int T, typename Value>
+FixedBTree<Key, T, Value> FixedBTree<Key, T, Value>::from(BTree &tree)
+{
+    FixedBTree result;
+    tree.materialize();
+    if (tree.degree() == T && tree.root)
+    {
+        result.root = copy_from(tree.root);
+    }
+    return result;
+}
+
+// move entry j of y (key and value) into slot i of x
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::move_entry(Node *x, int i, Node *y, int j)
+{
+    x->keys[i] = std::move(y->keys[j]);
+    if constexpr (HAS_VALUES)
+    {
+        x->vals[i] = std::move(y->vals[j]);
+    }
+}
+
+// exchange entry i of x with entry j of y
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::swap_entry(Node *x, int i, Node *y, int j)
+{
+    std::swap(x->keys[i], y->keys[j]);
+    if constexpr (HAS_VALUES)
+    {
+        std::swap(x->vals[i], y->vals[j]);
+    }
+}
+
+// release what a slot that was moved out of or dropped still owns (nothing for plain keys and inline values)
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::clear_entry(Node *x, int i)
+{
+    if constexpr (!std::is_trivially_destructible_v<Key>)
+    {
+        x->keys[i] = Key();
+    }
+    if constexpr (HAS_VALUES && !std::is_trivially_destructible_v<Slot>)
+    {
+        x->vals[i] = Slot();
+    }
+}
+
+// return the node holding k and set i to its index there, nullptr if k is not in the tree
+template <typename Key, int T, typename Value>
+const typename FixedBTree<Key, T, Value>::Node *FixedBTree<Key, T, Value>::find_node(const Key &k, int &i) const
+{
+    const Node *x = root;
+    while (x != nullptr)
+    {
+        i = find_k(x, k);
+        if (i < x->n && equal(x->keys[i], k))
+        {
+            return x;
+        }
+        if (x->leaf)
+        {
+            return nullptr;
+        }
+        x = x->c[i];
+    }
+    return nullptr;
+}
+
+template <typename Key, int T, typename Value>
+bool FixedBTree<Key, T, Value>::contains(const Key &k) const
+{
+    int i;
+    return find_node(k, i) != nullptr;
+}
+
+// insert the key k with the stored value v, splitting full nodes on the way down (see btree_insert.cpp)
+// A key that is already in the tree keeps its place and takes v as its new value.
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::insert_entry(Key k, Slot v)
+{
+    if (!root)
+    {
+        root = new Node;
+        root->keys[0] = std::move(k);
+        if constexpr (HAS_VALUES)
+        {
+            root->vals[0] = std::move(v);
+        }
+        root->n = 1;
+        return;
+    }
+    if (root->n == MAX_KEYS)
+    {
+        Node *new_root = new Node;
+        new_root->leaf = false;
+        new_root->c[0] = root;
+        root = new_root;
+        split_child(root, 0);
+    }
+
+    Node *x = root;
+    while (true)
+    {
+        int i = find_k(x, k);
+        if (i < x->n && equal(x->keys[i], k))
+        {
+            if constexpr (HAS_VALUES)
+            {
+                x->vals[i] = std::move(v);
+            }
+            return;
+        }
+        if (x->leaf)
+        {
+            for (int j = x->n; j > i; j--)
+            {
+                move_entry(x, j, x, j - 1);
+            }
+            x->keys[i] = std::move(k);
+            if constexpr (HAS_VALUES)
+            {
+                x->vals[i] = std::move(v);
+            }
+            x->n++;
+            return;
+        }
+        Node *next = x->c[i];
+        if (next->n == MAX_KEYS)
+        {
+            split_child(x, i);
+            if (equal(k, x->keys[i]))
+            {
+                if constexpr (HAS_VALUES)
+                {
+                    x->vals[i] = std::move(v);
+                }
+                return;
+            }
+            if (x->keys[i] < k)
+            {
+                next = x->c[i + 1];
+            }
+        }
+        x = next;
+    }
+}
+
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::split_child(Node *x, int i)
+{
+    Node *y = x->c[i];
+    Node *z = new Node;
+    z->leaf = y->leaf;
+
+    for (int j = 0; j < T - 1; j++)
+    {
+        move_entry(z, j, y, j + T);
+    }
+    if (!y->leaf)
+    {
+        for (int j = 0; j < T; j++)
+        {
+            z->c[j] = y->c[j + T];
+            y->c[j + T] = nullptr;
+        }
+    }
+    z->n = T - 1;
+    y->n = T - 1;
+
+    for (int j = x->n; j > i; j--)
+    {
+        x->c[j + 1] = x->c[j];
+    }
+    x->c[i + 1] = z;
+    for (int j = x->n - 1; j >= i; j--)
+    {
+        move_entry(x, j + 1, x, j);
+    }
+    move_entry(x, i, y, T - 1);
+    x->n++;
+}
+
+// delete the key k, same cases as BTree::remove (see btree_delete.cpp)
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::remove(const Key &k)
+{
+    if (!root)
+    {
+        return;
+    }
+    remove(root, k);
+
+    if (root->n == 0 && !root->leaf)
+    {
+        Node *old_root = root;
+        root = root->c[0];
+        delete old_root;
+    }
+    else if (root->n == 0 && root->leaf)
+    {
+        delete root;
+        root = nullptr;
+    }
+}
+
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::remove(Node *x, const Key &k)
+{
+    while (x != nullptr)
+    {
+        int i = find_k(x, k);
+        bool found = i < x->n && equal(x->keys[i], k);
+
+        // Case 1: key k in leaf x
+        if (found && x->leaf)
+        {
+            remove_leaf_key(x, i);
+            return;
+        }
+
+        // Case 2: key k in internal node x
+        if (found)
+        {
+            Node *left_node = x->c[i];
+            Node *right_node = x->c[i + 1];
+
+            // Case 2a: the predecessor moves up into x and k's entry takes its slot, the largest of the left
+            // subtree (k is bigger than every key there), where the descent below finds and deletes it
+            if (left_node->n >= T)
+            {
+                Node *leaf = left_node;
+                while (!leaf->leaf)
+                {
+                    leaf = leaf->c[leaf->n];
+                }
+                swap_entry(x, i, leaf, leaf->n - 1);
+                remove(left_node, k);
+            }
+            // Case 2b: the same with the successor, the smallest slot of the right subtree
+            else if (right_node->n >= T)
+            {
+                Node *leaf = right_node;
+                while (!leaf->leaf)
+                {
+                    leaf = leaf->c[0];
+                }
+                swap_entry(x, i, leaf, 0);
+                remove(right_node, k);
+            }
+            // Case 2c: merge both children around k and delete k from the merged node
+            else
+            {
+                merge_left(left_node, right_node, x, i);
+                remove_internal_key(x, i, i + 1);
+                remove(left_node, k);
+            }
+            return;
+        }
+
+        if (x->leaf)
+        {
+            return;
+        }
+
+        // Case 3: make sure the child we descend into has at least T keys
+        Node *next = x->c[i];
+        Node *left_sib = (i > 0) ? x->c[i - 1] : nullptr;
+        Node *right_sib = (i < x->n) ? x->c[i + 1] : nullptr;
+
+        if (next->n == MIN_KEYS)
+        {
+            // Case 3a: borrow from the right sibling first, then the left
+            if (right_sib != nullptr && right_sib->n > MIN_KEYS)
+            {
+                swap_right(x, next, right_sib, i);
+            }
+            else if (left_sib != nullptr && left_sib->n > MIN_KEYS)
+            {
+                swap_left(x, next, left_sib, i - 1);
+            }
+            // Case 3b: merge with the right sibling if there is one, otherwise the left
+            else if (right_sib != nullptr)
+            {
+                merge_left(next, right_sib, x, i);
+                remove_internal_key(x, i, i + 1);
+            }
+            else
+            {
+                merge_left(left_sib, next, x, i - 1);
+                remove_internal_key(x, i - 1, i);
+                next = left_sib;
+            }
+        }
+        x = next;
+    }
+}
+
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::remove_leaf_key(Node *x, int i)
+{
+    for (int j = i; j < x->n - 1; j++)
+    {
+        move_entry(x, j, x, j + 1);
+    }
+    clear_entry(x, x->n - 1);
+    x->n--;
+}
+
+// drop key i of x, which merge_left already moved down, and the child pointer j
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::remove_internal_key(Node *x, int i, int j)
+{
+    for (int k = i; k < x->n - 1; k++)
+    {
+        move_entry(x, k, x, k + 1);
+    }
+    clear_entry(x, x->n - 1);
+    for (int k = j; k < x->n; k++)
+    {
+        x->c[k] = x->c[k + 1];
+    }
+    x->c[x->n] = nullptr;
+    x->n--;
+}
+
+// merge separator p->keys[i] and all of y into its left sibling x, then free y
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::merge_left(Node *x, Node *y, Node *p, int i)
+{
+    move_entry(x, x->n, p, i);
+    for (int j = 0; j < y->n; j++)
+    {
+        move_entry(x, x->n + 1 + j, y, j);
+    }
+    if (!x->leaf)
+    {
+        for (int j = 0; j <= y->n; j++)
+        {
+            x->c[x->n + 1 + j] = y->c[j];
+        }
+    }
+    x->n += y->n + 1;
+    delete y;
+}
+
+// y borrows through parent x from its left sibling z, x->keys[i] separates z and y
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::swap_left(Node *x, Node *y, Node *z, int i)
+{
+    for (int j = y->n - 1; j >= 0; j--)
+    {
+        move_entry(y, j + 1, y, j);
+    }
+    if (!y->leaf)
+    {
+        for (int j = y->n; j >= 0; j--)
+        {
+            y->c[j + 1] = y->c[j];
+        }
+        y->c[0] = z->c[z->n];
+        z->c[z->n] = nullptr;
+    }
+    move_entry(y, 0, x, i);
+    move_entry(x, i, z, z->n - 1);
+    clear_entry(z, z->n - 1);
+    y->n++;
+    z->n--;
+}
+
+// y borrows through parent x from its right sibling z, x->keys[i] separates y and z
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::swap_right(Node *x, Node *y, Node *z, int i)
+{
+    move_entry(y, y->n, x, i);
+    if (!y->leaf)
+    {
+        y->c[y->n + 1] = z->c[0];
+    }
+    move_entry(x, i, z, 0);
+    for (int j = 0; j < z->n - 1; j++)
+    {
+        move_entry(z, j, z, j + 1);
+    }
+    clear_entry(z, z->n - 1);
+    if (!z->leaf)
+    {
+        for (int j = 0; j < z->n; j++)
+        {
+            z->c[j] = z->c[j + 1];
+        }
+        z->c[z->n] = nullptr;
+    }
+    y->n++;
+    z->n--;
+}
+
+template <typename Key, int T, typename Value>
+void FixedBTree<Key, T, Value>::print(std::ostream &out) const
+{
+    if (!root)
+        return;
+
+    std::queue<const Node *> q;
+    q.push(root);
+    while (!q.empty())
+    {
+        int level_n = q.size();
+        for (int i = 0; i < level_n; i++)
+        {
+            const Node *node = q.front();
+            q.pop();
+            for (int j = 0; j < node->n; j++)
+            {
+                out << node->keys[j];
+                if (j < node->n - 1)
+                    out << ",";
+            }
+            if (i < level_n - 1)
+                out << "\t";
+            if (!node->leaf)
+            {
+                for (int j = 0; j <= node->n; j++)
+                    q.push(node->c[j]);
+            }
+        }
+        out << "\n";
+    }
+}
+
+// The degrees AnyBTree can specialize, compiled once in btree_fixed.cpp
+extern template class FixedBTree<int, 2>;
+extern template class FixedBTree<int, 3>;
+extern template class FixedBTree<int, 4>;
+extern template class FixedBTree<int, 8>;
+extern template class FixedBTree<int, 16>;
+extern template class FixedBTree<int, 32>;
+extern template class FixedBTree<int, 64>;
+
+// Runtime-degree facade with the same interface as BTree
+// If t is one of the preinstantiated degrees the keys live in a FixedBTree<int, t>, otherwise in a plain BTree.
+class AnyBTree
+{
+private:
+    std::variant<std::unique_ptr<BTree>, FixedBTree<int, 2>, FixedBTree<int, 3>, FixedBTree<int, 4>,
+                 FixedBTree<int, 8>, FixedBTree<int, 16>, FixedBTree<int, 32>, FixedBTree<int, 64>>
+        tree;
+
+    void specialize(std::unique_ptr<BTree> loaded);
+
+public:
+    AnyBTree(const std::string &filename);
+    AnyBTree(int t);
+    bool specialized() const { return tree.index() != 0; }
+    void insert(int k);
+    void remove(int k);
+    bool contains(int k) const;
+    void print() const;
+};
+
+#endif
@@ -0,0 +1,487 @@
+#include "btree_frozen.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const char FROZEN_MAGIC[8] = {'B', 'T', 'F', 'R', 'O', 'Z', 'E', 'N'};
+static const uint32_t FROZEN_VERSION = 1;
+static const uint32_t FROZEN_BYTE_ORDER = 0x01020304;
+
+// Helper: blocks per layer for n keys, bottom layer first
+static std::vector<size_t> layer_sizes(size_t n)
+{
+    std::vector<size_t> sizes;
+    if (n == 0)
+    {
+        return sizes;
+    }
+    sizes.push_back((n + FROZEN_B - 1) / FROZEN_B);
+    while (sizes.back() > 1)
+    {
+        sizes.push_back((sizes.back() + FROZEN_B) / (FROZEN_B + 1));
+    }
+    return sizes;
+}
+
+// Helper: largest offset a frame can store in width bytes, the last frame pads its offsets with it
+static uint32_t max_offset(int width)
+{
+    return width == 4 ? UINT32_MAX : (uint32_t(1) << (8 * width)) - 1;
+}
+
+// Helper: offset j of the FROZEN_B offsets of the given width at p
+static uint32_t read_offset(const uint8_t *p, int width, int j)
+{
+    if (width == 1)
+    {
+        return p[j];
+    }
+    if (width == 2)
+    {
+        uint16_t v;
+        std::memcpy(&v, p + 2 * j, 2);
+        return v;
+    }
+    uint32_t v;
+    std::memcpy(&v, p + 4 * j, 4);
+    return v;
+}
+
+// Helper: number of the FROZEN_B offsets of the given width at p that are smaller than r
+// Precondition: the offsets are ascending and r <= max_offset(width)
+static int offsets_below(const uint8_t *p, int width, uint32_t r)
+{
+#ifdef __SSE2__
+    // SSE2 only compares signed lanes: flipping the top bit of both sides orders unsigned values the same way
+    static_assert(FROZEN_B == 16, "one frame of offsets is 1, 2 or 4 vectors");
+    const __m128i *v = reinterpret_cast<const __m128i *>(p);
+    __m128i less;
+    if (width == 1)
+    {
+        __m128i flip = _mm_set1_epi8((char)0x80);
+        less = _mm_cmplt_epi8(_mm_xor_si128(_mm_loadu_si128(v), flip), _mm_xor_si128(_mm_set1_epi8((char)r), flip));
+    }
+    else if (width == 2)
+    {
+        __m128i flip = _mm_set1_epi16((short)0x8000);
+        __m128i rv = _mm_xor_si128(_mm_set1_epi16((short)r), flip);
+        __m128i lo = _mm_cmplt_epi16(_mm_xor_si128(_mm_loadu_si128(v), flip), rv);
+        __m128i hi = _mm_cmplt_epi16(_mm_xor_si128(_mm_loadu_si128(v + 1), flip), rv);
+        less = _mm_packs_epi16(lo, hi);
+    }
+    else
+    {
+        __m128i flip = _mm_set1_epi32((int)0x80000000u);
+        __m128i rv = _mm_xor_si128(_mm_set1_epi32((int)r), flip);
+        __m128i part[4];
+        for (int i = 0; i < 4; i++)
+        {
+            part[i] = _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128(v + i), flip), rv);
+        }
+        less = _mm_packs_epi16(_mm_packs_epi32(part[0], part[1]), _mm_packs_epi32(part[2], part[3]));
+    }
+    return std::popcount((unsigned)_mm_movemask_epi8(less)); // one bit per offset
+#else
+    int below = 0;
+    for (int j = 0; j < FROZEN_B; j++)
+    {
+        below += read_offset(p, width, j) < r;
+    }
+    return below;
+#endif
+}
+
+// Frozen copy of sorted_keys, stored as encoding asks
+// Precondition: sorted_keys is strictly ascending
+// Postcondition: the tree holds sorted_keys, FrameOfReference keys stay plain if packing them saves no memory
+
+FrozenBTree::FrozenBTree(std::span<const int> sorted_keys, FrozenEncoding encoding) : n(0), encoding(FrozenEncoding::Plain)
+{
+    build(sorted_keys);
+    if (encoding == FrozenEncoding::FrameOfReference)
+    {
+        pack();
+    }
+}
+
+// lay out the layers for sorted_keys
+// Precondition: sorted_keys is strictly ascending
+// Postcondition: the blocks hold sorted_keys in the bottom layer and the inner layers route every lookup to it
+
+void FrozenBTree::build(std::span<const int> sorted_keys)
+{
+    n = sorted_keys.size();
+    std::vector<size_t> sizes = layer_sizes(n);
+    std::reverse(sizes.begin(), sizes.end()); // root first
+    layer_start.assign(sizes.size(), 0);
+    layer_blocks = sizes;
+    size_t total = 0;
+    for (size_t l = 0; l < sizes.size(); l++)
+    {
+        layer_start[l] = total;
+        total += sizes[l];
+    }
+    blocks.assign(total, FrozenBlock());
+    if (n == 0)
+    {
+        return;
+    }
+
+    // bottom layer: the keys, padded with INT_MAX
+    int *bottom = blocks[layer_start.back()].keys;
+    std::copy(sorted_keys.begin(), sorted_keys.end(), bottom);
+    std::fill(bottom + n, bottom + sizes.back() * FROZEN_B, INT_MAX);
+
+    // largest key below every block of the layer under construction
+    std::vector<int> below_max(sizes.back());
+    for (size_t k = 0; k < below_max.size(); k++)
+    {
+        below_max[k] = sorted_keys[std::min(n, (k + 1) * FROZEN_B) - 1];
+    }
+    for (size_t l = sizes.size() - 1; l-- > 0;)
+    {
+        std::vector<int> layer_max(sizes[l]);
+        for (size_t k = 0; k < sizes[l]; k++)
+        {
+            FrozenBlock &block = blocks[layer_start[l] + k];
+            for (int i = 0; i < FROZEN_B; i++)
+            {
+                size_t child = k * (FROZEN_B + 1) + i;
+                block.keys[i] = child < below_max.size() ? below_max[child] : INT_MAX;
+            }
+            size_t last = std::min(below_max.size(), (k + 1) * (FROZEN_B + 1)) - 1;
+            layer_max[k] = below_max[last];
+        }
+        below_max.swap(layer_max);
+    }
+}
+
+// replace the blocks of the bottom layer with frames of offsets
+// Precondition: the keys are plain
+// Postcondition: the keys are encoded with FrameOfReference unless that would not save memory (keys mostly more
+//                than 65535 apart within a frame), lookups find the same keys either way
+
+void FrozenBTree::pack()
+{
+    if (n == 0)
+    {
+        return;
+    }
+    size_t count = layer_blocks.back();
+    const int *keys = blocks[layer_start.back()].keys;
+    std::vector<uint8_t> widths(count);
+    size_t total = 0;
+    for (size_t f = 0; f < count; f++)
+    {
+        const int *run = keys + f * FROZEN_B;
+        int m = (int)std::min<size_t>(FROZEN_B, n - f * FROZEN_B);
+        uint32_t span = uint32_t((long long)run[m - 1] - run[0]);
+        widths[f] = span <= max_offset(1) ? 1 : (span <= max_offset(2) ? 2 : 4);
+        total += widths[f];
+    }
+    if ((count + 1) * sizeof(FrozenFrame) + total * FROZEN_B >= count * sizeof(FrozenBlock))
+    {
+        return;
+    }
+
+    encoding = FrozenEncoding::FrameOfReference;
+    frames.reserve(count + 1);
+    packed.resize(total * FROZEN_B);
+    uint32_t at = 0;
+    for (size_t f = 0; f < count; f++)
+    {
+        const int *run = keys + f * FROZEN_B;
+        int m = (int)std::min<size_t>(FROZEN_B, n - f * FROZEN_B);
+        int width = widths[f];
+        frames.push_back({run[0], at});
+        uint8_t *p = packed.data() + (size_t)at * FROZEN_B;
+        for (int j = 0; j < FROZEN_B; j++)
+        {
+            uint32_t offset = j < m ? uint32_t((long long)run[j] - run[0]) : max_offset(width);
+            if (width == 1)
+            {
+                p[j] = (uint8_t)offset;
+            }
+            else if (width == 2)
+            {
+                uint16_t v = (uint16_t)offset;
+                std::memcpy(p + 2 * j, &v, 2);
+            }
+            else
+            {
+                std::memcpy(p + 4 * j, &offset, 4);
+            }
+        }
+        at += width;
+    }
+    frames.push_back({0, at});
+    blocks.resize(layer_start.back());
+    blocks.shrink_to_fit();
+}
+
+// number of keys of frame f smaller than k
+// Precondition: the keys are packed and f < layer_blocks.back()
+// Postcondition: returns 0 .. FROZEN_B (FROZEN_B also for k above the keys of the last, partial frame)
+
+size_t FrozenBTree::frame_rank(size_t f, int k) const
+{
+    int base = frames[f].base;
+    if (k <= base)
+    {
+        return 0;
+    }
+    int width = (int)(frames[f + 1].at - frames[f].at);
+    uint32_t r = uint32_t((long long)k - base);
+    if (r > max_offset(width))
+    {
+        return FROZEN_B;
+    }
+    return offsets_below(packed.data() + (size_t)frames[f].at * FROZEN_B, width, r);
+}
+
+// return the key with i smaller keys
+// Precondition: i < size()
+// Postcondition: O(1), packed keys are decoded from their frame
+
+int FrozenBTree::key(size_t i) const
+{
+    if (encoding == FrozenEncoding::Plain)
+    {
+        return sorted()[i];
+    }
+    const FrozenFrame &frame = frames[i / FROZEN_B];
+    int width = (int)(frames[i / FROZEN_B + 1].at - frame.at);
+    uint32_t offset = read_offset(packed.data() + (size_t)frame.at * FROZEN_B, width, (int)(i % FROZEN_B));
+    return (int)((long long)frame.base + offset);
+}
+
+// write every key in ascending order to out
+// Precondition: out has room for size() keys
+// Postcondition: out[0 .. size()) holds the keys
+
+void FrozenBTree::decode(int *out) const
+{
+    if (encoding == FrozenEncoding::Plain)
+    {
+        std::copy(sorted(), sorted() + n, out);
+        return;
+    }
+    for (size_t f = 0; f + 1 < frames.size(); f++)
+    {
+        int width = (int)(frames[f + 1].at - frames[f].at);
+        const uint8_t *p = packed.data() + (size_t)frames[f].at * FROZEN_B;
+        size_t m = std::min<size_t>(FROZEN_B, n - f * FROZEN_B);
+        for (size_t j = 0; j < m; j++)
+        {
+            out[f * FROZEN_B + j] = (int)((long long)frames[f].base + read_offset(p, width, (int)j));
+        }
+    }
+}
+
+// index of the smallest key >= k
+// Precondition: None
+// Postcondition: returns an index into keys(), size() if every key is < k
+
+size_t FrozenBTree::lower_bound(int k) const
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+    size_t block = 0;
+    size_t last = layer_start.size() - 1;
+    for (size_t l = 0; l < last; l++)
+    {
+        int i = node_rank(blocks[layer_start[l] + block].keys, FROZEN_B, k);
+        block = block * (FROZEN_B + 1) + i;
+        if (block >= layer_blocks[l + 1])
+        {
+            return n; // past the last real child, every key is < k
+        }
+    }
+    size_t in_block = encoding == FrozenEncoding::Plain ? node_rank(blocks[layer_start[last] + block].keys, FROZEN_B, k)
+                                                        : frame_rank(block, k);
+    return std::min(block * FROZEN_B + in_block, n);
+}
+
+// return true if key k is in the frozen tree
+bool FrozenBTree::contains(int k) const
+{
+    size_t at = lower_bound(k);
+    return at < n && key(at) == k;
+}
+
+// write the header and the block array to filename
+// Precondition: None
+// Postcondition: returns true if the whole file was written, load() reads it back
+
+bool FrozenBTree::save(const std::string &filename) const
+{
+    std::FILE *out = std::fopen(filename.c_str(), "wb");
+    if (!out)
+    {
+        std::cerr << "Error: cannot write " << filename << "\n";
+        return false;
+    }
+    FrozenHeader header = {};
+    std::memcpy(header.magic, FROZEN_MAGIC, sizeof(FROZEN_MAGIC));
+    header.version = FROZEN_VERSION;
+    header.byte_order = FROZEN_BYTE_ORDER;
+    header.key_count = n;
+    header.block_count = blocks.size() + (encoding == FrozenEncoding::Plain || n == 0 ? 0 : layer_blocks.back());
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+              (blocks.empty() || std::fwrite(blocks.data(), sizeof(FrozenBlock), blocks.size(), out) == blocks.size());
+    if (encoding != FrozenEncoding::Plain)
+    {
+        // the bottom layer is decoded one block at a time, padded with INT_MAX like build() does
+        for (size_t f = 0; ok && f + 1 < frames.size(); f++)
+        {
+            FrozenBlock block;
+            std::fill(block.keys, block.keys + FROZEN_B, INT_MAX);
+            for (size_t j = 0; j < FROZEN_B && f * FROZEN_B + j < n; j++)
+            {
+                block.keys[j] = key(f * FROZEN_B + j);
+            }
+            ok = std::fwrite(&block, sizeof(block), 1, out) == 1;
+        }
+    }
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok)
+    {
+        std::cerr << "Error: cannot write " << filename << "\n";
+    }
+    return ok;
+}
+
+// replace the frozen tree with the one saved in filename
+// Precondition: None
+// Postcondition: returns true and the tree is the saved one, or returns false and the tree is empty
+//                if the file is missing, truncated, longer than its header says or was written on a machine with
+//                another byte order, nothing is allocated for the blocks before the file size checks out
+
+bool FrozenBTree::load(const std::string &filename)
+{
+    n = 0;
+    encoding = FrozenEncoding::Plain;
+    blocks.clear();
+    layer_start.clear();
+    layer_blocks.clear();
+    frames.clear();
+    packed.clear();
+
+    std::FILE *in = std::fopen(filename.c_str(), "rb");
+    if (!in)
+    {
+        std::cerr << "Error: cannot open file " << filename << "\n";
+        return false;
+    }
+    FrozenHeader header;
+    std::string problem;
+    if (std::fread(&header, sizeof(header), 1, in) != 1)
+        problem = "file is too short";
+    else if (std::memcmp(header.magic, FROZEN_MAGIC, sizeof(FROZEN_MAGIC)) != 0)
+        problem = "not a frozen tree";
+    else if (header.version != FROZEN_VERSION)
+        problem = "unsupported version";
+    else if (header.byte_order != FROZEN_BYTE_ORDER)
+        problem = "written with another byte order";
+
+    // Everything the header promises must be in the file before anything is sized from it
+    size_t remaining = 0;
+    if (problem.empty())
+    {
+        long here = std::ftell(in);
+        if (here < 0 || std::fseek(in, 0, SEEK_END) != 0)
+            problem = "cannot find the file size";
+        else
+        {
+            long end = std::ftell(in);
+            remaining = end > here ? end - here : 0;
+            if (std::fseek(in, here, SEEK_SET) != 0)
+                problem = "cannot find the file size";
+        }
+    }
+    if (problem.empty() && (header.key_count > remaining / sizeof(int) ||
+                            header.block_count != remaining / sizeof(FrozenBlock) || remaining % sizeof(FrozenBlock) != 0))
+    {
+        problem = "file size does not match the block count";
+    }
+
+    std::vector<size_t> sizes;
+    if (problem.empty())
+    {
+        sizes = layer_sizes(header.key_count);
+        size_t total = 0;
+        for (size_t s : sizes)
+        {
+            total += s;
+        }
+        if (total != header.block_count)
+        {
+            problem = "block count does not match the key count";
+        }
+        else
+        {
+            blocks.resize(total);
+            if (total > 0 && std::fread(blocks.data(), sizeof(FrozenBlock), total, in) != total)
+            {
+                problem = "file is truncated";
+            }
+        }
+    }
+    std::fclose(in);
+    if (!problem.empty())
+    {
+        std::cerr << "Error: " << filename << ": " << problem << "\n";
+        blocks.clear();
+        return false;
+    }
+
+    n = header.key_count;
+    std::reverse(sizes.begin(), sizes.end());
+    layer_blocks = sizes;
+    size_t total = 0;
+    for (size_t s : sizes)
+    {
+        layer_start.push_back(total);
+        total += s;
+    }
+    return true;
+}
+
+// freeze the current keys into a read-only S+ tree
+// Precondition: None
+// Postcondition: returns a FrozenBTree holding every key of the tree (tombstones excluded) stored as encoding asks,
+//                the tree is unchanged
+
+FrozenBTree BTree::freeze(FrozenEncoding encoding)
+{
+    std::vector<int> sorted;
+    for (int k : *this)
+    {
+        sorted.push_back(k);
+    }
+    return FrozenBTree(sorted, encoding);
+}
+
+// Tree of minimum degree t holding the keys of a frozen tree
+BTree::BTree(const FrozenBTree &frozen, int t) : BTree(t)
+{
+    if (t < 2)
+    {
+        return;
+    }
+    if (frozen.key_encoding() == FrozenEncoding::Plain)
+    {
+        assign_sorted(frozen.keys());
+        return;
+    }
+    std::vector<int> sorted(frozen.size());
+    frozen.decode(sorted.data());
+    assign_sorted(sorted);
+}
@@ -0,0 +1,91 @@
+#ifndef BTREE_FROZEN_H
+#define BTREE_FROZEN_H
+
+#include "btree.h"
+#include <climits>
+
+/*
+NOTE: Read-only S+ tree built by BTree::freeze(). Every node is one 64-byte block of FROZEN_B keys and holds no
+pointers. The blocks sit in one array, layer by layer from the root down, and the children of block k are
+the blocks k*(FROZEN_B+1) .. k*(FROZEN_B+1)+FROZEN_B of the next layer, so a lookup computes where to go
+instead of loading a child pointer. The bottom layer is the sorted key array itself, a range scan is a
+linear walk over it. Key i of an inner block is the largest key below its child i, unused slots hold INT_MAX.
+With FrozenEncoding::FrameOfReference the bottom layer is not stored as blocks: each block of FROZEN_B keys
+becomes a FrozenFrame, its first key and the offsets of all its keys from it, 1, 2 or 4 bytes each depending on
+how far apart the keys of the frame are. Dense keys then take 1 byte instead of 4, keys too far apart for that to
+save memory stay plain (key_encoding() tells). The last step of a lookup compares the offsets of one frame with
+SSE2 and does not decode them.
+*/
+
+static const int FROZEN_B = 16; // keys per block, one cache line of ints
+
+struct alignas(64) FrozenBlock
+{
+    int keys[FROZEN_B];
+};
+
+// A block of the bottom layer under FrozenEncoding::FrameOfReference. The offsets of frame f fill the packed bytes
+// from 16 * at up to where frame f+1 starts, so their width needs no field of its own (a last frame ends the array).
+struct FrozenFrame
+{
+    int base;    // first key of the frame, every other key is base + its offset
+    uint32_t at; // start of the offsets in the packed bytes, in units of FROZEN_B bytes
+};
+
+// Header of a file written by FrozenBTree::save, followed by the block array exactly as it is in memory
+struct FrozenHeader
+{
+    char magic[8];       // "BTFROZEN"
+    uint32_t version;    // FROZEN_VERSION
+    uint32_t byte_order; // 0x01020304
+    uint64_t key_count;
+    uint64_t block_count;
+};
+
+class FrozenBTree
+{
+private:
+    size_t n;                          // number of keys
+    FrozenEncoding encoding;
+    std::vector<FrozenBlock> blocks;   // every layer, root first (the inner layers only if the keys are packed)
+    std::vector<size_t> layer_start;   // index of each layer's first block, the last layer holds the keys
+    std::vector<size_t> layer_blocks;  // blocks in each layer
+    std::vector<FrozenFrame> frames;   // the bottom layer under FrameOfReference, one more frame ends the offsets
+    std::vector<uint8_t> packed;       // the offsets of every frame
+
+    void build(std::span<const int> sorted_keys);
+    void pack();
+    size_t frame_rank(size_t f, int k) const;
+    const int *sorted() const
+    {
+        return encoding != FrozenEncoding::Plain || blocks.empty() ? nullptr : blocks[layer_start.back()].keys;
+    }
+
+public:
+    FrozenBTree() : n(0), encoding(FrozenEncoding::Plain) {}
+    explicit FrozenBTree(std::span<const int> sorted_keys, FrozenEncoding encoding = FrozenEncoding::Plain);
+
+    size_t size() const { return n; }
+    FrozenEncoding key_encoding() const { return encoding; }
+    // the keys in ascending order, one contiguous array, empty if they are packed (key() and decode() read those)
+    std::span<const int> keys() const { return std::span<const int>(sorted(), sorted() ? n : 0); }
+    // the key with i smaller keys, i < size()
+    int key(size_t i) const;
+    // write every key in ascending order to out, which has room for size() keys
+    void decode(int *out) const;
+    bool contains(int k) const;
+    // index of the smallest key >= k in ascending order, or size() if there is none
+    size_t lower_bound(int k) const;
+    // bytes of the blocks, frames and offsets
+    size_t bytes() const
+    {
+        return blocks.size() * sizeof(FrozenBlock) + frames.size() * sizeof(FrozenFrame) + packed.size();
+    }
+
+    // The file is the header followed by the blocks, load reads them back without rebuilding anything.
+    // Packed keys are written as plain blocks, so a loaded tree always has plain keys.
+    bool save(const std::string &filename) const;
+    bool load(const std::string &filename);
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include "btree.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+NOTE: Binary tree images. save_image writes the nodes in level order as fixed-size records with
+child record indexes instead of pointers. open_image maps the file read-only and answers contains /
+lookup_many straight from the mapping, so opening costs no parsing and no per-node allocation.
+The first operation that needs real nodes (insert, remove, print, cursors) calls materialize(),
+which copies every record into the node pool and unmaps the file.
+*/
+
+static const char IMAGE_MAGIC[8] = {'B', 'T', 'R', 'E', 'E', 'I', 'M', 'G'};
+static const uint32_t IMAGE_VERSION = 1;
+static const uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+
+// Helper: bytes of one node record for degree t
+static size_t record_size(int t)
+{
+    size_t keys_end = 8 + sizeof(int32_t) * (2 * t - 1);
+    return ((keys_end + 7) & ~size_t(7)) + sizeof(uint64_t) * 2 * t;
+}
+
+// Helper: offsets inside a record
+static const int32_t *record_keys(const char *rec)
+{
+    return reinterpret_cast<const int32_t *>(rec + 8);
+}
+
+static const uint64_t *record_children(const char *rec, int t)
+{
+    return reinterpret_cast<const uint64_t *>(rec + record_size(t) - sizeof(uint64_t) * 2 * t);
+}
+
+// Helper: checksum of the node records, 8 bytes at a time (records are a multiple of 8 bytes)
+static uint64_t image_checksum(const char *data, size_t bytes)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < bytes; i += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ w) * 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+// write the tree to filename as a binary image
+// Precondition: None (handles empty tree case)
+// Postcondition: returns true if filename holds an image of the tree that open_image can read back, the tree is unchanged
+
+bool BTree::save_image(const std::string &filename)
+{
+    materialize();
+    compact(tombstones.size()); // the image format has no tombstones
+    flush_messages();           // and no message buffers
+    if (t < 2)
+    {
+        std::cerr << "Error: cannot save a tree without a valid degree\n";
+        return false;
+    }
+
+    // Number the nodes in level order, children of one node get consecutive numbers
+    std::vector<Node *> order;
+    if (root)
+    {
+        order.push_back(root);
+    }
+    for (size_t j = 0; j < order.size(); j++)
+    {
+        Node *x = order[j];
+        if (!x->leaf)
+        {
+            for (int i = 0; i <= x->n; i++)
+            {
+                order.push_back(x->c[i]);
+            }
+        }
+    }
+
+    size_t rec_bytes = record_size(t);
+    std::vector<char> records(order.size() * rec_bytes, 0);
+    uint64_t next_child = 1;
+    for (size_t j = 0; j < order.size(); j++)
+    {
+        Node *x = order[j];
+        char *rec = records.data() + j * rec_bytes;
+        int32_t head[2] = {x->n, x->leaf ? 1 : 0};
+        std::memcpy(rec, head, sizeof(head));
+        std::memcpy(rec + 8, x->keys, sizeof(int32_t) * x->n);
+        if (!x->leaf)
+        {
+            uint64_t *child = reinterpret_cast<uint64_t *>(rec + rec_bytes - sizeof(uint64_t) * 2 * t);
+            for (int i = 0; i <= x->n; i++)
+            {
+                child[i] = next_child++;
+            }
+        }
+    }
+
+    ImageHeader header;
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.byte_order = IMAGE_BYTE_ORDER;
+    header.degree = t;
+    header.record_bytes = rec_bytes;
+    header.node_count = order.size();
+    header.checksum = image_checksum(records.data(), records.size());
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Error: cannot open file " << filename << "\n";
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(records.data(), records.size());
+    if (!out)
+    {
+        std::cerr << "Error: cannot write image " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+// replace the tree with a read-only mapping of the image in filename
+// Precondition: None
+// Postcondition: returns true and the tree answers contains/lookup_many from the mapping without allocating nodes,
+//                returns false and leaves the tree empty if the file is missing, truncated, from another machine or (with verify) corrupted
+
+bool BTree::open_image(const std::string &filename, bool verify)
+{
+    close_image();
+    root = nullptr;
+    tombstones.clear();
+    messages.clear();
+    buffered_height = -1;
+    pool.release();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Error: cannot open file " << filename << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader))
+    {
+        std::cerr << "Error: " << filename << " is too short to be a tree image\n";
+        ::close(fd);
+        return false;
+    }
+    size_t bytes = st.st_size;
+    void *data = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Error: cannot map file " << filename << "\n";
+        return false;
+    }
+
+    const ImageHeader *header = static_cast<const ImageHeader *>(data);
+    std::string problem;
+    if (std::memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0)
+        problem = "not a tree image";
+    else if (header->version != IMAGE_VERSION)
+        problem = "unsupported image version " + std::to_string(header->version);
+    else if (header->byte_order != IMAGE_BYTE_ORDER)
+        problem = "image was saved on a machine with a different byte order";
+    else if (header->degree < 2 || header->record_bytes != record_size(header->degree))
+        problem = "bad degree or record size";
+    else if ((bytes - sizeof(ImageHeader)) % header->record_bytes != 0 ||
+             (bytes - sizeof(ImageHeader)) / header->record_bytes != header->node_count)
+        problem = "file size does not match the node count";
+    else if (verify && image_checksum(static_cast<const char *>(data) + sizeof(ImageHeader),
+                                      bytes - sizeof(ImageHeader)) != header->checksum)
+        problem = "checksum mismatch";
+
+    if (!problem.empty())
+    {
+        std::cerr << "Error: " << filename << ": " << problem << "\n";
+        munmap(data, bytes);
+        return false;
+    }
+
+    image = static_cast<const char *>(data);
+    image_bytes = bytes;
+    t = header->degree;
+    pool.reset(t, order_stats);
+    madvise(data, bytes, MADV_RANDOM);
+    return true;
+}
+
+// return true if key k is in the mapped image
+// Precondition: image is mapped
+// Postcondition: the image is unchanged, a record with a child index that is not after it (or past the last record)
+//                ends the search with false, so an image opened without verify cannot crash or loop the lookup
+
+bool BTree::image_contains(int k) const
+{
+    const ImageHeader *header = reinterpret_cast<const ImageHeader *>(image);
+    if (header->node_count == 0)
+    {
+        return false;
+    }
+    const char *records = image + sizeof(ImageHeader);
+    uint64_t j = 0;
+    const char *rec = records;
+    while (true)
+    {
+        int n = std::clamp(reinterpret_cast<const int32_t *>(rec)[0], 0, 2 * t - 1);
+        bool leaf = reinterpret_cast<const int32_t *>(rec)[1] != 0;
+        const int32_t *keys = record_keys(rec);
+        int i = node_rank(keys, n, k);
+        if (i < n && keys[i] == k)
+        {
+            return true;
+        }
+        if (leaf)
+        {
+            return false;
+        }
+        uint64_t child = record_children(rec, t)[i];
+        if (child <= j || child >= header->node_count)
+        {
+            return false; // bad image, materialize reports it
+        }
+        j = child;
+        rec = records + j * header->record_bytes;
+    }
+}
+
+// copy a mapped image into pool nodes so the tree can change
+// Precondition: None
+// Postcondition: the image (if any) is unmapped, returns true if root holds the same keys and shape as the image,
+//                false (and an empty tree) if the image does not link every record but the first exactly once in level order
+
+bool BTree::materialize()
+{
+    if (!image)
+    {
+        return true;
+    }
+    const ImageHeader *header = reinterpret_cast<const ImageHeader *>(image);
+    const char *records = image + sizeof(ImageHeader);
+
+    // Records are in level order and save_image numbers children as it meets them, so the children of all
+    // records are exactly 1, 2, 3, ... in turn. Anything else would share a node between two parents or leave
+    // a record unlinked, so the running next_child must match every index and reach the end.
+    std::vector<Node *> nodes(header->node_count);
+    uint64_t next_child = 1;
+    bool bad = false;
+    for (uint64_t j = 0; j < header->node_count && !bad; j++)
+    {
+        const char *rec = records + j * header->record_bytes;
+        const int32_t *head = reinterpret_cast<const int32_t *>(rec);
+        if (j == 0)
+        {
+            nodes[j] = pool.alloc(head[1] != 0);
+        }
+        else if (j >= next_child)
+        {
+            std::cerr << "Error: tree image has records that no node links to\n";
+            bad = true;
+            break;
+        }
+        Node *x = nodes[j];
+        x->leaf = head[1] != 0;
+        x->n = head[0] < 0 ? 0 : (head[0] > 2 * t - 1 ? 2 * t - 1 : head[0]);
+        std::memcpy(x->keys, record_keys(rec), sizeof(int) * x->n);
+        if (!x->leaf)
+        {
+            const uint64_t *child = record_children(rec, t);
+            for (int i = 0; i <= x->n; i++)
+            {
+                if (child[i] != next_child || child[i] >= header->node_count)
+                {
+                    std::cerr << "Error: tree image has a bad child index in record " << j << "\n";
+                    bad = true;
+                    break;
+                }
+                const char *child_rec = records + child[i] * header->record_bytes;
+                nodes[child[i]] = pool.alloc(reinterpret_cast<const int32_t *>(child_rec)[1] != 0);
+                x->c[i] = nodes[child[i]];
+                next_child++;
+            }
+        }
+    }
+    if (bad)
+    {
+        root = nullptr;
+        pool.reset(t, order_stats);
+        close_image();
+        return false;
+    }
+    root = nodes.empty() ? nullptr : nodes[0];
+
+    // the image has no subtree counts, children come after their parents so one backward pass adds them up
+    if (order_stats)
+    {
+        std::vector<size_t> sizes(nodes.size());
+        for (uint64_t j = nodes.size(); j-- > 0;)
+        {
+            Node *x = nodes[j];
+            sizes[j] = x->n;
+            if (!x->leaf)
+            {
+                const uint64_t *child = record_children(records + j * header->record_bytes, t);
+                for (int i = 0; i <= x->n; i++)
+                {
+                    x->counts[i] = (uint32_t)sizes[child[i]];
+                    sizes[j] += sizes[child[i]];
+                }
+            }
+        }
+    }
+    close_image();
+    fill_loaded(); // btree_relaxed.cpp, the image may come from a tree with a relaxed delete policy
+    return true;
+}
+
+// unmap the image, if any
+void BTree::close_image()
+{
+    if (image)
+    {
+        munmap(const_cast<char *>(image), image_bytes);
+        image = nullptr;
+        image_bytes = 0;
+    }
+}
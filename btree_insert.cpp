@@ -0,0 +1,264 @@
+#include "btree.h"
+#include "btree_paged.h"
+
+/*
+NOTE: Single pass top-down insert from CLRSv4. Every full child (2t-1 keys) is split before we descend into it,
+so the leaf we finally reach always has room and we never need to walk back up the tree. The cases are templates over
+the tree (ClrsInsert in btree.h) so that PagedBTree runs them on its pages unchanged.
+*/
+
+// insert the key k into the btree
+// Precondition: None (handles empty tree case)
+// Postcondition: Key k is in the BTree (inserting a key that already exists does nothing), tree height may increase by one if the root was full
+
+void BTree::insert(int k)
+{
+    if (t < 2 || !materialize()) // tree failed to load or was built with a bad degree
+    {
+        return;
+    }
+    if (buffered && root && !root->leaf)
+    {
+        buffer_message(k, true); // btree_buffered.cpp
+        return;
+    }
+    insert_now(k);
+}
+
+// insert the key k into the nodes right away, the part of insert() that buffered updates defer
+// Precondition: the tree is materialized and has a valid degree
+// Postcondition: same as insert(int)
+
+void BTree::insert_now(int k)
+{
+    if (is_tombstone(k))
+    {
+        tombstones.erase(k); // k is still in its node, lazy remove only marked it
+        return;
+    }
+
+    if (!root)
+    {
+        root = pool.alloc();
+        root->keys[0] = k;
+        root->n = 1;
+        return;
+    }
+
+    own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+
+    // Full root: grow a new empty root above it and split the old root into two children.
+    // This is the only way the tree gets taller.
+    if (root->n == 2 * t - 1)
+    {
+        Node *new_root = pool.alloc(false);
+        new_root->c[0] = root;
+        if (order_stats)
+        {
+            new_root->counts[0] = subtree_size(root);
+        }
+        root = new_root;
+        split_child(root, 0);
+    }
+
+    insert(root, k);
+}
+
+// insert the key k into the subtree rooted at x
+// Precondition: x is a valid node, changed nodes are owned through tree.own (a BTree root is owned by the caller) and x is not full (x->n < 2t-1)
+// Postcondition: Key k is in the subtree rooted at x, every full node on the search path has been split on the way down,
+//                the insert gives up where a child cannot be read (a paged tree whose BufferPool failed)
+
+template <typename Tree>
+void ClrsInsert<Tree>::insert(Tree &tree, NodeRef x, int k)
+{
+    const int t = tree.t;
+    // with order statistics, the subtree counts on the path grow by one once k is known to be new
+    uint32_t *path_counts[MAX_HEIGHT];
+    int depth = 0;
+
+    while (x)
+    {
+        int i = tree.find_k(x, k);
+
+        // Key k is already in node x, nothing to do
+        if (i < x->n && x->keys[i] == k)
+        {
+            return;
+        }
+
+        // x is a leaf and is not full, so k goes at index i
+        if (x->leaf)
+        {
+            insert_leaf_key(tree, x, i, k);
+            for (int d = 0; d < depth; d++)
+            {
+                (*path_counts[d])++;
+            }
+            return;
+        }
+
+        // x is an internal node: make sure the child we descend into is not full
+        NodeRef next = tree.own(x, i);
+        if (!next)
+        {
+            return;
+        }
+
+        if (next->n == 2 * t - 1)
+        {
+            if (!split_child(tree, x, i))
+            {
+                return;
+            }
+
+            // the median of next moved up into x->keys[i], pick the half that holds k
+            if (k == x->keys[i])
+            {
+                return;
+            }
+            if (k > x->keys[i])
+            {
+                next = tree.own(x, ++i);
+                if (!next)
+                {
+                    return;
+                }
+            }
+        }
+        if constexpr (Tree::COUNTED)
+        {
+            if (tree.order_stats)
+            {
+                path_counts[depth++] = &x->counts[i];
+            }
+        }
+        x = std::move(next); // update for the next loop
+    }
+}
+
+// insert the key k at index i of a btree leaf node x
+// Precondition: x is a leaf node (x->leaf == true), x->n < 2t-1 and 0 <= i <= x->n
+// Postcondition: k is stored at x->keys[i], all keys from index i are shifted right by one position, x->n is incremented by 1
+
+template <typename Tree>
+void ClrsInsert<Tree>::insert_leaf_key(Tree &tree, NodeRef &x, int i, int k)
+{
+    if (!x->leaf) // If x is not leaf, return.
+    {
+        return;
+    }
+    tree.mark_dirty(x);
+    for (int j = x->n; j > i; j--)
+    {
+        x->keys[j] = x->keys[j - 1];
+    }
+    x->keys[i] = k;
+    x->n++;
+}
+
+// split the full child y = x->c[i] around its median key
+// Precondition: x is a non-full internal node, x->c[i] is owned and has exactly 2t-1 keys
+// Postcondition: y keeps its lowest t-1 keys, a new sibling z right of y takes the highest t-1 keys (and the matching t children if internal),
+//                the median key of y is moved up into x->keys[i], z becomes x->c[i+1], x->n is incremented by 1,
+//                returns false and changes nothing if y cannot be read or z cannot be allocated
+
+template <typename Tree>
+bool ClrsInsert<Tree>::split_child(Tree &tree, NodeRef &x, int i)
+{
+    const int t = tree.t;
+    NodeRef y = tree.child(x, i);
+    if (!y)
+    {
+        return false;
+    }
+    NodeRef z = tree.alloc_node(y->leaf);
+    if (!z)
+    {
+        return false;
+    }
+    tree.mark_dirty(x);
+    tree.mark_dirty(y);
+
+    // Move the upper t-1 keys of y into z
+    for (int j = 0; j < t - 1; j++)
+    {
+        z->keys[j] = y->keys[j + t];
+    }
+
+    // Move the upper t children of y into z (if internal node)
+    if (!y->leaf)
+    {
+        for (int j = 0; j < t; j++)
+        {
+            z->c[j] = y->c[j + t];
+            y->c[j + t] = {};
+        }
+    }
+
+    z->n = t - 1;
+    y->n = t - 1;
+
+    // Shift x's children right to make room for z
+    for (int j = x->n; j > i; j--)
+    {
+        x->c[j + 1] = x->c[j];
+    }
+    tree.set_child(x, i + 1, z);
+
+    // Shift x's keys right and move the median of y up
+    for (int j = x->n - 1; j >= i; j--)
+    {
+        x->keys[j + 1] = x->keys[j];
+    }
+    x->keys[i] = y->keys[t - 1];
+
+    // z took t-1 keys and the subtrees under its children, the median left y for x
+    if constexpr (Tree::COUNTED)
+    {
+        if (tree.order_stats)
+        {
+            for (int j = x->n; j > i; j--)
+            {
+                x->counts[j + 1] = x->counts[j];
+            }
+            uint32_t z_keys = t - 1;
+            if (!y->leaf)
+            {
+                for (int j = 0; j < t; j++)
+                {
+                    z->counts[j] = y->counts[j + t];
+                    z_keys += z->counts[j];
+                }
+            }
+            x->counts[i + 1] = z_keys;
+            x->counts[i] -= z_keys + 1;
+        }
+    }
+
+    x->n++;
+    return true;
+}
+
+// The BTree members below run the cases above on Node *, PagedBTree runs the same cases on pinned pages
+
+// insert the key k into the subtree rooted at x, see ClrsInsert::insert
+void BTree::insert(Node *x, int k)
+{
+    ClrsInsert<BTree>::insert(*this, x, k);
+}
+
+// insert the key k at index i of the leaf x, see ClrsInsert::insert_leaf_key
+void BTree::insert_leaf_key(Node *x, int i, int k)
+{
+    ClrsInsert<BTree>::insert_leaf_key(*this, x, i, k);
+}
+
+// split the full child x->c[i] around its median key, see ClrsInsert::split_child
+void BTree::split_child(Node *x, int i)
+{
+    ClrsInsert<BTree>::split_child(*this, x, i);
+}
+
+template struct ClrsInsert<BTree>;
+template struct ClrsInsert<PagedBTree>;
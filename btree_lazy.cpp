@@ -0,0 +1,89 @@
+#include "btree.h"
+#include <algorithm>
+
+/*
+NOTE: Lazy remove. With set_lazy_remove(true), remove(k) only checks that k is in the tree and records it as a
+tombstone, so a remove never borrows, merges or frees nodes. Reads skip tombstones: contains, lookup_many and
+cursors treat them as absent, insert(k) of a tombstoned key just clears the mark. compact(budget) takes up to
+budget tombstones and removes them with one remove_many batch, which restores the minimum occupancy with the
+same borrow/merge helpers, so the work per call is bounded by the budget. Buffered messages stay where they are,
+a tombstone with a pending message for its key is dropped instead, the message is newer and decides.
+The tombstones live in one hash set per tree rather than as flag bits in the nodes: every helper that moves
+keys between nodes (split, borrow, merge, snapshot copies, images) would otherwise have to carry the bits.
+Operations that hand the node structure out (snapshot, dump, save_image) compact every tombstone first.
+BTree has a single writer: compaction on a background thread must hold the same lock as every other call.
+*/
+
+// mark k removed without touching the nodes
+// Precondition: lazy remove is on, the tree is materialized
+// Postcondition: contains(k) is false, k stays in its node until compact() reaches it
+
+void BTree::remove_lazy(int k)
+{
+    Node *x = root;
+    while (x != nullptr)
+    {
+        int i = find_k(x, k);
+        if (i < x->n && x->keys[i] == k)
+        {
+            tombstones.insert(k); // no-op if k is marked already
+            return;
+        }
+        x = x->leaf ? nullptr : x->c[i];
+    }
+}
+
+// Helper: true if a buffered message for k waits in one of the levels
+static bool has_message(const std::vector<MessageLevel> &messages, int k)
+{
+    for (const MessageLevel &level : messages)
+    {
+        if (level.count(k))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// physically remove up to budget tombstones in one batch
+// Precondition: None
+// Postcondition: returns how many tombstones are left, the tree satisfies every B-tree invariant again for the removed
+//                keys, at most budget tombstones are looked at and no buffered message is applied
+
+size_t BTree::compact(size_t budget)
+{
+    if (tombstones.empty() || budget == 0)
+    {
+        return tombstones.size();
+    }
+    std::vector<int> batch;
+    batch.reserve(std::min(budget, tombstones.size()));
+    size_t taken = 0;
+    auto it = tombstones.begin();
+    while (it != tombstones.end() && taken++ < budget)
+    {
+        // A buffered update of the key is newer than the tombstone and decides on its own: an insert keeps the key,
+        // a remove takes it out of its node once it is applied. Either way the mark just goes.
+        if (messages.empty() || !has_message(messages, *it))
+        {
+            batch.push_back(*it);
+        }
+        it = tombstones.erase(it);
+    }
+    if (batch.empty() || !root)
+    {
+        return tombstones.size();
+    }
+
+    // remove_many(span) would apply every pending message first, the recursive one leaves them in their buffers
+    std::sort(batch.begin(), batch.end());
+    own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+    remove_many(root, batch.data(), batch.data() + batch.size()); // btree_delete_batch.cpp
+    collapse_root();
+    if (!messages.empty())
+    {
+        settle_messages(); // the root may have lost levels
+    }
+    return tombstones.size();
+}
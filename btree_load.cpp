@@ -0,0 +1,460 @@
+#include "btree.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+
+/*
+NOTE: Streaming loader for the level-order text format:
+    line 1: minimum degree t
+    line 2: the root, keys separated by ','
+    line i: every node of level i-1, left to right, nodes separated by '-'
+The file is read in fixed-size chunks. Each chunk is cut after its last separator and tokenized with
+std::from_chars, split across threads when it is large. Tokens are then applied in order: every node
+is linked to its parent as soon as it is parsed, so only the previous level's node pointers are kept.
+Malformed input is reported with the byte offset of the offending character.
+*/
+
+static const size_t LOAD_CHUNK = size_t(4) << 20;        // bytes read per chunk
+static const size_t PARALLEL_MIN_BYTES = size_t(1) << 20; // smaller chunks are tokenized on one thread
+
+namespace
+{
+    enum TokenKind : uint8_t
+    {
+        KEY,       // a key of the current node
+        NODE_END,  // '-', the current node is complete
+        LEVEL_END, // '\n' or end of file, the current level is complete
+    };
+
+    struct Token
+    {
+        uint64_t offset; // byte offset in the file
+        int value;
+        TokenKind kind;
+    };
+
+    struct LoadError
+    {
+        uint64_t offset = 0;
+        std::string problem; // empty if there is no error
+
+        void set(uint64_t at, const std::string &what)
+        {
+            if (problem.empty())
+            {
+                offset = at;
+                problem = what;
+            }
+        }
+    };
+
+    // Links tokens into a tree one node at a time, keeping only the previous and current level
+    struct LevelLinker
+    {
+        int t;
+        NodePool &pool;
+        Node *&root;
+        std::vector<Node *> parents; // previous level
+        std::vector<Node *> level;   // nodes of the current level parsed so far
+        std::vector<Node **> parent_slots; // where each node of parents is linked from (root or a child pointer)
+        std::vector<Node **> level_slots;
+        size_t parent_i = 0;         // parent that receives the next node
+        int child_i = 0;             // child slot in that parent
+        Node *node = nullptr;        // node being filled
+        int depth = 0;               // current level, root is 0
+
+        LevelLinker(int t, NodePool &pool, Node *&root) : t(t), pool(pool), root(root) {}
+
+        void key(const Token &tok, LoadError &err)
+        {
+            if (!node)
+            {
+                node = pool.alloc();
+            }
+            if (node->n == 2 * t - 1)
+            {
+                err.set(tok.offset, "node has more than 2t-1 = " + std::to_string(2 * t - 1) + " keys");
+                return;
+            }
+            if (node->n > 0 && node->keys[node->n - 1] >= tok.value)
+            {
+                err.set(tok.offset, "keys in a node must be strictly increasing");
+                return;
+            }
+            node->keys[node->n++] = tok.value;
+        }
+
+        // nodes are parsed as leaves, a node whose first child shows up moves its keys into an internal block
+        Node *promote(size_t i)
+        {
+            Node *leaf = parents[i];
+            Node *x = pool.alloc(false);
+            std::copy(leaf->keys, leaf->keys + leaf->n, x->keys);
+            x->n = leaf->n;
+            pool.free(leaf);
+            parents[i] = x;
+            *parent_slots[i] = x;
+            return x;
+        }
+
+        void end_node(const Token &tok, LoadError &err)
+        {
+            if (!node)
+            {
+                err.set(tok.offset, "empty node");
+                return;
+            }
+            if (depth == 0)
+            {
+                if (!level.empty())
+                {
+                    err.set(tok.offset, "the root level must hold exactly one node");
+                    return;
+                }
+                root = node;
+                level_slots.push_back(&root);
+            }
+            else
+            {
+                if (parent_i == parents.size())
+                {
+                    err.set(tok.offset, "level " + std::to_string(depth) + " has more nodes than its parents have children");
+                    return;
+                }
+                Node *parent = parents[parent_i];
+                if (parent->leaf)
+                {
+                    parent = promote(parent_i);
+                }
+                parent->c[child_i] = node;
+                level_slots.push_back(&parent->c[child_i]);
+                if (++child_i > parent->n)
+                {
+                    parent_i++;
+                    child_i = 0;
+                }
+            }
+            level.push_back(node);
+            node = nullptr;
+        }
+
+        void end_level(const Token &tok, LoadError &err)
+        {
+            if (!node && level.empty())
+            {
+                return; // blank line
+            }
+            end_node(tok, err);
+            if (!err.problem.empty())
+            {
+                return;
+            }
+            if (parent_i != parents.size())
+            {
+                err.set(tok.offset, "level " + std::to_string(depth) + " has fewer nodes than its parents have children");
+                return;
+            }
+            parents.swap(level);
+            parent_slots.swap(level_slots);
+            level.clear();
+            level_slots.clear();
+            parent_i = 0;
+            child_i = 0;
+            depth++;
+        }
+
+        void apply(const std::vector<Token> &tokens, LoadError &err)
+        {
+            for (const Token &tok : tokens)
+            {
+                if (tok.kind == KEY)
+                    key(tok, err);
+                else if (tok.kind == NODE_END)
+                    end_node(tok, err);
+                else
+                    end_level(tok, err);
+                if (!err.problem.empty())
+                {
+                    return;
+                }
+            }
+        }
+    };
+}
+
+// Helper: true for the characters that end a key
+static bool is_separator(char ch)
+{
+    return ch == ',' || ch == '-' || ch == '\n';
+}
+
+// tokenize the bytes [begin, end), which start right after a separator (or at the first level) and end right after one
+// Precondition: after is the separator just before begin ('\n' at the first level)
+// Postcondition: tokens holds one token per key, '-' and '\n' in order, err is set at the first malformed byte
+
+static void tokenize(const char *begin, const char *end, uint64_t base, char after, std::vector<Token> &tokens, LoadError &err)
+{
+    const char *p = begin;
+    bool want_key = after != '\n'; // after ',' or '-' a key must follow, after '\n' a blank line is fine
+    while (p < end)
+    {
+        char ch = *p;
+        if (ch == ' ' || ch == '\t' || ch == '\r')
+        {
+            p++;
+            continue;
+        }
+        uint64_t at = base + (p - begin);
+        if (ch >= '0' && ch <= '9')
+        {
+            int value;
+            std::from_chars_result res = std::from_chars(p, end, value);
+            if (res.ec == std::errc::result_out_of_range)
+            {
+                err.set(at, "key does not fit in an int");
+                return;
+            }
+            tokens.push_back({at, value, KEY});
+            p = res.ptr;
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            {
+                p++;
+            }
+            if (p < end && !is_separator(*p))
+            {
+                err.set(base + (p - begin), std::string("unexpected character '") + *p + "' after a key");
+                return;
+            }
+            want_key = false;
+            continue;
+        }
+        if (!is_separator(ch))
+        {
+            err.set(at, std::string("unexpected character '") + ch + "'");
+            return;
+        }
+        if (ch == ',' && (want_key || tokens.empty() || tokens.back().kind != KEY))
+        {
+            err.set(at, "empty key");
+            return;
+        }
+        if (ch == '-' && (want_key || tokens.empty() || tokens.back().kind != KEY))
+        {
+            err.set(at, "empty node");
+            return;
+        }
+        if (ch == '\n' && want_key)
+        {
+            err.set(at, "line ends without a key");
+            return;
+        }
+        if (ch == '-')
+            tokens.push_back({at, 0, NODE_END});
+        else if (ch == '\n')
+            tokens.push_back({at, 0, LEVEL_END});
+        want_key = ch != '\n';
+        p++;
+    }
+}
+
+// tokenize [begin, end) on up to `threads` threads, cutting it only right after separators
+// Precondition: same as tokenize
+// Postcondition: tokens holds the tokens of the whole range in order, err is the first error in file order
+
+static void tokenize_parallel(const char *begin, const char *end, uint64_t base, char after, unsigned threads,
+                              std::vector<Token> &tokens, LoadError &err)
+{
+    size_t bytes = end - begin;
+    if (threads <= 1 || bytes < PARALLEL_MIN_BYTES)
+    {
+        tokenize(begin, end, base, after, tokens, err);
+        return;
+    }
+
+    // piece j is [cuts[j], cuts[j+1]), every cut sits right after a separator
+    std::vector<const char *> cuts = {begin};
+    for (unsigned j = 1; j < threads; j++)
+    {
+        const char *p = begin + bytes * j / threads;
+        if (p <= cuts.back())
+        {
+            continue;
+        }
+        while (p < end && !is_separator(p[-1]))
+        {
+            p++;
+        }
+        if (p < end)
+        {
+            cuts.push_back(p);
+        }
+    }
+    cuts.push_back(end);
+
+    size_t pieces = cuts.size() - 1;
+    std::vector<std::vector<Token>> piece_tokens(pieces);
+    std::vector<LoadError> piece_errors(pieces);
+    std::vector<std::thread> workers;
+    for (size_t j = 0; j < pieces; j++)
+    {
+        char piece_after = j == 0 ? after : cuts[j][-1];
+        uint64_t piece_base = base + (cuts[j] - begin);
+        workers.emplace_back(tokenize, cuts[j], cuts[j + 1], piece_base, piece_after,
+                             std::ref(piece_tokens[j]), std::ref(piece_errors[j]));
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+
+    for (size_t j = 0; j < pieces; j++)
+    {
+        if (!piece_errors[j].problem.empty())
+        {
+            err.set(piece_errors[j].offset, piece_errors[j].problem);
+            return;
+        }
+        tokens.insert(tokens.end(), piece_tokens[j].begin(), piece_tokens[j].end());
+    }
+}
+
+// build the tree described by the level-order text file filename
+// Precondition: None
+// Postcondition: returns true and the tree holds the file's nodes, or prints the byte offset and reason of the first
+//                formatting error, leaves the tree empty and returns false
+
+bool BTree::build_tree(const std::string &filename, unsigned threads)
+{
+    close_image();
+    root = nullptr;
+    tombstones.clear();
+    messages.clear();
+    buffered_height = -1;
+    pool.release();
+
+    std::FILE *in = std::fopen(filename.c_str(), "rb");
+    if (!in)
+    {
+        std::cerr << "Error: cannot open file " << filename << "\n";
+        return false;
+    }
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<char> buf(LOAD_CHUNK);
+    size_t have = 0;   // bytes in buf
+    uint64_t base = 0; // file offset of buf[0]
+    bool eof = false;
+    LoadError err;
+    std::vector<Token> tokens;
+    std::unique_ptr<LevelLinker> linker;
+    char after = '\n'; // separator right before buf[0]
+
+    while (err.problem.empty() && (!eof || have > 0))
+    {
+        if (!eof)
+        {
+            size_t got = std::fread(buf.data() + have, 1, buf.size() - have, in);
+            have += got;
+            eof = got == 0 || have < buf.size();
+        }
+
+        // First line: min degree
+        if (!linker)
+        {
+            char *nl = static_cast<char *>(std::memchr(buf.data(), '\n', have));
+            if (!nl && !eof)
+            {
+                err.set(0, "first line (the minimum degree) is too long");
+                break;
+            }
+            char *line_end = nl ? nl : buf.data() + have;
+            const char *p = buf.data();
+            while (p < line_end && (*p == ' ' || *p == '\t'))
+                p++;
+            int degree = 0;
+            std::from_chars_result res = std::from_chars(p, static_cast<const char *>(line_end), degree);
+            const char *rest = res.ptr;
+            while (rest < line_end && (*rest == ' ' || *rest == '\t' || *rest == '\r'))
+                rest++;
+            if (res.ec != std::errc() || rest != line_end)
+            {
+                err.set(res.ec != std::errc() ? p - buf.data() : rest - buf.data(), "first line must be the minimum degree");
+                break;
+            }
+            if (degree < 2)
+            {
+                err.set(p - buf.data(), "minimum degree must be at least 2");
+                break;
+            }
+            t = degree;
+            pool.reset(t);
+            linker.reset(new LevelLinker(t, pool, root));
+
+            size_t used = nl ? nl + 1 - buf.data() : have;
+            std::memmove(buf.data(), buf.data() + used, have - used);
+            have -= used;
+            base += used;
+            continue;
+        }
+
+        // Tokenize up to the last separator, the partial key after it waits for the next chunk
+        size_t cut = have;
+        if (!eof)
+        {
+            while (cut > 0 && !is_separator(buf[cut - 1]))
+            {
+                cut--;
+            }
+            if (cut == 0)
+            {
+                err.set(base, "key is longer than the read buffer");
+                break;
+            }
+        }
+
+        tokens.clear();
+        tokenize_parallel(buf.data(), buf.data() + cut, base, after, threads, tokens, err);
+        if (eof && cut == have && err.problem.empty())
+        {
+            tokens.push_back({base + cut, 0, LEVEL_END}); // last level has no '\n'
+            if (cut > 0 && (buf[cut - 1] == ',' || buf[cut - 1] == '-'))
+            {
+                err.set(base + cut - 1, "file ends right after a separator");
+            }
+        }
+        if (err.problem.empty())
+        {
+            linker->apply(tokens, err);
+        }
+
+        if (cut > 0)
+        {
+            after = buf[cut - 1];
+        }
+        std::memmove(buf.data(), buf.data() + cut, have - cut);
+        have -= cut;
+        base += cut;
+        if (eof && have == 0)
+        {
+            break;
+        }
+    }
+    std::fclose(in);
+
+    if (!err.problem.empty())
+    {
+        std::cerr << "Error: " << filename << ": byte " << err.offset << ": " << err.problem << "\n";
+        root = nullptr;
+        pool.release();
+        return false;
+    }
+    fill_loaded(); // btree_relaxed.cpp, the file may come from a tree with a relaxed delete policy
+    return true;
+}
@@ -0,0 +1,166 @@
+#include "btree.h"
+#include <algorithm>
+
+/*
+NOTE: Order statistics. With set_order_stats(true) every internal node keeps, next to each child pointer, the
+number of keys in the subtree under that child (Node::counts). Insert and remove add or subtract one along
+their path once they know the key was new or was found, and every helper that moves keys or children
+between nodes (split_child, merge_left/right, swap_left/right, remove_internal_key) moves or fixes the
+counts of the nodes it touches, so no update ever walks a subtree. rank, select and count_range then read
+O(t) counts per level instead of visiting the keys. Tombstones are counted like live keys, so these calls
+compact every tombstone first.
+*/
+
+// return the number of keys in the subtree rooted at x from the counts of x
+// Precondition: the tree keeps order statistics and the counts of x are exact
+// Postcondition: the subtree is unchanged, O(t)
+
+size_t BTree::subtree_size(Node *x) const
+{
+    size_t keys = x->n;
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            keys += x->counts[i];
+        }
+    }
+    return keys;
+}
+
+// set every count of x from the counts of its children
+// Precondition: the counts of every child of x are exact
+// Postcondition: the counts of x are exact, nothing happens without order statistics
+
+void BTree::recount(Node *x)
+{
+    if (!order_stats || x->leaf)
+    {
+        return;
+    }
+    for (int i = 0; i <= x->n; i++)
+    {
+        x->counts[i] = subtree_size(x->c[i]);
+    }
+}
+
+// copy the subtree rooted at x into nodes of the pool into, with counts if that pool has them
+// Precondition: x is not nullptr
+// Postcondition: returns the root of a copy with the same keys and shape, the subtree at x is unchanged
+
+Node *BTree::clone(Node *x, NodePool &into)
+{
+    Node *copy = into.alloc(x->leaf);
+    copy->n = x->n;
+    std::copy(x->keys, x->keys + x->n, copy->keys);
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            copy->c[i] = clone(x->c[i], into);
+            if (copy->counts)
+            {
+                copy->counts[i] = subtree_size(copy->c[i]);
+            }
+        }
+    }
+    return copy;
+}
+
+// turn the per-child subtree counts on or off
+// Precondition: None
+// Postcondition: the tree holds the same keys in the same shape, in nodes with counts if on is true
+
+void BTree::set_order_stats(bool on)
+{
+    if (on == order_stats || t < 2)
+    {
+        return;
+    }
+    compact(tombstones.size());
+    if (!root)
+    {
+        // nothing to copy, a mapped image gets its counts when it is materialized
+        order_stats = on;
+        pool.reset(t, on);
+        return;
+    }
+
+    NodePool counted;
+    counted.reset(t, on);
+    Node *copy = clone(root, counted);
+    pool.swap(counted); // the old nodes go with counted, snapshots that share them keep their slabs alive
+    root = copy;
+    order_stats = on;
+}
+
+// return the number of keys smaller than k
+// Precondition: the tree keeps order statistics
+// Postcondition: O(t log n), the tree only changes if tombstones had to be compacted
+
+size_t BTree::rank(int k)
+{
+    materialize();
+    if (!order_stats)
+    {
+        std::cerr << "Error: rank needs order statistics, see set_order_stats\n";
+        return 0;
+    }
+    compact(tombstones.size());
+    flush_messages();
+
+    size_t smaller = 0;
+    Node *x = root;
+    while (x != nullptr)
+    {
+        int i = find_k(x, k);
+        smaller += i; // keys 0 .. i-1 of x
+        if (x->leaf)
+        {
+            break;
+        }
+        for (int j = 0; j < i; j++)
+        {
+            smaller += x->counts[j];
+        }
+        if (i < x->n && x->keys[i] == k)
+        {
+            smaller += x->counts[i]; // everything under c[i] is below k
+            break;
+        }
+        x = x->c[i];
+    }
+    return smaller;
+}
+
+// return an iterator on the key with exactly i smaller keys
+// Precondition: the tree keeps order statistics
+// Postcondition: returns end() if the tree holds i keys or fewer, O(t log n)
+
+BTree::iterator BTree::select(size_t i)
+{
+    materialize();
+    if (!order_stats)
+    {
+        std::cerr << "Error: select needs order statistics, see set_order_stats\n";
+        return end();
+    }
+    compact(tombstones.size());
+    flush_messages();
+    Cursor cur(*this);
+    cur.seek_rank(i);
+    return iterator(cur);
+}
+
+// return the number of keys k with lo <= k < hi
+// Precondition: the tree keeps order statistics
+// Postcondition: returns 0 if lo >= hi, O(t log n)
+
+size_t BTree::count_range(int lo, int hi)
+{
+    if (lo >= hi)
+    {
+        return 0;
+    }
+    return rank(hi) - rank(lo);
+}
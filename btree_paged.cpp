@@ -0,0 +1,587 @@
+#include "btree_paged.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <queue>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char PAGED_MAGIC[8] = {'B', 'T', 'R', 'E', 'E', 'P', 'G', 'D'};
+static const uint32_t PAGED_VERSION = 1;
+static const uint32_t PAGED_BYTE_ORDER = 0x01020304;
+static const size_t PAGE_ALIGN = 4096;
+
+// Helper: round n up to a multiple of a
+static size_t round_up(size_t n, size_t a)
+{
+    return (n + a - 1) / a * a;
+}
+
+// Helper: offset of the child page numbers in a page, after int32 n, int32 leaf and 2t-1 int32 keys
+static size_t children_offset(int t)
+{
+    return round_up(8 + sizeof(int32_t) * (2 * t - 1), sizeof(PageId));
+}
+
+// Helper: bytes one node needs, a page is this rounded up to PAGE_ALIGN
+static size_t node_bytes(int t)
+{
+    return children_offset(t) + sizeof(PageId) * 2 * t;
+}
+
+// Helper: read or write exactly len bytes at offset, retrying short transfers
+static bool transfer(int fd, char *buf, size_t len, off_t offset, bool write)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t got = write ? ::pwrite(fd, buf + done, len - done, offset + done)
+                            : ::pread(fd, buf + done, len - done, offset + done);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        done += got;
+    }
+    return true;
+}
+
+PageRef &PageRef::operator=(PageRef &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        pool = other.pool;
+        frame = other.frame;
+        other.frame = nullptr;
+    }
+    return *this;
+}
+
+// unpin the page, the PageRef is empty afterwards
+void PageRef::release()
+{
+    if (frame)
+    {
+        pool->unpin(frame);
+        frame = nullptr;
+    }
+}
+
+BufferPool::BufferPool(int fd, int t, size_t page_bytes, size_t capacity)
+    : fd(fd), t(t), page_bytes(page_bytes), capacity(std::max<size_t>(capacity, 1)), failed(false)
+{
+    lru.lru_prev = lru.lru_next = &lru;
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto &f : frames)
+    {
+        ::operator delete(f->data, std::align_val_t(PAGE_ALIGN));
+    }
+}
+
+// Helper: drop f from the list of unpinned frames
+void BufferPool::lru_unlink(PageFrame *f)
+{
+    f->lru_prev->lru_next = f->lru_next;
+    f->lru_next->lru_prev = f->lru_prev;
+    f->lru_prev = f->lru_next = nullptr;
+}
+
+// Helper: f is the most recently used unpinned frame
+void BufferPool::lru_append(PageFrame *f)
+{
+    f->lru_prev = lru.lru_prev;
+    f->lru_next = &lru;
+    lru.lru_prev->lru_next = f;
+    lru.lru_prev = f;
+}
+
+// return a frame that holds no page
+// Precondition: None
+// Postcondition: a new frame while the pool is below capacity, else the least recently used unpinned frame,
+//                written back if dirty. If every frame is pinned the pool grows by one frame instead of failing.
+
+PageFrame *BufferPool::take_frame()
+{
+    PageFrame *f;
+    if (frames.size() >= capacity && lru.lru_next != &lru)
+    {
+        f = lru.lru_next;
+        lru_unlink(f);
+        if (f->dirty)
+        {
+            write_back(f);
+        }
+        table.erase(f->id);
+        counters.evictions++;
+    }
+    else
+    {
+        frames.emplace_back(new PageFrame);
+        f = frames.back().get();
+        f->data = static_cast<char *>(::operator new(page_bytes, std::align_val_t(PAGE_ALIGN)));
+        std::memset(f->data, 0, page_bytes);
+    }
+    f->node.keys = reinterpret_cast<int *>(f->data + 8);
+    f->node.c = reinterpret_cast<PageId *>(f->data + children_offset(t));
+    f->dirty = false;
+    f->pins = 0;
+    return f;
+}
+
+// write the page in f to its place in the file
+// Precondition: f holds a page
+// Postcondition: returns true and f is clean, or returns false and the pool reports the failure from ok()
+
+bool BufferPool::write_back(PageFrame *f)
+{
+    int32_t head[2] = {f->node.n, f->node.leaf ? 1 : 0};
+    std::memcpy(f->data, head, sizeof(head));
+    if (!transfer(fd, f->data, page_bytes, f->id * page_bytes, true))
+    {
+        std::cerr << "Error: cannot write page " << f->id << "\n";
+        failed = true;
+        return false;
+    }
+    counters.writes++;
+    f->dirty = false;
+    return true;
+}
+
+// pin page id, reading it from the file unless a frame already holds it
+// Precondition: None
+// Postcondition: returns a PageRef on the page, the frame is not evicted while it is pinned. Returns an empty PageRef
+//                and the pool reports the failure from ok() if id is the header page or the page cannot be read.
+
+PageRef BufferPool::pin(PageId id)
+{
+    if (id == 0)
+    {
+        std::cerr << "Error: a node links to the header page\n";
+        failed = true;
+        return PageRef();
+    }
+    auto it = table.find(id);
+    if (it != table.end())
+    {
+        PageFrame *f = it->second;
+        if (f->pins++ == 0)
+        {
+            lru_unlink(f);
+        }
+        counters.hits++;
+        return PageRef(this, f);
+    }
+
+    counters.misses++;
+    PageFrame *f = take_frame();
+    f->id = id;
+    if (!transfer(fd, f->data, page_bytes, id * page_bytes, false))
+    {
+        std::cerr << "Error: cannot read page " << id << "\n";
+        failed = true;
+        f->id = 0; // the frame holds no page, it goes back to the unpinned list
+        lru_append(f);
+        return PageRef();
+    }
+    counters.reads++;
+    int32_t head[2];
+    std::memcpy(head, f->data, sizeof(head));
+    f->node.n = std::clamp<int32_t>(head[0], 0, 2 * t - 1);
+    f->node.leaf = head[1] != 0;
+    f->pins = 1;
+    table[id] = f;
+    return PageRef(this, f);
+}
+
+// pin a page that is not in the file yet, without reading it
+// Precondition: id is past the last page written so far
+// Postcondition: returns a PageRef on an empty, dirty node with the given leaf flag and no children
+
+PageRef BufferPool::pin_new(PageId id, bool leaf)
+{
+    PageFrame *f = take_frame();
+    f->id = id;
+    f->node.n = 0;
+    f->node.leaf = leaf;
+    std::fill(f->node.c, f->node.c + 2 * t, 0);
+    f->pins = 1;
+    f->dirty = true;
+    table[id] = f;
+    return PageRef(this, f);
+}
+
+// drop one pin of f, an unpinned frame becomes the most recently used one
+// Precondition: f is pinned
+// Postcondition: a frame the pool only had to add because every frame was pinned is written back and freed
+
+void BufferPool::unpin(PageFrame *f)
+{
+    if (--f->pins > 0)
+    {
+        return;
+    }
+    if (frames.size() <= capacity)
+    {
+        lru_append(f);
+        return;
+    }
+    if (f->dirty)
+    {
+        write_back(f);
+    }
+    table.erase(f->id);
+    auto it = std::find_if(frames.begin(), frames.end(), [f](const std::unique_ptr<PageFrame> &p) { return p.get() == f; });
+    ::operator delete(f->data, std::align_val_t(PAGE_ALIGN));
+    frames.erase(it);
+}
+
+// write back every dirty page
+// Precondition: None
+// Postcondition: returns true if every write succeeded, the cached pages stay in their frames. Once the pool failed
+//                nothing is written, its pages may hold an operation that stopped halfway.
+
+bool BufferPool::flush()
+{
+    if (failed)
+    {
+        return false;
+    }
+    for (auto &f : frames)
+    {
+        if (f->dirty && f->id != 0)
+        {
+            write_back(f.get());
+        }
+    }
+    return !failed;
+}
+
+// return the counters with the current frame count
+BufferPoolStats BufferPool::stats() const
+{
+    BufferPoolStats s = counters;
+    s.frames = frames.size();
+    s.capacity = capacity;
+    return s;
+}
+
+// zero the hit, miss and I/O counters
+void BufferPool::reset_stats()
+{
+    counters = BufferPoolStats();
+}
+
+// print the counters one per line
+void BufferPoolStats::print(std::ostream &out) const
+{
+    out << "hits " << hits << "\n"
+        << "misses " << misses << "\n"
+        << "hit_ratio " << (hits + misses ? double(hits) / double(hits + misses) : 0.0) << "\n"
+        << "reads " << reads << "\n"
+        << "writes " << writes << "\n"
+        << "evictions " << evictions << "\n"
+        << "frames " << frames << "/" << capacity << "\n";
+}
+
+PagedBTree::PagedBTree(const std::string &filename, int t, size_t pool_pages) : fd(-1), t(t), header()
+{
+    open_file(filename, t, pool_pages);
+}
+
+// flush and close the file
+PagedBTree::~PagedBTree()
+{
+    if (is_open())
+    {
+        flush();
+    }
+    pool.reset();
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+// open the tree in filename or create it
+// Precondition: None
+// Postcondition: returns true and is_open() if filename holds a paged tree (its degree wins over t) or was created
+//                as an empty one of degree t, else reports the problem, returns false and every operation does nothing
+
+bool PagedBTree::open_file(const std::string &filename, int t, size_t pool_pages)
+{
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Error: cannot open file " << filename << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::cerr << "Error: cannot stat " << filename << "\n";
+        return false;
+    }
+
+    if (st.st_size == 0)
+    {
+        if (t < 2)
+        {
+            std::cerr << "Error: minimum degree must be at least 2, got " << t << "\n";
+            return false;
+        }
+        std::memcpy(header.magic, PAGED_MAGIC, sizeof(PAGED_MAGIC));
+        header.version = PAGED_VERSION;
+        header.byte_order = PAGED_BYTE_ORDER;
+        header.degree = t;
+        header.page_bytes = round_up(std::max(node_bytes(t), sizeof(PagedHeader)), PAGE_ALIGN);
+        header.root = 0;
+        header.page_count = 1;
+        header.free_head = 0;
+        this->t = t;
+        pool.reset(new BufferPool(fd, t, header.page_bytes, pool_pages));
+        return write_header();
+    }
+
+    std::string problem;
+    if (!transfer(fd, reinterpret_cast<char *>(&header), sizeof(header), 0, false))
+        problem = "file is too short";
+    else if (std::memcmp(header.magic, PAGED_MAGIC, sizeof(PAGED_MAGIC)) != 0)
+        problem = "not a paged tree";
+    else if (header.version != PAGED_VERSION)
+        problem = "unsupported version";
+    else if (header.byte_order != PAGED_BYTE_ORDER)
+        problem = "written on a machine with a different byte order";
+    else if (header.degree < 2 || header.page_bytes < node_bytes(header.degree))
+        problem = "bad degree or page size";
+    else if ((uint64_t)st.st_size < header.page_count * header.page_bytes)
+        problem = "file is shorter than its page count";
+    if (!problem.empty())
+    {
+        std::cerr << "Error: " << filename << ": " << problem << "\n";
+        return false;
+    }
+    this->t = header.degree;
+    pool.reset(new BufferPool(fd, this->t, header.page_bytes, pool_pages));
+    return true;
+}
+
+// write the header into page 0
+bool PagedBTree::write_header()
+{
+    std::vector<char> page(header.page_bytes, 0);
+    std::memcpy(page.data(), &header, sizeof(header));
+    if (!transfer(fd, page.data(), page.size(), 0, true))
+    {
+        std::cerr << "Error: cannot write the header page\n";
+        return false;
+    }
+    return true;
+}
+
+// write every dirty page and the header, then sync the file
+// Precondition: None
+// Postcondition: returns true if the file now holds the whole tree
+
+bool PagedBTree::flush()
+{
+    if (!pool)
+    {
+        return false;
+    }
+    bool ok = pool->flush() && write_header();
+    return ::fsync(fd) == 0 && ok;
+}
+
+// largest minimum degree whose node fits in page_bytes
+int PagedBTree::degree_for_page(size_t page_bytes)
+{
+    int t = 2;
+    while (node_bytes(t + 1) <= page_bytes)
+    {
+        t++;
+    }
+    return t;
+}
+
+// take a page for a new node, from the free list if there is one
+// Precondition: the tree is open
+// Postcondition: returns a pinned, dirty, empty node with the given leaf flag, or an empty PageRef if the free
+//                page cannot be read
+
+PageRef PagedBTree::alloc_page(bool leaf)
+{
+    if (header.free_head == 0)
+    {
+        return pool->pin_new(header.page_count++, leaf);
+    }
+    PageRef x = pin(header.free_head);
+    if (!x)
+    {
+        return x;
+    }
+    header.free_head = x->c[0];
+    x.mark_dirty();
+    x->n = 0;
+    x->leaf = leaf;
+    std::fill(x->c, x->c + 2 * t, 0);
+    return x;
+}
+
+// give the page of x back, it goes on the free list
+// Precondition: no node links to x anymore
+// Postcondition: x is an empty page that links to the previous head of the free list
+
+void PagedBTree::free_page(PageRef &x)
+{
+    x.mark_dirty();
+    x->n = 0;
+    x->leaf = true;
+    x->c[0] = header.free_head;
+    header.free_head = x.id();
+}
+
+// insert the key k into the tree
+// Precondition: None (handles empty tree case)
+// Postcondition: Key k is in the tree (inserting a key that already exists does nothing)
+
+void PagedBTree::insert(int k)
+{
+    if (!is_open())
+    {
+        return;
+    }
+    if (header.root == 0)
+    {
+        PageRef root = alloc_page(true);
+        root->keys[0] = k;
+        root->n = 1;
+        header.root = root.id();
+        return;
+    }
+
+    // Full root: grow a new empty root above it and split the old root into two children
+    PageRef root = pin(header.root);
+    if (!root)
+    {
+        return;
+    }
+    if (root->n == 2 * t - 1)
+    {
+        PageRef new_root = alloc_page(false);
+        if (!new_root)
+        {
+            return;
+        }
+        new_root->c[0] = header.root;
+        header.root = new_root.id();
+        root.release();
+        ClrsInsert<PagedBTree>::split_child(*this, new_root, 0);
+        root = std::move(new_root);
+    }
+    ClrsInsert<PagedBTree>::insert(*this, std::move(root), k); // btree_insert.cpp
+}
+
+// return true if key k is in the tree
+bool PagedBTree::contains(int k)
+{
+    if (!is_open() || header.root == 0)
+    {
+        return false;
+    }
+    PageRef x = pin(header.root);
+    while (x)
+    {
+        int i = find_k(x, k);
+        if (i < x->n && x->keys[i] == k)
+        {
+            return true;
+        }
+        if (x->leaf)
+        {
+            return false;
+        }
+        x = pin(x->c[i]);
+    }
+    return false; // a page cannot be read
+}
+
+// delete the key k from the tree
+// Precondition: None (handles empty tree case)
+// Postcondition: Key k is removed if it exists, the tree height decreases if the root becomes empty
+
+void PagedBTree::remove(int k)
+{
+    if (!is_open() || header.root == 0)
+    {
+        return;
+    }
+    ClrsDelete<PagedBTree>::remove(*this, pin(header.root), k); // btree_delete.cpp
+
+    PageRef root = pin(header.root);
+    if (!root)
+    {
+        return;
+    }
+    if (root->n == 0 && !root->leaf)
+    {
+        header.root = root->c[0];
+        free_page(root);
+    }
+    else if (root->n == 0 && root->leaf)
+    {
+        free_page(root);
+        header.root = 0;
+    }
+}
+
+// return the index of the first key in x that is >= k, or x->n if there is none
+int PagedBTree::find_k(const PageRef &x, int k)
+{
+    BTREE_COUNT(NODES_VISITED, 1);
+    BTREE_COUNT(FIND_K_COMPARISONS, node_rank_comparisons(x->n));
+    return node_rank(x->keys, x->n, k);
+}
+
+// print the tree level by level, same format as BTree::print
+void PagedBTree::print(std::ostream &out)
+{
+    if (!is_open() || header.root == 0)
+    {
+        return;
+    }
+    std::queue<PageId> q;
+    q.push(header.root);
+    while (!q.empty())
+    {
+        size_t level_n = q.size();
+        for (size_t i = 0; i < level_n; i++)
+        {
+            PageRef node = pin(q.front());
+            q.pop();
+            if (!node)
+            {
+                return;
+            }
+            for (int j = 0; j < node->n; j++)
+            {
+                out << node->keys[j];
+                if (j < node->n - 1)
+                    out << ",";
+            }
+            if (i < level_n - 1)
+                out << "\t";
+            if (!node->leaf)
+            {
+                for (int j = 0; j <= node->n; j++)
+                    q.push(node->c[j]);
+            }
+        }
+        out << "\n";
+    }
+}
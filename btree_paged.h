@@ -0,0 +1,190 @@
+#ifndef BTREE_PAGED_H
+#define BTREE_PAGED_H
+
+#include "btree.h"
+#include <unordered_map>
+
+/*
+NOTE: Disk-backed BTree. Every node is one fixed-size page of a file and children are page numbers instead of
+pointers. Pages are only touched through a BufferPool: a page is pinned while the algorithm uses it, unpinned
+pages stay cached until they are the least recently used one and their frame is needed for another page, and
+a changed (dirty) page is written back when it is evicted or on flush(). Insert and remove run the CLRSv4
+cases of btree_insert.cpp and btree_delete.cpp themselves (ClrsInsert and ClrsDelete instantiated with a pinned
+PageRef for Node *), so a PagedBTree has the same shape as a BTree of the same degree after the same operations.
+A page that cannot be read pins as an empty PageRef, the operation stops there and the tree is closed.
+There is no write-ahead log: the file is consistent after flush() (the destructor flushes), not after a crash.
+*/
+
+typedef uint64_t PageId; // page 0 holds the file header, so 0 also means "no page"
+
+// Header of a paged tree file, at the start of page 0, in the byte order of the machine that wrote it
+struct PagedHeader
+{
+    char magic[8];       // "BTREEPGD"
+    uint32_t version;    // PAGED_VERSION
+    uint32_t byte_order; // 0x01020304
+    uint32_t degree;     // minimum degree t
+    uint32_t page_bytes;
+    PageId root;         // 0 for an empty tree
+    uint64_t page_count; // pages in the file, header page included
+    PageId free_head;    // first freed page, every freed page links to the next one in c[0]
+};
+
+// A node held in a buffer frame. keys and c point into the page bytes, n and leaf are parsed from the first
+// 8 bytes of the page when it is read and stored back there when it is written.
+struct PagedNode
+{
+    int n;
+    bool leaf;
+    int *keys;
+    PageId *c;
+};
+
+// Buffer pool counters, see PagedBTree::stats()
+struct BufferPoolStats
+{
+    uint64_t hits = 0;      // pins that found the page in a frame
+    uint64_t misses = 0;    // pins that had to read the page
+    uint64_t reads = 0;     // pages read from the file
+    uint64_t writes = 0;    // pages written to the file
+    uint64_t evictions = 0; // frames taken from one page for another
+    size_t frames = 0;      // frames allocated, above capacity only while every frame is pinned
+    size_t capacity = 0;
+    void print(std::ostream &out = std::cout) const;
+};
+
+struct PageFrame
+{
+    PagedNode node;
+    PageId id = 0;
+    int pins = 0;
+    bool dirty = false;
+    char *data = nullptr;
+    PageFrame *lru_prev = nullptr; // links of the list of unpinned frames, least recently used first
+    PageFrame *lru_next = nullptr;
+};
+
+class BufferPool;
+
+// A pinned page, unpinned when the PageRef is released or destroyed
+class PageRef
+{
+private:
+    BufferPool *pool;
+    PageFrame *frame;
+
+public:
+    PageRef() : pool(nullptr), frame(nullptr) {}
+    PageRef(BufferPool *pool, PageFrame *frame) : pool(pool), frame(frame) {}
+    PageRef(PageRef &&other) noexcept : pool(other.pool), frame(other.frame) { other.frame = nullptr; }
+    PageRef &operator=(PageRef &&other) noexcept;
+    PageRef(const PageRef &) = delete;
+    PageRef &operator=(const PageRef &) = delete;
+    ~PageRef() { release(); }
+
+    void release();
+    PagedNode *operator->() const { return &frame->node; }
+    PageId id() const { return frame->id; }
+    explicit operator bool() const { return frame != nullptr; }
+    // every change to the node must be marked, only dirty pages are written back
+    void mark_dirty() { frame->dirty = true; }
+};
+
+// Fixed number of page frames over one file with LRU eviction and write-back
+class BufferPool
+{
+private:
+    int fd;
+    int t;
+    size_t page_bytes;
+    size_t capacity;
+    std::vector<std::unique_ptr<PageFrame>> frames;
+    std::unordered_map<PageId, PageFrame *> table; // page -> frame holding it
+    PageFrame lru;                                 // sentinel of the unpinned frames list
+    BufferPoolStats counters;
+    bool failed;
+
+    PageFrame *take_frame();
+    bool write_back(PageFrame *f);
+    void lru_unlink(PageFrame *f);
+    void lru_append(PageFrame *f);
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+public:
+    BufferPool(int fd, int t, size_t page_bytes, size_t capacity);
+    ~BufferPool();
+    PageRef pin(PageId id);
+    PageRef pin_new(PageId id, bool leaf);
+    void unpin(PageFrame *f);
+    bool flush();
+    bool ok() const { return !failed; }
+    BufferPoolStats stats() const;
+    void reset_stats();
+};
+
+class PagedBTree
+{
+private:
+    int fd;
+    int t; // minimum degree
+    PagedHeader header;
+    std::unique_ptr<BufferPool> pool;
+
+    bool open_file(const std::string &filename, int t, size_t pool_pages);
+    bool write_header();
+    PageRef pin(PageId id) { return pool->pin(id); }
+    PageRef alloc_page(bool leaf);
+    void free_page(PageRef &x);
+
+    int find_k(const PageRef &x, int k);
+
+    // Hooks of ClrsInsert and ClrsDelete: every child is pinned, own and child are the same since a page is
+    // never shared, and a changed page has to be marked dirty
+    typedef PageRef NodeRef;
+    static constexpr bool COUNTED = false;
+    PageRef child(const PageRef &x, int i) { return pin(x->c[i]); }
+    PageRef own(const PageRef &x, int i) { return pin(x->c[i]); }
+    void mark_dirty(PageRef &x) { x.mark_dirty(); }
+    PageRef alloc_node(bool leaf) { return alloc_page(leaf); }
+    void free_node(PageRef &x) { free_page(x); }
+    void set_child(PageRef &x, int i, const PageRef &y) { x->c[i] = y.id(); }
+
+    template <typename Tree>
+    friend struct ClrsInsert;
+    template <typename Tree>
+    friend struct ClrsDelete;
+
+    PagedBTree(const PagedBTree &) = delete;
+    PagedBTree &operator=(const PagedBTree &) = delete;
+
+public:
+    // Open the tree in filename, or create it with minimum degree t if the file does not exist or is empty.
+    // pool_pages is the number of page frames kept in memory.
+    PagedBTree(const std::string &filename, int t, size_t pool_pages = 1024);
+    ~PagedBTree();
+    bool is_open() const { return pool != nullptr && pool->ok(); }
+    int degree() const { return t; }
+    // pages in the file, the header page and freed pages included
+    uint64_t page_count() const { return header.page_count; }
+    // largest minimum degree whose node fits in page_bytes
+    static int degree_for_page(size_t page_bytes);
+
+    void insert(int k);
+    void remove(int k);
+    bool contains(int k);
+    // write every dirty page and the header, then sync the file
+    bool flush();
+    // For debugging, same format as BTree::print
+    void print(std::ostream &out = std::cout);
+
+    BufferPoolStats stats() const { return pool ? pool->stats() : BufferPoolStats(); }
+    void reset_stats()
+    {
+        if (pool)
+            pool->reset_stats();
+    }
+};
+
+#endif
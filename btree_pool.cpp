@@ -0,0 +1,353 @@
+#include "btree.h"
+#include <algorithm>
+#include <new>
+
+/*
+NOTE: One block per node instead of three allocations (node, keys, children).
+Blocks are cut from slabs that double in size, so a tree with n nodes holds O(log n) slabs
+and release() frees the whole tree without visiting a single node.
+Leaves never use child pointers or counts, and with 2t children per node nearly every node is a leaf, so a leaf
+gets a smaller block of just the node and its keys (c and counts are nullptr). Both sizes are cut from the same
+slabs, and each size has its own free list. A node keeps the block it was allocated with: remove_range may turn an
+emptied internal node into a leaf, but a leaf never becomes an internal node (the loaders allocate the right kind).
+split_at and join (btree_split.cpp) move subtrees between trees without copying them, so the nodes of one tree
+can sit in the slabs of another. The two halves of a split keep sharing one arena. join takes the slabs of the
+right tree's arena over when nothing else holds it, otherwise it keeps that arena alive in joined. The node count
+lives in the arena for the same reason: a pool may free a node that another pool handed out.
+*/
+
+static const size_t CACHE_LINE = 64;
+static const size_t FIRST_SLAB_BLOCKS = 64;
+static const size_t MAX_SLAB_BYTES = size_t(16) << 20;
+
+// Helper: round n up to a multiple of a (a is a power of two)
+static size_t round_up(size_t n, size_t a)
+{
+    return (n + a - 1) & ~(a - 1);
+}
+
+NodePool::NodePool()
+    : t(0), with_counts(false), block_bytes{0, 0}, slab_blocks(FIRST_SLAB_BLOCKS), arena(std::make_shared<NodeArena>()), next_block(nullptr),
+      bytes_left(0), free_list{nullptr, nullptr}
+{
+}
+
+NodePool::~NodePool()
+{
+    release();
+}
+
+// switch the pool to blocks for minimum degree t
+// Precondition: t >= 2
+// Postcondition: every node handed out before is released, later alloc() calls return nodes with room for 2t-1 keys,
+//                internal nodes also for 2t children and 2t subtree counts if counts is true
+
+void NodePool::reset(int t, bool counts)
+{
+    release();
+    this->t = t;
+    with_counts = counts;
+    size_t keys_end = sizeof(Node) + sizeof(int) * (2 * t - 1);
+    size_t children_end = round_up(keys_end, alignof(Node *)) + sizeof(Node *) * 2 * t;
+    block_bytes[0] = round_up(children_end + (counts ? sizeof(uint32_t) * 2 * t : 0), CACHE_LINE);
+    block_bytes[1] = round_up(keys_end, CACHE_LINE);
+}
+
+// exchange every node and slab with other
+// Precondition: None
+// Postcondition: nodes handed out by either pool now belong to the other one
+
+void NodePool::swap(NodePool &other)
+{
+    std::swap(t, other.t);
+    std::swap(with_counts, other.with_counts);
+    std::swap(block_bytes, other.block_bytes);
+    std::swap(slab_blocks, other.slab_blocks);
+    std::swap(arena, other.arena);
+    std::swap(next_block, other.next_block);
+    std::swap(bytes_left, other.bytes_left);
+    std::swap(free_list, other.free_list);
+}
+
+// start handing out blocks from the arena of other, whose tree gives this pool's tree some of its nodes
+// Precondition: other has been reset
+// Postcondition: the nodes of this pool are released, both pools allocate blocks of the same size from one arena
+
+void NodePool::share(const NodePool &other)
+{
+    reset(other.t, other.with_counts);
+    arena = other.arena;
+}
+
+// Helper: nodes handed out from arena a and not freed since
+static long long arena_live(const NodeArena &a)
+{
+    return a.live.load(std::memory_order_relaxed) - (long long)a.remote_count.load(std::memory_order_relaxed);
+}
+
+// Helper: true if the memory of a keeps the arena target alive
+static bool holds(NodeArena &a, const NodeArena *target)
+{
+    std::vector<std::shared_ptr<NodeArena>> joined;
+    {
+        std::lock_guard<std::mutex> guard(a.lock);
+        joined = a.joined;
+    }
+    for (const std::shared_ptr<NodeArena> &j : joined)
+    {
+        if (j.get() == target || holds(*j, target))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// take over the nodes of other, which this pool's tree now points to
+// Precondition: both pools hand out blocks of the same size
+// Postcondition: returns false and changes nothing if other's memory already keeps this pool's memory alive (the
+//                caller copies the nodes then), otherwise the nodes of other live as long as this pool's memory
+//                and other starts over with no slabs
+
+bool NodePool::adopt(NodePool &other)
+{
+    if (other.arena != arena)
+    {
+        NodeArena &from = *other.arena;
+        if (other.arena.use_count() == 1)
+        {
+            // nothing else holds the other arena, its slabs and counts move into ours. It may keep our arena alive
+            // itself (a tree of ours joined into its tree earlier), that reference just goes away.
+            for (const std::shared_ptr<NodeArena> &j : from.joined)
+            {
+                if (j != arena && holds(*j, arena.get()))
+                {
+                    return false; // keeping it alive in turn would make a cycle nothing ever frees
+                }
+            }
+            std::lock_guard<std::mutex> guard(arena->lock);
+            arena->slabs.insert(arena->slabs.end(), from.slabs.begin(), from.slabs.end());
+            from.slabs.clear();
+            arena->bytes += from.bytes;
+            for (const std::shared_ptr<NodeArena> &j : from.joined)
+            {
+                if (j != arena)
+                {
+                    arena->joined.push_back(j);
+                }
+            }
+            from.joined.clear();
+            arena->live.fetch_add(arena_live(from), std::memory_order_relaxed);
+            // blocks snapshots gave back before they were dropped go on our free lists
+            for (int kind = 0; kind < 2; kind++)
+            {
+                Node *head = from.remote_free[kind].exchange(nullptr, std::memory_order_acquire);
+                if (head)
+                {
+                    Node *tail = head;
+                    while (*reinterpret_cast<Node **>(tail))
+                    {
+                        tail = *reinterpret_cast<Node **>(tail);
+                    }
+                    *reinterpret_cast<Node **>(tail) = free_list[kind];
+                    free_list[kind] = head;
+                }
+            }
+        }
+        else if (holds(from, arena.get()))
+        {
+            return false; // same cycle
+        }
+        else
+        {
+            std::scoped_lock guard(arena->lock, from.lock);
+            arena->joined.push_back(other.arena);
+        }
+    }
+    // the nodes of other now belong to our tree, other forgets them without releasing anything
+    other.arena = std::make_shared<NodeArena>();
+    other.start_over();
+    return true;
+}
+
+// hand out an empty node
+// Precondition: reset() has been called
+// Postcondition: returns a node with n == 0 and the given leaf flag, an internal node has all 2t child pointers
+//                set to nullptr, a leaf has c == nullptr and counts == nullptr
+
+Node *NodePool::alloc(bool leaf)
+{
+    char *block;
+    Node *&list = free_list[leaf];
+    size_t size = block_bytes[leaf];
+    if (!list && arena->remote_free[leaf].load(std::memory_order_relaxed))
+    {
+        // take back every node snapshots freed since we last looked
+        list = arena->remote_free[leaf].exchange(nullptr, std::memory_order_acquire);
+    }
+    if (!list && bytes_left < size)
+    {
+        std::lock_guard<std::mutex> guard(arena->lock);
+        for (const std::shared_ptr<NodeArena> &j : arena->joined)
+        {
+            // snapshots of a joined tree free into its old arena
+            if (j->remote_free[leaf].load(std::memory_order_relaxed))
+            {
+                list = j->remote_free[leaf].exchange(nullptr, std::memory_order_acquire);
+                break;
+            }
+        }
+        if (!list)
+        {
+            // what is left of the newest slab is too small for this block and stays unused
+            size_t slab_bytes = slab_blocks * block_bytes[0];
+            char *slab = static_cast<char *>(::operator new(slab_bytes, std::align_val_t(CACHE_LINE)));
+            arena->slabs.push_back(slab);
+            arena->bytes += slab_bytes;
+            next_block = slab;
+            bytes_left = slab_bytes;
+            if (slab_bytes * 2 <= MAX_SLAB_BYTES)
+            {
+                slab_blocks *= 2;
+            }
+        }
+    }
+    if (list)
+    {
+        block = reinterpret_cast<char *>(list);
+        list = *reinterpret_cast<Node **>(block);
+    }
+    else
+    {
+        block = next_block;
+        next_block += size;
+        bytes_left -= size;
+    }
+
+    Node *x = reinterpret_cast<Node *>(block);
+    x->keys = reinterpret_cast<int *>(block + sizeof(Node));
+    x->leaf = leaf;
+    x->leaf_block = leaf;
+    x->n = 0;
+    x->refs = 1;
+    if (leaf)
+    {
+        x->c = nullptr;
+        x->counts = nullptr;
+    }
+    else
+    {
+        x->c = reinterpret_cast<Node **>(block + round_up(sizeof(Node) + sizeof(int) * (2 * t - 1), alignof(Node *)));
+        x->counts = with_counts ? reinterpret_cast<uint32_t *>(x->c + 2 * t) : nullptr;
+        std::fill(x->c, x->c + 2 * t, nullptr);
+        if (with_counts)
+        {
+            std::fill(x->counts, x->counts + 2 * t, 0);
+        }
+    }
+    arena->live.fetch_add(1, std::memory_order_relaxed);
+    return x;
+}
+
+// give the block of node x back to the pool
+// Precondition: x was returned by alloc() on this pool and has not been freed since
+// Postcondition: x is on the list list of its block size and must not be used anymore
+
+void NodePool::free(Node *x)
+{
+    if (!x)
+    {
+        return;
+    }
+    BTREE_COUNT(NODES_FREED, 1);
+    *reinterpret_cast<Node **>(x) = free_list[x->leaf_block];
+    free_list[x->leaf_block] = x;
+    arena->live.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// drop every node at once
+// Precondition: None
+// Postcondition: every node handed out by this pool is invalid for the tree, all slabs are freed unless a snapshot
+//                or a tree split from this one still holds them (they are freed with the last of those then),
+//                the pool starts over with no slabs
+
+void NodePool::release()
+{
+    if (arena.use_count() == 1)
+    {
+        for (char *slab : arena->slabs)
+        {
+            ::operator delete(slab, std::align_val_t(CACHE_LINE));
+        }
+        arena->slabs.clear();
+        arena->bytes = 0;
+        arena->joined.clear();
+        arena->live.store(0, std::memory_order_relaxed);
+        arena->remote_free[0].store(nullptr, std::memory_order_relaxed);
+        arena->remote_free[1].store(nullptr, std::memory_order_relaxed);
+        arena->remote_count.store(0, std::memory_order_relaxed);
+    }
+    else
+    {
+        arena = std::make_shared<NodeArena>();
+    }
+    start_over();
+}
+
+// forget the newest slab and the free list, the next alloc() cuts a new slab
+void NodePool::start_over()
+{
+    slab_blocks = FIRST_SLAB_BLOCKS;
+    next_block = nullptr;
+    bytes_left = 0;
+    free_list[0] = nullptr;
+    free_list[1] = nullptr;
+}
+
+// return the number of nodes in use in this pool's memory, with the nodes of trees that share it since a split_at
+// or join (a pool can free a node another pool handed out, only the sum over the memory they share is exact)
+size_t NodePool::live_nodes() const
+{
+    std::lock_guard<std::mutex> guard(arena->lock);
+    long long nodes = arena_live(*arena);
+    for (const std::shared_ptr<NodeArena> &j : arena->joined)
+    {
+        nodes += arena_live(*j);
+    }
+    return nodes > 0 ? (size_t)nodes : 0;
+}
+
+// return the number of bytes held in slabs, used or not, joined arenas included
+size_t NodePool::bytes() const
+{
+    std::lock_guard<std::mutex> guard(arena->lock);
+    size_t total = arena->bytes;
+    for (const std::shared_ptr<NodeArena> &j : arena->joined)
+    {
+        total += j->bytes;
+    }
+    return total;
+}
+
+NodeArena::~NodeArena()
+{
+    for (char *slab : slabs)
+    {
+        ::operator delete(slab, std::align_val_t(CACHE_LINE));
+    }
+}
+
+// give a node back from a thread other than the tree's writer
+// Precondition: no tree or snapshot points to x anymore
+// Postcondition: x is on the remote_free list of its block size, the pool that owns this arena reuses it on a later alloc()
+
+void NodeArena::push_free(Node *x)
+{
+    std::atomic<Node *> &list = remote_free[x->leaf_block];
+    Node *head = list.load(std::memory_order_relaxed);
+    do
+    {
+        *reinterpret_cast<Node **>(x) = head;
+    } while (!list.compare_exchange_weak(head, x, std::memory_order_release, std::memory_order_relaxed));
+    remote_count.fetch_add(1, std::memory_order_relaxed);
+}
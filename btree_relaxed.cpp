@@ -0,0 +1,273 @@
+#include "btree.h"
+#include <algorithm>
+
+/*
+NOTE: Relaxed delete policies. The CLRS remove of btree_delete.cpp makes sure every child it descends into holds
+at least t keys before it gets there, so it borrows and merges on the way down even when the key turns out not
+to be in the tree. Under MinFill and MergeAtEmpty a node only has to keep relaxed_min keys (1 for MergeAtEmpty).
+remove_relaxed goes down without changing anything, removes the key from its leaf (or moves the predecessor up
+into the internal node that holds it) and walks the same path back up, where a child that fell below
+relaxed_min borrows one key from a sibling that can spare it or merges with one, right sibling first. Borrowing
+leaves the parent as it was and stops the walk, a merge takes one key from the parent, which may need a repair
+one level up in turn.
+Nodes can then be left nearly empty for good. Every few removes (a quarter of the keys, at least FILL_CHECK_MIN)
+check_fill() measures keys per node in each subtree of the root, and a subtree whose nodes are on average less
+than rebuild_below full is rebuilt packed by build_sorted at the same height, so the rest of the tree is not
+touched. Insert, remove_many, remove_range and buffered flushes still fix nodes to t-1 keys, which satisfies
+every policy. Going back to a stricter minimum fills every node up to t-1 keys once with fix_children.
+Neither save_image nor dump records the policy, so build_tree and materialize fill up what they read the same way
+(fill_loaded) before anything is removed from it.
+*/
+
+static const size_t FILL_CHECK_MIN = 64; // removes between two fill checks at least
+
+// Helper: add the keys and nodes of the subtree rooted at x to keys and nodes
+static void measure(const Node *x, size_t &keys, size_t &nodes)
+{
+    keys += x->n;
+    nodes++;
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            measure(x->c[i], keys, nodes);
+        }
+    }
+}
+
+// Helper: append the keys of the subtree rooted at x to out in ascending order
+static void collect(const Node *x, std::vector<int> &out)
+{
+    for (int i = 0; i < x->n; i++)
+    {
+        if (!x->leaf)
+        {
+            collect(x->c[i], out);
+        }
+        out.push_back(x->keys[i]);
+    }
+    if (!x->leaf)
+    {
+        collect(x->c[x->n], out);
+    }
+}
+
+// choose how remove() keeps nodes filled, min_keys is the MinFill minimum and rebuild_below the average fill
+// under which a subtree of the root is rebuilt (0 never rebuilds)
+// Precondition: None
+// Postcondition: min_keys is clamped to 1 .. t-1, a policy with a higher minimum than the old one first fills
+//                every node up to t-1 keys, the keys of the tree are unchanged
+
+void BTree::set_delete_policy(DeletePolicy p, int min_keys, double below)
+{
+    materialize();
+    int old_min = policy == DeletePolicy::Strict ? t - 1 : relaxed_min;
+    if (p == DeletePolicy::Strict)
+    {
+        relaxed_min = t - 1;
+    }
+    else if (p == DeletePolicy::MergeAtEmpty)
+    {
+        relaxed_min = 1;
+    }
+    else
+    {
+        relaxed_min = std::clamp(min_keys, 1, std::max(t - 1, 1));
+    }
+    policy = p;
+    rebuild_below = std::clamp(below, 0.0, 1.0);
+    next_fill_check = relaxed_removes + FILL_CHECK_MIN;
+
+    if (relaxed_min > old_min && root)
+    {
+        own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+        fill_up(root);
+        collapse_root();
+        if (!messages.empty())
+        {
+            settle_messages(); // the root may have lost levels
+        }
+    }
+}
+
+// remove the key k, fixing only the nodes on its path that fell below relaxed_min on the way back up
+// Precondition: root is not nullptr and owned by the tree, the policy is MinFill or MergeAtEmpty
+// Postcondition: k is not in the tree, every node but the root holds at least relaxed_min keys,
+//                the root may be left without keys (remove_now collapses it)
+
+void BTree::remove_relaxed(int k)
+{
+    // the nodes on the path and the child we went down to in each
+    Node *path[MAX_HEIGHT];
+    int child[MAX_HEIGHT];
+    int depth = 0;
+
+    Node *x = root;
+    while (true)
+    {
+        int i = find_k(x, k);
+        bool found = i < x->n && x->keys[i] == k;
+        if (found && x->leaf)
+        {
+            remove_leaf_key(x, i);
+            break;
+        }
+        if (found)
+        {
+            // the predecessor, the last key of the rightmost leaf under c[i], takes the place of k
+            path[depth] = x;
+            child[depth++] = i;
+            Node *y = own(x, i);
+            while (!y->leaf)
+            {
+                path[depth] = y;
+                child[depth++] = y->n;
+                y = own(y, y->n);
+            }
+            x->keys[i] = y->keys[y->n - 1];
+            remove_leaf_key(y, y->n - 1);
+            break;
+        }
+        if (x->leaf)
+        {
+            return; // k is not in the tree, no node was restructured
+        }
+        path[depth] = x;
+        child[depth++] = i;
+        x = own(x, i);
+    }
+
+    // Back up: the counts on the path shrink by one, and a child below the minimum is repaired. A node above a
+    // child that kept enough keys did not change, so without counts to fix the walk ends there.
+    for (int d = depth - 1; d >= 0; d--)
+    {
+        if (order_stats)
+        {
+            path[d]->counts[child[d]]--;
+        }
+        if (path[d]->c[child[d]]->n < relaxed_min)
+        {
+            repair_child(path[d], child[d]);
+        }
+        else if (!order_stats)
+        {
+            break;
+        }
+    }
+
+    relaxed_removes++;
+    if (rebuild_below > 0 && relaxed_removes >= next_fill_check)
+    {
+        check_fill();
+    }
+}
+
+// bring x->c[i] back to relaxed_min keys: borrow one key from a sibling that has more, otherwise merge with one
+// Precondition: x is owned by the tree, x->c[i] holds relaxed_min - 1 keys, every other child of x holds at least relaxed_min
+// Postcondition: the keys of x->c[i] moved into a node holding at least relaxed_min keys, x lost one key if they merged,
+//                nothing happens if x has no keys (the root, collapsed by the caller)
+
+void BTree::repair_child(Node *x, int i)
+{
+    Node *right_sib = (i < x->n) ? x->c[i + 1] : nullptr;
+    Node *left_sib = (i > 0) ? x->c[i - 1] : nullptr;
+    if (!right_sib && !left_sib)
+    {
+        return;
+    }
+    Node *y = own(x, i);
+    if (right_sib != nullptr && right_sib->n > relaxed_min)
+    {
+        swap_right(x, y, own(x, i + 1), i);
+    }
+    else if (left_sib != nullptr && left_sib->n > relaxed_min)
+    {
+        swap_left(x, y, own(x, i - 1), i - 1);
+    }
+    else if (right_sib != nullptr) // both hold at most relaxed_min keys, together they fit in one node
+    {
+        merge_left(y, own(x, i + 1), x->keys[i]);
+        remove_internal_key(x, i, i + 1);
+    }
+    else
+    {
+        merge_left(own(x, i - 1), y, x->keys[i - 1]);
+        remove_internal_key(x, i - 1, i);
+    }
+}
+
+// fill every node below x up to t-1 keys, children first
+// Precondition: x is owned by the tree, every node below x holds at least one key
+// Postcondition: every node below x holds at least t-1 keys unless x has no keys left
+
+void BTree::fill_up(Node *x)
+{
+    if (x->leaf)
+    {
+        return;
+    }
+    for (int i = 0; i <= x->n; i++)
+    {
+        fill_up(own(x, i));
+    }
+    fix_children(x); // btree_delete_batch.cpp
+}
+
+// bring a tree read from a file or an image back to t-1 keys per node
+// Precondition: every node holds at least one key
+// Postcondition: every node but the root holds at least t-1 keys, so a tree saved under MinFill or MergeAtEmpty (the
+//                formats do not record the policy) is safe for the CLRS remove, O(n) like reading it
+
+void BTree::fill_loaded()
+{
+    if (!root)
+    {
+        return;
+    }
+    fill_up(root);
+    collapse_root();
+}
+
+// rebuild packed every subtree of the root whose nodes are on average less than rebuild_below full
+// Precondition: root is owned by the tree
+// Postcondition: the tree holds the same keys with the same height, next_fill_check is set for the next check
+
+void BTree::check_fill()
+{
+    size_t total = 0;
+    if (root && !root->leaf)
+    {
+        int h = 0; // height of the root's children, 0 for leaves
+        for (Node *x = root->c[0]; !x->leaf; x = x->c[0])
+        {
+            h++;
+        }
+        std::vector<long long> max_keys = {2LL * t - 1};
+        while ((int)max_keys.size() <= h)
+        {
+            max_keys.push_back((max_keys.back() + 1) * 2 * t - 1);
+        }
+
+        for (int i = 0; i <= root->n; i++)
+        {
+            size_t keys = 0;
+            size_t nodes = 0;
+            measure(root->c[i], keys, nodes);
+            total += keys;
+            // a subtree too small for its height cannot lose nodes to packing, it stays as it is
+            double capacity = (double)nodes * (2 * t - 1);
+            if (keys >= rebuild_below * capacity || nodes <= (size_t)h + 1 + 2 * keys / (2 * t - 1))
+            {
+                continue;
+            }
+            std::vector<int> sorted;
+            sorted.reserve(keys);
+            collect(root->c[i], sorted);
+            Node *old = root->c[i];
+            root->c[i] = build_sorted(sorted.data(), (long long)keys, h, max_keys, false, relaxed_min);
+            unref(old); // freed unless a snapshot still reads it
+            rebuilds++;
+        }
+    }
+    next_fill_check = relaxed_removes + std::max(FILL_CHECK_MIN, total / 4);
+}
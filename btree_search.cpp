@@ -0,0 +1,290 @@
+#include "btree.h"
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BTREE_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+NOTE: Rank kernels used by find_k. Keys in a node are sorted, so the index of the first key >= k is
+the same as the number of keys < k. The SIMD kernels count that with vector compares and popcount,
+a block at a time, and stop at the first block that is not entirely smaller than k.
+For very wide nodes a branchless binary search wins, node_rank picks between the two.
+*/
+
+// return the index of the first key in keys[0..n) that is >= k, scanning one key at a time
+// Precondition: keys[0..n) is sorted ascending
+// Postcondition: returns i with 0 <= i <= n, keys[j] < k for all j < i, and keys[i] >= k if i < n
+
+int rank_linear(const int *keys, int n, int k)
+{
+    int i = 0;
+    while (i < n && k > keys[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+// same result as rank_linear, binary search where the comparison picks a pointer instead of a branch
+// Precondition: keys[0..n) is sorted ascending
+// Postcondition: same as rank_linear
+
+int rank_branchless(const int *keys, int n, int k)
+{
+    if (n <= 0)
+    {
+        return 0;
+    }
+    const int *base = keys;
+    while (n > 1)
+    {
+        int half = n / 2;
+        base = (base[half - 1] < k) ? base + half : base; // compiles to cmov
+        n -= half;
+    }
+    return (int)(base - keys) + (*base < k);
+}
+
+#ifdef BTREE_X86
+
+__attribute__((target("sse4.2,popcnt"))) int rank_sse(const int *keys, int n, int k)
+{
+    __m128i kv = _mm_set1_epi32(k);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+        int less = _mm_popcnt_u32(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(kv, block))));
+        if (less < 4)
+        {
+            return i + less;
+        }
+    }
+    return i + rank_linear(keys + i, n - i, k);
+}
+
+__attribute__((target("avx2,popcnt"))) int rank_avx2(const int *keys, int n, int k)
+{
+    __m256i kv = _mm256_set1_epi32(k);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        int less = _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(kv, block))));
+        if (less < 8)
+        {
+            return i + less;
+        }
+    }
+    return i + rank_linear(keys + i, n - i, k);
+}
+
+__attribute__((target("avx512f,popcnt"))) int rank_avx512(const int *keys, int n, int k)
+{
+    __m512i kv = _mm512_set1_epi32(k);
+    int i = 0;
+    for (; i < n; i += 16)
+    {
+        // the last block is a masked load, so we never read past keys[n-1]
+        __mmask16 valid = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512i block = _mm512_maskz_loadu_epi32(valid, keys + i);
+        int less = _mm_popcnt_u32(_mm512_mask_cmplt_epi32_mask(valid, block, kv));
+        if (less < 16)
+        {
+            return i + less;
+        }
+    }
+    return n;
+}
+
+#endif
+
+// return every rank kernel this CPU can run, portable ones first
+std::vector<RankKernel> rank_kernels()
+{
+    // scan_max is where rank_branchless starts to win over the kernel (measured with ./bench_btree rank)
+    std::vector<RankKernel> kernels = {{"linear", rank_linear, 127}, {"branchless", rank_branchless, 0}};
+#ifdef BTREE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        kernels.push_back({"sse4.2", rank_sse, 255});
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        kernels.push_back({"avx2", rank_avx2, 1023});
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt"))
+        kernels.push_back({"avx512", rank_avx512, 2047});
+#endif
+    return kernels;
+}
+
+// Helper: the widest linear kernel, picked once at startup from CPUID
+static RankKernel pick_linear_kernel()
+{
+    std::vector<RankKernel> kernels = rank_kernels();
+    return kernels.size() > 2 ? kernels.back() : kernels[0];
+}
+
+static const RankKernel linear_kernel = pick_linear_kernel();
+
+// return the index of the first key in keys[0..n) that is >= k using the fastest kernel for this CPU and width
+// Precondition: keys[0..n) is sorted ascending
+// Postcondition: same as rank_linear
+
+int node_rank(const int *keys, int n, int k)
+{
+    if (n > linear_kernel.scan_max)
+    {
+        return rank_branchless(keys, n, k);
+    }
+    return linear_kernel.fn(keys, n, k);
+}
+
+// return how many keys node_rank compares k with on a node of n keys: all of them for a scan,
+// one per halving for the binary search
+int node_rank_comparisons(int n)
+{
+    if (n > linear_kernel.scan_max)
+    {
+        return std::bit_width(unsigned(n));
+    }
+    return n;
+}
+
+// return the name of the linear kernel node_rank uses on this CPU
+const char *node_rank_kernel()
+{
+    return linear_kernel.name;
+}
+
+// Lanes walked in lockstep by lookup_many
+static const int LOOKUP_LANES = 16;
+
+// Helper: ask for the cache lines holding x's header and its first keys
+static inline void prefetch_node(const Node *x)
+{
+    const char *p = reinterpret_cast<const char *>(x);
+    __builtin_prefetch(p);
+    __builtin_prefetch(p + 64);
+    __builtin_prefetch(p + 128);
+}
+
+// return true if key k is in the btree
+// Precondition: None (handles empty tree case)
+// Postcondition: the tree is unchanged
+
+bool BTree::contains(int k)
+{
+    if (image)
+    {
+        return image_contains(k);
+    }
+    bool insert;
+    if (find_message(messages, k, insert)) // a buffered message for k is newer than the nodes
+    {
+        return insert;
+    }
+    Node *x = root;
+    while (x != nullptr)
+    {
+        int i = find_k(x, k);
+        if (i < x->n && x->keys[i] == k)
+        {
+            return !is_tombstone(k);
+        }
+        if (x->leaf)
+        {
+            return false;
+        }
+        x = x->c[i];
+    }
+    return false;
+}
+
+// set out[j] to contains(keys[j]) for every j
+// Precondition: out.size() >= keys.size()
+// Postcondition: out[j] is true exactly when keys[j] is in the tree, the tree is unchanged (buffered messages are read, not applied)
+// Up to LOOKUP_LANES searches descend together, one level per round. Each lane prefetches the child it
+// will read next round, so the misses of all lanes are in flight at once instead of one after another.
+
+void BTree::lookup_many(std::span<const int> keys, std::span<bool> out)
+{
+    size_t count = keys.size() < out.size() ? keys.size() : out.size();
+    if (image)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            out[j] = image_contains(keys[j]);
+        }
+        return;
+    }
+    if (!root)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            out[j] = false;
+        }
+        return;
+    }
+
+    Node *node[LOOKUP_LANES];
+    size_t job[LOOKUP_LANES]; // index into keys/out of the search running in each lane
+    int active = 0;
+    size_t next_job = 0;
+
+    // Fill every lane, all searches start at the root
+    while (active < LOOKUP_LANES && next_job < count)
+    {
+        node[active] = root;
+        job[active] = next_job++;
+        active++;
+    }
+
+    while (active > 0)
+    {
+        for (int lane = 0; lane < active;)
+        {
+            Node *x = node[lane];
+            int k = keys[job[lane]];
+            int i = find_k(x, k);
+
+            bool found = i < x->n && x->keys[i] == k;
+            if (!found && !x->leaf)
+            {
+                // go one level down next round, the prefetch overlaps with the other lanes' work
+                node[lane] = x->c[i];
+                prefetch_node(node[lane]);
+                lane++;
+                continue;
+            }
+
+            // This search is done: record it and start the next key in the same lane
+            out[job[lane]] = found && !is_tombstone(k);
+            if (next_job < count)
+            {
+                node[lane] = root;
+                job[lane] = next_job++;
+                lane++;
+            }
+            else
+            {
+                active--;
+                node[lane] = node[active];
+                job[lane] = job[active];
+            }
+        }
+    }
+
+    // The lanes only search the nodes, a buffered message for a key is newer than what they found
+    if (pending_messages() > 0)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            bool insert;
+            if (find_message(messages, keys[j], insert))
+            {
+                out[j] = insert;
+            }
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include "btree.h"
+#include <algorithm>
+
+/*
+NOTE: Copy-on-write snapshots. Every node counts the parents and roots that point to it (refs).
+snapshot() only adds a reference to the root. A writer walks down from the root and, before it changes
+a node, makes sure the tree is the node's only owner: a node with refs > 1 is copied, the copy takes a
+reference to every child and replaces the node in its (already owned) parent. So a write copies the
+nodes on its path and the siblings it borrows from or merges with, everything else stays shared.
+When the last reference to a node goes, the node drops its references to its children and is freed.
+The tree frees into its pool, a snapshot dropped on another thread frees into the arena's remote list.
+Tombstones and buffered messages are not in the nodes, so a snapshot keeps its own copy of both and reads them
+like the tree does (contains, cursors) instead of making snapshot() compact or flush the tree.
+*/
+
+// Helper: the reference count is shared with snapshot handles on other threads
+static std::atomic_ref<int> refs_of(Node *x)
+{
+    return std::atomic_ref<int>(x->refs);
+}
+
+// Helper: drop one reference to x on a thread that is not the tree's writer, freeing nodes into the arena
+static void release_remote(Node *x, NodeArena &arena)
+{
+    if (refs_of(x).fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            release_remote(x->c[i], arena);
+        }
+    }
+    arena.push_free(x);
+}
+
+// make x->c[i] a node only this tree points to, copying it if a snapshot shares it
+// Precondition: x is owned by the tree (it is the root after own_root() or was returned by own())
+// Postcondition: returns x->c[i], which the tree may now change in place
+
+Node *BTree::own(Node *x, int i)
+{
+    if (refs_of(x->c[i]).load(std::memory_order_acquire) != 1)
+    {
+        x->c[i] = copy_shared(x->c[i]);
+    }
+    return x->c[i];
+}
+
+// make the root a node only this tree points to, copying it if a snapshot shares it
+// Precondition: root is not nullptr
+// Postcondition: the tree may change root in place
+
+void BTree::own_root()
+{
+    root = own_node(root);
+}
+
+// make x, a node the tree holds without a parent (a root or a subtree split_at or join moves), one only this
+// tree points to
+// Precondition: the tree holds a reference to x and stores the result where it kept x
+// Postcondition: returns x if no snapshot shares it, otherwise a private copy (see copy_shared)
+
+Node *BTree::own_node(Node *x)
+{
+    if (refs_of(x).load(std::memory_order_acquire) != 1)
+    {
+        return copy_shared(x);
+    }
+    return x;
+}
+
+// replace the tree's reference to the shared node y by a private copy
+// Precondition: the tree holds a reference to y, the caller stores the copy where the tree pointed to y
+// Postcondition: returns a node with y's keys and children (one more reference each), y lost the tree's reference
+
+Node *BTree::copy_shared(Node *y)
+{
+    Node *copy = pool.alloc(y->leaf);
+    copy->n = y->n;
+    std::copy(y->keys, y->keys + y->n, copy->keys);
+    if (!y->leaf)
+    {
+        for (int j = 0; j <= y->n; j++)
+        {
+            copy->c[j] = y->c[j];
+            refs_of(y->c[j]).fetch_add(1, std::memory_order_relaxed);
+        }
+        if (order_stats)
+        {
+            std::copy(y->counts, y->counts + y->n + 1, copy->counts);
+        }
+    }
+    unref(y);
+    return copy;
+}
+
+// drop one reference to x
+// Precondition: the caller held a reference to x and no longer points to it
+// Postcondition: if that was the last reference, x dropped its references to its children and went back to the pool
+
+void BTree::unref(Node *x)
+{
+    if (refs_of(x).fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    if (!x->leaf)
+    {
+        for (int i = 0; i <= x->n; i++)
+        {
+            unref(x->c[i]);
+        }
+    }
+    pool.free(x);
+}
+
+// return a read-only view of the current keys
+// Precondition: no other thread writes to the tree during the call
+// Postcondition: the snapshot shares the root with the tree and copies its tombstones and buffered messages,
+//                O(1 + tombstone_count() + pending_messages()), the tree is unchanged
+
+BTree::Snapshot BTree::snapshot()
+{
+    materialize();
+    if (root)
+    {
+        refs_of(root).fetch_add(1, std::memory_order_relaxed);
+    }
+    // Later compactions and flushes change shared nodes only through copies, so the snapshot reads its nodes
+    // together with the tombstones and messages they had at this point
+    std::shared_ptr<Snapshot::Pending> pending;
+    if (!tombstones.empty() || pending_messages() > 0)
+    {
+        pending = std::make_shared<Snapshot::Pending>();
+        pending->tombstones = tombstones;
+        pending->messages = messages;
+    }
+    return Snapshot(root, t, pool.shared_arena(), std::move(pending));
+}
+
+BTree::Snapshot &BTree::Snapshot::operator=(Snapshot &&other) noexcept
+{
+    std::swap(root, other.root);
+    std::swap(t, other.t);
+    std::swap(arena, other.arena);
+    std::swap(pending, other.pending);
+    return *this;
+}
+
+BTree::Snapshot::~Snapshot()
+{
+    if (root)
+    {
+        release_remote(root, *arena);
+    }
+}
+
+// return true if key k was in the tree when the snapshot was taken
+bool BTree::Snapshot::contains(int k) const
+{
+    bool insert;
+    if (pending && find_message(pending->messages, k, insert))
+    {
+        return insert;
+    }
+    const Node *x = root;
+    while (x)
+    {
+        int i = node_rank(x->keys, x->n, k);
+        if (i < x->n && x->keys[i] == k)
+        {
+            return !pending || !pending->tombstones.count(k);
+        }
+        x = x->leaf ? nullptr : x->c[i];
+    }
+    return false;
+}
+
+// iterator on the smallest key
+BTree::iterator BTree::Snapshot::begin() const
+{
+    Cursor cur(*this);
+    cur.seek_first();
+    return iterator(cur);
+}
+
+// iterator past the largest key
+BTree::iterator BTree::Snapshot::end() const
+{
+    return iterator(Cursor(*this));
+}
+
+// iterator on the smallest key >= k, or end() if there is none
+BTree::iterator BTree::Snapshot::lower_bound(int k) const
+{
+    Cursor cur(*this);
+    cur.seek(k);
+    return iterator(cur);
+}
@@ -0,0 +1,359 @@
+#include "btree.h"
+#include <algorithm>
+
+/*
+NOTE: Split and join of whole trees. Both are built on graft(a, k, b), which glues two subtrees and a key between
+them into one tree: the lower subtree becomes the last (or first) child of the node at its height on the edge of
+the taller one, with k as the separator, so only the nodes on that edge are touched. Full nodes on the way down
+are split first like insert does, and the glued root, which may hold as little as one key, is filled up with
+fix_child like remove_many does. That costs O(t) per level between the two heights.
+split_at(k) walks down the path to k. Each node on it is cut in two fragments, its keys and children left and
+right of the path, and the pieces are glued back together on the way up: the left result of the level below
+with the left fragment, the right result with the right fragment. The heights only grow on the way up, so the
+grafts add up to O(height) node operations, like the walk itself.
+join(left, right) takes the smallest key of right out as the separator and grafts the two roots. The nodes of
+right are not copied: right's node memory is handed to left's pool (btree_pool.cpp), and the halves of a split
+keep sharing one arena, so joining them again moves no memory at all.
+Buffered messages are applied and tombstones go with their keys before anything is cut, a mapped image is
+materialized first.
+*/
+
+// return the number of levels below the root, 0 for a single leaf and -1 for an empty tree
+int BTree::height() const
+{
+    int h = root ? 0 : -1;
+    for (Node *x = root; x && !x->leaf; x = x->c[0])
+    {
+        h++;
+    }
+    return h;
+}
+
+// glue the subtrees a and b and the key k between them into one subtree
+// Precondition: every key of a is smaller than k and every key of b larger, a and b are held by the tree only
+//               through these pieces, their roots hold at least one key and every other node what the delete
+//               policy asks for
+// Postcondition: returns a piece holding the keys of a, k and the keys of b whose root holds at least one key and
+//                whose other nodes still fit the delete policy, O(t) work per level between the heights of a and b
+
+BTree::Piece BTree::graft(Piece a, int k, Piece b)
+{
+    if (!a.root && !b.root)
+    {
+        Node *x = pool.alloc(true);
+        x->keys[0] = k;
+        x->n = 1;
+        return {x, 0};
+    }
+    if (a.h == b.h)
+    {
+        // same height: k becomes a new root over both, which fix_children fills up or merges into one node
+        Node *x = pool.alloc(false);
+        x->keys[0] = k;
+        x->n = 1;
+        x->c[0] = a.root;
+        x->c[1] = b.root;
+        recount(x);
+        fix_children(x);
+        if (x->n == 0)
+        {
+            Node *only = x->c[0];
+            pool.free(x);
+            return {only, a.h};
+        }
+        return {x, a.h + 1};
+    }
+
+    // the lower piece (possibly empty) goes on the right edge of a taller a, or on the left edge of a taller b
+    bool onto_a = a.h > b.h;
+    Piece tall = onto_a ? a : b;
+    Piece low = onto_a ? b : a;
+    Node *top = own_node(tall.root);
+    int h = tall.h;
+    if (top->n == 2 * t - 1)
+    {
+        Node *new_root = pool.alloc(false);
+        new_root->c[0] = top;
+        if (order_stats)
+        {
+            new_root->counts[0] = subtree_size(top);
+        }
+        top = new_root;
+        split_child(top, 0);
+        h++;
+    }
+    Piece glued = {top, h};
+    size_t added = order_stats ? 1 + (low.root ? subtree_size(low.root) : 0) : 0;
+
+    // down the edge to the node one level above low (a leaf if low is empty), no node on the way is full
+    Node *x = top;
+    while (h > low.h + 1)
+    {
+        int i = onto_a ? x->n : 0;
+        if (own(x, i)->n == 2 * t - 1)
+        {
+            split_child(x, i);
+            i = onto_a ? x->n : 0;
+        }
+        if (order_stats)
+        {
+            x->counts[i] += added;
+        }
+        x = own(x, i);
+        h--;
+    }
+
+    if (x->leaf)
+    {
+        insert_leaf_key(x, onto_a ? x->n : 0, k);
+        return glued;
+    }
+    if (onto_a)
+    {
+        x->keys[x->n] = k;
+        x->c[x->n + 1] = low.root;
+        if (order_stats)
+        {
+            x->counts[x->n + 1] = added - 1;
+        }
+        x->n++;
+        fix_child(x, x->n); // btree_delete_batch.cpp
+    }
+    else
+    {
+        for (int j = x->n; j > 0; j--)
+        {
+            x->keys[j] = x->keys[j - 1];
+        }
+        for (int j = x->n + 1; j > 0; j--)
+        {
+            x->c[j] = x->c[j - 1];
+            if (order_stats)
+            {
+                x->counts[j] = x->counts[j - 1];
+            }
+        }
+        x->keys[0] = k;
+        x->c[0] = low.root;
+        if (order_stats)
+        {
+            x->counts[0] = added - 1;
+        }
+        x->n++;
+        fix_child(x, 0);
+    }
+    return glued;
+}
+
+// cut the subtree x into the keys smaller than k and the keys from k up
+// Precondition: x is owned by the tree, h levels above the leaves, and holds at least one key
+// Postcondition: left and right hold the keys of x below k and from k up, x is reused or freed,
+//                O(t) work per level plus the grafts (O(height) altogether)
+
+void BTree::split_node(Node *x, int h, int k, Piece &left, Piece &right)
+{
+    int i = find_k(x, k);
+    if (x->leaf)
+    {
+        Node *r = pool.alloc(true);
+        std::copy(x->keys + i, x->keys + x->n, r->keys);
+        r->n = x->n - i;
+        x->n = i;
+        left = {x, 0};
+        right = {r, 0};
+        for (Piece *p : {&left, &right})
+        {
+            if (p->root->n == 0)
+            {
+                pool.free(p->root);
+                *p = {nullptr, -1};
+            }
+        }
+        return;
+    }
+
+    bool hit = i < x->n && x->keys[i] == k;
+    Node *path = hit ? x->c[i] : own(x, i);
+    int n = x->n;
+
+    // left fragment: keys 0 .. i-2 and children 0 .. i-1, keys[i-1] glues it to what lies left of the path
+    Piece left_frag = {nullptr, -1};
+    int left_sep = 0;
+    if (i == 1)
+    {
+        left_frag = {x->c[0], h - 1};
+    }
+    else if (i > 1)
+    {
+        Node *l = pool.alloc(false);
+        std::copy(x->keys, x->keys + i - 1, l->keys);
+        std::copy(x->c, x->c + i, l->c);
+        if (order_stats)
+        {
+            std::copy(x->counts, x->counts + i, l->counts);
+        }
+        l->n = i - 1;
+        left_frag = {l, h};
+    }
+    if (i > 0)
+    {
+        left_sep = x->keys[i - 1];
+    }
+
+    // right fragment: keys i+1 .. n-1 and children i+1 .. n, shifted to the front of x, keys[i] glues it on
+    Piece right_frag = {nullptr, -1};
+    int right_sep = i < n ? x->keys[i] : 0;
+    if (i < n - 1)
+    {
+        int m = n - i - 1;
+        std::copy(x->keys + i + 1, x->keys + n, x->keys);
+        std::copy(x->c + i + 1, x->c + n + 1, x->c);
+        if (order_stats)
+        {
+            std::copy(x->counts + i + 1, x->counts + n + 1, x->counts);
+        }
+        std::fill(x->c + m + 1, x->c + n + 1, nullptr);
+        x->n = m;
+        right_frag = {x, h};
+    }
+    else
+    {
+        if (i == n - 1)
+        {
+            right_frag = {x->c[n], h - 1};
+        }
+        pool.free(x); // its keys and children went to the fragments
+    }
+
+    Piece below_left;
+    Piece below_right;
+    if (hit)
+    {
+        // k is keys[i]: everything under c[i] is smaller, k is the smallest key of the right side
+        below_left = {path, h - 1};
+        below_right = {nullptr, -1};
+        right_sep = k;
+    }
+    else
+    {
+        split_node(path, h - 1, k, below_left, below_right);
+    }
+
+    left = i > 0 ? graft(left_frag, left_sep, below_left) : below_left;
+    right = i < n ? graft(below_right, right_sep, right_frag) : below_right;
+}
+
+// the keys >= k of tree, taken out of it, in a tree of the same degree with the same settings
+// Precondition: None
+// Postcondition: tree keeps its keys < k, O(t log n) node work plus one pass over the tombstones
+
+BTree::BTree(BTree &tree, int k) : BTree(tree.t)
+{
+    if (t < 2 || !tree.materialize())
+    {
+        return;
+    }
+    tree.flush_messages();
+    pool.share(tree.pool); // every node stays where it is, both trees free into the same memory
+    order_stats = tree.order_stats;
+    lazy_remove = tree.lazy_remove;
+    set_buffered(tree.buffered, tree.buffer_capacity);
+    set_delete_policy(tree.policy, tree.relaxed_min, tree.rebuild_below);
+    for (auto it = tree.tombstones.begin(); it != tree.tombstones.end();)
+    {
+        if (*it >= k)
+        {
+            tombstones.insert(*it);
+            it = tree.tombstones.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (!tree.root)
+    {
+        return;
+    }
+
+    int h = tree.height();
+    tree.own_root(); // a snapshot may share the root, every node we change is copied first (btree_snapshot.cpp)
+    Piece left;
+    Piece right;
+    tree.split_node(tree.root, h, k, left, right);
+    tree.root = left.root;
+    root = right.root;
+}
+
+// move every key >= k into a new tree
+// Precondition: None
+// Postcondition: returns a tree of the same degree and settings holding the keys >= k, this tree keeps the
+//                keys < k, no key is copied: the returned tree shares the node memory of this one
+
+BTree BTree::split_at(int k)
+{
+    return BTree(*this, k);
+}
+
+// move every key of right into left
+// Precondition: every key of right is larger than every key of left
+// Postcondition: returns false and changes nothing if the degrees differ or the key ranges overlap, otherwise left
+//                holds the keys of both and right is empty, O(t log n) node work unless right has to be brought to
+//                left's settings first: copied into nodes with or without counts, or filled up to a stricter delete
+//                policy
+
+bool BTree::join(BTree &left, BTree &right)
+{
+    if (&left == &right || left.t != right.t || left.t < 2)
+    {
+        std::cerr << "Error: join needs two trees of the same minimum degree\n";
+        return false;
+    }
+    if (!left.materialize() || !right.materialize())
+    {
+        return false;
+    }
+    left.flush_messages();
+    right.flush_messages();
+    if (!right.root)
+    {
+        return true;
+    }
+    if (left.root && left.max_key(left.root) >= right.min_key(right.root))
+    {
+        std::cerr << "Error: join needs every key of right to be larger than every key of left\n";
+        return false;
+    }
+    // right's nodes join left's tree, so they follow its settings
+    right.set_order_stats(left.order_stats);
+    int left_min = left.policy == DeletePolicy::Strict ? left.t - 1 : left.relaxed_min;
+    int right_min = right.policy == DeletePolicy::Strict ? right.t - 1 : right.relaxed_min;
+    if (right_min < left_min)
+    {
+        right.set_delete_policy(left.policy, left.relaxed_min, left.rebuild_below);
+    }
+
+    // the smallest key of right goes between the two trees, a tombstone stays one
+    int k = right.min_key(right.root);
+    bool dead = right.is_tombstone(k);
+    right.remove_now(k);
+    left.tombstones.merge(right.tombstones);
+    right.tombstones.clear();
+    if (dead)
+    {
+        left.tombstones.insert(k);
+    }
+
+    if (right.root && !left.pool.adopt(right.pool))
+    {
+        // right's memory already keeps left's alive, holding it in turn would leak both: copy right instead
+        Node *copy = right.clone(right.root, left.pool);
+        right.unref(right.root); // the originals go back to the memory they came from
+        right.pool.release();
+        right.root = copy;
+    }
+    Piece glued = left.graft({left.root, left.height()}, k, {right.root, right.height()});
+    left.root = glued.root;
+    right.root = nullptr;
+    return true;
+}
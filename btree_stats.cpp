@@ -0,0 +1,191 @@
+#include "btree.h"
+#include <algorithm>
+#include <mutex>
+
+/*
+NOTE: Counters and tree statistics. With BTREE_STATS every thread gets its own block of counters the first time
+it counts something. The block registers itself in a global list and, when its thread exits, adds its counts
+to a retired total and unregisters. op_counters() takes the list's lock and sums, so counting itself never
+touches shared memory. Without BTREE_STATS none of this is compiled and op_counters() reports enabled = false.
+*/
+
+static const char *const OP_COUNTER_NAMES[OP_COUNTER_COUNT] = {
+    "nodes_visited", "find_k_comparisons", "remove_case_1", "remove_case_2a", "remove_case_2b",
+    "remove_case_2c", "remove_case_3a", "remove_case_3b", "swap_left", "swap_right",
+    "merge_left", "merge_right", "nodes_freed", "root_collapses",
+};
+
+// name of counter c as written by TreeStats::print
+const char *op_counter_name(OpCounter c)
+{
+    return OP_COUNTER_NAMES[c];
+}
+
+#ifdef BTREE_STATS
+namespace
+{
+    struct LocalCounters;
+
+    struct CounterRegistry
+    {
+        std::mutex m;
+        std::vector<LocalCounters *> live;
+        uint64_t retired[OP_COUNTER_COUNT] = {};
+    };
+
+    // Helper: constructed on first use, so threads that count during static initialization find it
+    CounterRegistry &registry()
+    {
+        static CounterRegistry r;
+        return r;
+    }
+
+    struct LocalCounters
+    {
+        std::atomic<uint64_t> count[OP_COUNTER_COUNT] = {};
+
+        LocalCounters()
+        {
+            std::lock_guard<std::mutex> guard(registry().m);
+            registry().live.push_back(this);
+        }
+
+        ~LocalCounters()
+        {
+            CounterRegistry &r = registry();
+            std::lock_guard<std::mutex> guard(r.m);
+            for (int c = 0; c < OP_COUNTER_COUNT; c++)
+            {
+                r.retired[c] += count[c].load(std::memory_order_relaxed);
+            }
+            r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+        }
+    };
+}
+
+std::atomic<uint64_t> *local_op_counters()
+{
+    thread_local LocalCounters counters;
+    return counters.count;
+}
+#endif
+
+// sum the counters of every thread, live or exited
+// Precondition: None
+// Postcondition: returns the totals since the last reset_op_counters(), all 0 and enabled = false without BTREE_STATS
+
+OpCounters op_counters()
+{
+    OpCounters total = {};
+#ifdef BTREE_STATS
+    total.enabled = true;
+    CounterRegistry &r = registry();
+    std::lock_guard<std::mutex> guard(r.m);
+    for (int c = 0; c < OP_COUNTER_COUNT; c++)
+    {
+        total.count[c] = r.retired[c];
+    }
+    for (LocalCounters *local : r.live)
+    {
+        for (int c = 0; c < OP_COUNTER_COUNT; c++)
+        {
+            total.count[c] += local->count[c].load(std::memory_order_relaxed);
+        }
+    }
+#endif
+    return total;
+}
+
+// set every counter back to 0
+// Precondition: no thread is counting (a count racing with the reset may be kept or lost)
+// Postcondition: op_counters() reports 0 for every counter
+
+void reset_op_counters()
+{
+#ifdef BTREE_STATS
+    CounterRegistry &r = registry();
+    std::lock_guard<std::mutex> guard(r.m);
+    for (int c = 0; c < OP_COUNTER_COUNT; c++)
+    {
+        r.retired[c] = 0;
+    }
+    for (LocalCounters *local : r.live)
+    {
+        for (int c = 0; c < OP_COUNTER_COUNT; c++)
+        {
+            local->count[c].store(0, std::memory_order_relaxed);
+        }
+    }
+#endif
+}
+
+// walk the tree once for its shape and fill factors, and read the pool and the operation counters
+// Precondition: None
+// Postcondition: returns the statistics, the tree is unchanged (a mapped image is materialized first)
+
+TreeStats BTree::stats()
+{
+    materialize();
+    TreeStats s;
+    s.pool_nodes = pool.live_nodes();
+    s.bytes = pool.bytes();
+    s.ops = op_counters();
+    s.tombstones = tombstones.size();
+    s.messages = pending_messages();
+
+    std::vector<Node *> level;
+    std::vector<Node *> next;
+    if (root)
+    {
+        level.push_back(root);
+    }
+    while (!level.empty())
+    {
+        s.height++;
+        next.clear();
+        for (Node *x : level)
+        {
+            s.nodes++;
+            s.leaves += x->leaf;
+            s.keys += x->n;
+            s.node_bytes += pool.block_size(x);
+            s.fill[x->n * 10 / (2 * t - 1)]++;
+            if (!x->leaf)
+            {
+                next.insert(next.end(), x->c, x->c + x->n + 1);
+            }
+        }
+        level.swap(next);
+    }
+    return s;
+}
+
+// For debugging, one "name value" pair per line
+void TreeStats::print(std::ostream &out) const
+{
+    out << "height " << height << "\n"
+        << "nodes " << nodes << "\n"
+        << "keys " << keys << "\n"
+        << "pool_nodes " << pool_nodes << "\n"
+        << "bytes " << bytes << "\n"
+        << "node_bytes " << node_bytes << "\n"
+        << "leaves " << leaves << "\n"
+        << "tombstones " << tombstones << "\n"
+        << "messages " << messages << "\n";
+    if (nodes > 0)
+    {
+        out << "bytes_per_key " << double(bytes) / std::max<size_t>(keys, 1) << "\n";
+        out << "node_bytes_per_key " << double(node_bytes) / std::max<size_t>(keys, 1) << "\n";
+    }
+    for (int b = 0; b <= 10; b++)
+    {
+        out << "fill_" << b * 10 << (b < 10 ? "-" + std::to_string(b * 10 + 10) : std::string()) << "% " << fill[b] << "\n";
+    }
+    if (ops.enabled)
+    {
+        for (int c = 0; c < OP_COUNTER_COUNT; c++)
+        {
+            out << op_counter_name(OpCounter(c)) << " " << ops.count[c] << "\n";
+        }
+    }
+}
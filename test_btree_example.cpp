@@ -1,6 +1,16 @@
 #include "btree.h"
+#include "btree_concurrent.h"
+#include "btree_fixed.h"
+#include "btree_frozen.h"
+#include "btree_paged.h"
 #include <cassert>
 #include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
 
 // Helper: build tree from file
 BTree build_tree(std::string fname)
@@ -9,7 +19,8 @@ BTree build_tree(std::string fname)
 }
 
 // Helper: capture tree print into a string
-std::string tree_str(BTree &tree)
+template <typename Tree>
+std::string tree_str(Tree &tree)
 {
     std::ostringstream out;
     std::streambuf *oldBuf = std::cout.rdbuf(out.rdbuf());
@@ -18,6 +29,14 @@ std::string tree_str(BTree &tree)
     return out.str();
 }
 
+// Helper: BTree writes its print output straight into the string
+std::string tree_str(BTree &tree)
+{
+    std::ostringstream out;
+    tree.dump(out);
+    return out.str();
+}
+
 // Helper: capture file into a string
 std::string get_result(std::string fname)
 {
@@ -174,6 +193,1411 @@ void test_3b(int &correct, int &total)
     total += 2;
 }
 
+void test_insert(int &correct, int &total)
+{
+    int correct_count = 0;
+    // insert F J D H B C I G A E K L M (A = 1, B = 2, ...) into an empty tree, splitting full nodes on the way down
+    BTree tree(2);
+    int first[] = {6, 10, 4, 8, 2, 3, 9, 7};
+    for (int k : first)
+    {
+        tree.insert(k);
+    }
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_41.txt", "incorrect result inserting into a full child", correct_count);
+
+    tree.insert(1);
+    tree.insert(5);
+    result = tree_str(tree);
+    check_result(result, "results/test_42.txt", "incorrect result inserting when the root is full", correct_count);
+
+    tree.insert(11);
+    tree.insert(12);
+    tree.insert(13);
+    tree.insert(8); // already in the tree
+    result = tree_str(tree);
+    check_result(result, "results/test_43.txt", "incorrect result inserting a key already in the tree", correct_count);
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_insert" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_lookup(int &correct, int &total)
+{
+    int correct_count = 0;
+    // keys in the root, internal nodes and leaves, and keys between and outside them
+    BTree tree = build_tree("tests/test_3a.txt");
+    int keys[] = {10, 5, 20, 3, 26, 11, 1, 7, 13, 17, 23, 30};
+    bool expected[] = {true, true, true, true, true, true, false, false, false, false, false, false};
+    int n = sizeof(keys) / sizeof(keys[0]);
+
+    bool single_ok = true;
+    for (int j = 0; j < n; j++)
+    {
+        if (tree.contains(keys[j]) != expected[j])
+        {
+            single_ok = false;
+            std::cout << "incorrect result looking up " << keys[j] << std::endl;
+        }
+    }
+    if (single_ok)
+    {
+        correct_count += 1;
+    }
+
+    bool out[sizeof(keys) / sizeof(keys[0])];
+    tree.lookup_many(keys, out);
+    if (std::equal(out, out + n, expected))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result in batched lookup" << std::endl;
+    }
+
+    BTree empty(2);
+    if (!empty.contains(10))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result looking up a key in an empty tree" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_lookup" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_cursor(int &correct, int &total)
+{
+    int correct_count = 0;
+    BTree tree = build_tree("tests/test_3a.txt");
+    std::vector<int> all = {3, 4, 5, 8, 9, 10, 11, 12, 15, 18, 19, 20, 22, 26};
+
+    // whole tree in order through the STL
+    std::vector<int> scanned(tree.begin(), tree.end());
+    if (scanned == all)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result scanning the whole tree in order" << std::endl;
+    }
+
+    // range [6, 20) starts between two leaves and ends on an internal key
+    std::vector<int> range;
+    for (auto it = tree.lower_bound(6); it != tree.end() && *it < 20; ++it)
+    {
+        range.push_back(*it);
+    }
+    if (range == std::vector<int>({8, 9, 10, 11, 12, 15, 18, 19}))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result scanning the range [6, 20)" << std::endl;
+    }
+
+    // backward from the last key
+    BTree::Cursor cur(tree);
+    std::vector<int> backward;
+    for (bool ok = cur.seek_last(); ok; ok = cur.prev())
+    {
+        backward.push_back(cur.key());
+    }
+    if (std::equal(backward.begin(), backward.end(), all.rbegin(), all.rend()))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result scanning the tree backward" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_cursor" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_fixed(int &correct, int &total)
+{
+    int correct_count = 0;
+    // same removes as test_2c and test_3b, on the compile-time degree tree
+    AnyBTree tree("tests/test_2c.txt");
+    tree.remove(15);
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_2c1.txt", "incorrect result in case 2c with a fixed degree", correct_count);
+
+    AnyBTree tree3b("tests/test_3b.txt");
+    tree3b.remove(5);
+    tree3b.remove(16);
+    result = tree_str(tree3b);
+    check_result(result, "results/test_3b2.txt", "incorrect result in case 3b with a fixed degree", correct_count);
+
+    if (!tree.specialized())
+    {
+        std::cout << "degree 2 tree was not specialized" << std::endl;
+    }
+
+    // degree 5 is not preinstantiated and falls back to BTree
+    AnyBTree fallback(5);
+    BTree plain(5);
+    for (int k = 1; k <= 40; k++)
+    {
+        fallback.insert(k * 7 % 41);
+        plain.insert(k * 7 % 41);
+    }
+    if (!fallback.specialized() && tree_str(fallback) == tree_str(plain))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result inserting into a degree without a specialization" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_fixed" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_image(int &correct, int &total)
+{
+    int correct_count = 0;
+    BTree tree = build_tree("tests/test_3a.txt");
+    tree.save_image("test_image.bin");
+
+    // lookups are answered from the mapping, the first remove copies it into nodes
+    BTree mapped(2);
+    bool opened = mapped.open_image("test_image.bin");
+    if (opened && mapped.mapped() && mapped.contains(26) && !mapped.contains(7))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result looking up keys in a mapped image" << std::endl;
+    }
+
+    mapped.remove(9);
+    std::string result = tree_str(mapped);
+    check_result(result, "results/test_3a1.txt", "incorrect result removing from a materialized image", correct_count);
+
+    // a flipped byte in a node record fails the checksum
+    std::fstream image("test_image.bin", std::ios::in | std::ios::out | std::ios::binary);
+    image.seekp(sizeof(ImageHeader) + 8);
+    image.put(99);
+    image.close();
+    std::ostringstream errors;
+    std::streambuf *oldBuf = std::cerr.rdbuf(errors.rdbuf());
+    BTree corrupted(2);
+    bool corrupted_opened = corrupted.open_image("test_image.bin");
+    std::cerr.rdbuf(oldBuf);
+    if (!corrupted_opened)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "corrupted image was not rejected" << std::endl;
+    }
+
+    // without verify, child indexes that loop back or that two parents share are caught by the lookup and materialize
+    bool guarded = true;
+    for (int corruption = 0; corruption < 2; corruption++)
+    {
+        tree.save_image("test_image.bin");
+        std::fstream patch("test_image.bin", std::ios::in | std::ios::out | std::ios::binary);
+        ImageHeader header;
+        patch.read(reinterpret_cast<char *>(&header), sizeof(header));
+        std::vector<uint64_t> child(2 * header.degree);
+        std::streamoff children = sizeof(ImageHeader) + header.record_bytes - sizeof(uint64_t) * child.size();
+        patch.seekg(children);
+        patch.read(reinterpret_cast<char *>(child.data()), sizeof(uint64_t) * child.size());
+        if (corruption == 0)
+            std::fill(child.begin(), child.end(), 0); // every child of the root is the root again
+        else
+            child[1] = child[0]; // the first two children of the root are the same record
+        patch.seekp(children);
+        patch.write(reinterpret_cast<const char *>(child.data()), sizeof(uint64_t) * child.size());
+        patch.close();
+
+        oldBuf = std::cerr.rdbuf(errors.rdbuf());
+        BTree unverified(2);
+        bool unverified_opened = unverified.open_image("test_image.bin", false);
+        bool lookup = !unverified.contains(3) && !unverified.contains(26);
+        unverified.insert(1); // materialize refuses the image and leaves the tree empty
+        std::cerr.rdbuf(oldBuf);
+        guarded = guarded && unverified_opened && (corruption == 1 || lookup) && !unverified.mapped() &&
+                  !unverified.contains(1) && !unverified.contains(26) && unverified.stats().keys == 0;
+    }
+    if (guarded)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "bad child indexes in an unverified image were not caught" << std::endl;
+    }
+    std::remove("test_image.bin");
+
+    std::cout << "Passed " << correct_count << "/4 tests in test_image" << std::endl;
+
+    correct += correct_count;
+    total += 4;
+}
+
+void test_load(int &correct, int &total)
+{
+    int correct_count = 0;
+    // Windows line endings and trailing blank lines load the same tree as test_3a
+    BTree tree = build_tree("tests/test_5a.txt");
+    BTree expected = build_tree("tests/test_3a.txt");
+    if (tree_str(tree) == tree_str(expected))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result loading a file with CRLF line endings" << std::endl;
+    }
+
+    // a leaf with 2t keys is rejected with the byte offset of the extra key
+    std::ostringstream errors;
+    std::streambuf *oldBuf = std::cerr.rdbuf(errors.rdbuf());
+    BTree bad = build_tree("tests/test_5b.txt");
+    std::cerr.rdbuf(oldBuf);
+    if (tree_str(bad).empty() && errors.str().find("byte 36") != std::string::npos)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect error for a node with too many keys:" << std::endl
+                  << errors.str() << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/2 tests in test_load" << std::endl;
+
+    correct += correct_count;
+    total += 2;
+}
+
+void test_remove_many(int &correct, int &total)
+{
+    int correct_count = 0;
+    // one batch empties two leaves, replaces a separator and shrinks the tree by one level, keys 1, 13 and 100 are not in the tree
+    BTree tree = build_tree("tests/test_3a.txt");
+    int batch[] = {1, 3, 4, 9, 11, 13, 15, 26, 100};
+    size_t removed = tree.remove_many(batch);
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_6a.txt", "incorrect result removing a batch of keys", correct_count);
+
+    if (removed == 6)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "remove_many reported " << removed << " removed keys, expected 6" << std::endl;
+    }
+
+    // a batch with repeated keys covering the whole key range empties the tree
+    std::vector<int> all;
+    for (int k = 0; k <= 30; k++)
+    {
+        all.push_back(k);
+        all.push_back(k);
+    }
+    removed = tree.remove_many(all);
+    if (removed == 8 && tree_str(tree).empty())
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result removing every key in one batch:" << std::endl
+                  << tree_str(tree) << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_remove_many" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_concurrent(int &correct, int &total)
+{
+    int correct_count = 0;
+    // on one thread ConcurrentBTree takes the same CLRS steps as BTree, so both trees end up with the same shape
+    BTree plain(2);
+    ConcurrentBTree shared(2);
+    for (int k = 1; k <= 40; k++)
+    {
+        plain.insert(k * 7 % 41);
+        shared.insert(k * 7 % 41);
+    }
+    for (int k = 1; k <= 40; k += 3)
+    {
+        plain.remove(k);
+        shared.remove(k);
+    }
+    std::ostringstream shared_out;
+    shared.print(shared_out);
+    if (shared_out.str() == tree_str(plain))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "ConcurrentBTree shape differs from BTree:" << std::endl
+                  << shared_out.str() << std::endl;
+    }
+
+    // four threads insert their own keys, then remove every other one while the others do the same
+    ConcurrentBTree tree(3);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < 4; w++)
+    {
+        workers.emplace_back([&tree, w]() {
+            for (int k = w; k < 4000; k += 4)
+                tree.insert(k);
+            for (int k = w; k < 4000; k += 8)
+                tree.remove(k);
+        });
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    bool ok = true;
+    for (int k = 0; k < 4000; k++)
+    {
+        ok = ok && tree.contains(k) == (k % 8 >= 4);
+    }
+    if (ok)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect keys after concurrent inserts and removes" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/2 tests in test_concurrent" << std::endl;
+
+    correct += correct_count;
+    total += 2;
+}
+
+void test_snapshot(int &correct, int &total)
+{
+    int correct_count = 0;
+    BTree tree = build_tree("tests/test_3a.txt");
+    BTree plain = build_tree("tests/test_3a.txt");
+    std::string before = tree_str(tree);
+    int batch[] = {1, 3, 4, 9, 11, 13, 15, 26, 100};
+    {
+        // the same batch as test_remove_many, while a snapshot of the tree before the batch is alive
+        BTree::Snapshot snap = tree.snapshot();
+        tree.remove_many(batch);
+        std::string result = tree_str(tree);
+        check_result(result, "results/test_6a.txt", "incorrect result removing keys while a snapshot is alive", correct_count);
+
+        // the snapshot still reads the tree as it was
+        std::ostringstream snap_out;
+        snap.print(snap_out);
+        if (snap_out.str() == before && snap.contains(9) && *snap.begin() == 3)
+        {
+            correct_count += 1;
+        }
+        else
+        {
+            std::cout << "snapshot changed after removes:" << std::endl
+                      << snap_out.str() << std::endl;
+        }
+    }
+
+    // once the snapshot is gone the old versions are freed, the tree holds as many nodes as one that never had a snapshot
+    plain.remove_many(batch);
+    if (tree.node_count() == plain.node_count())
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "tree holds " << tree.node_count() << " nodes after the snapshot was dropped, expected "
+                  << plain.node_count() << std::endl;
+    }
+
+    // a snapshot of a lazy tree copies the tombstones instead of compacting them
+    BTree lazy = build_tree("tests/test_3a.txt");
+    lazy.set_lazy_remove(true);
+    lazy.remove(9);
+    lazy.remove(26);
+    BTree::Snapshot lazy_snap = lazy.snapshot();
+    bool kept = lazy.tombstone_count() == 2;
+    lazy.compact(10);
+    lazy.insert(9);
+    std::vector<int> lazy_keys(lazy_snap.begin(), lazy_snap.end());
+    std::vector<int> expected = {3, 4, 5, 8, 10, 11, 12, 15, 18, 19, 20, 22};
+    if (kept && lazy_keys == expected && !lazy_snap.contains(9) && !lazy_snap.contains(26) && lazy_snap.contains(8))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect snapshot of a tree with tombstones" << std::endl;
+    }
+
+    // and of a buffered tree it copies the pending messages instead of applying them
+    BTree buffered = build_tree("tests/test_3a.txt");
+    buffered.set_buffered(true, 100);
+    buffered.remove(3);
+    buffered.insert(7);
+    BTree::Snapshot buffered_snap = buffered.snapshot();
+    bool pending = buffered.pending_messages() == 2;
+    buffered.flush_messages();
+    buffered.insert(50);
+    std::vector<int> buffered_keys(buffered_snap.begin(), buffered_snap.end());
+    expected = {4, 5, 7, 8, 9, 10, 11, 12, 15, 18, 19, 20, 22, 26};
+    if (pending && buffered_keys == expected && buffered_snap.contains(7) && !buffered_snap.contains(3) &&
+        !buffered_snap.contains(50))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect snapshot of a tree with buffered messages" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/5 tests in test_snapshot" << std::endl;
+
+    correct += correct_count;
+    total += 5;
+}
+
+void test_dump(int &correct, int &total)
+{
+    int correct_count = 0;
+    // the loader format reproduces the input file byte for byte
+    BTree tree = build_tree("tests/test_3a.txt");
+    std::ostringstream text;
+    tree.dump(text, DumpFormat::Loader);
+    if (text.str() == get_result("tests/test_3a.txt"))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect loader dump:" << std::endl
+                  << text.str() << std::endl;
+    }
+
+    // a dump written to a file descriptor loads back into the same tree
+    BTree grown(3);
+    for (int k = 0; k < 500; k++)
+    {
+        grown.insert(k * 37 % 1009);
+    }
+    int fd = open("test_dump.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = fd >= 0 && grown.dump(fd, DumpFormat::Loader);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    BTree loaded = build_tree("test_dump.txt");
+    std::remove("test_dump.txt");
+    if (written && loaded.degree() == 3 && tree_str(loaded) == tree_str(grown))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "tree read back from a dump differs from the original" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/2 tests in test_dump" << std::endl;
+
+    correct += correct_count;
+    total += 2;
+}
+
+void test_stats(int &correct, int &total)
+{
+    int correct_count = 0;
+    // tests/test_3a.txt: t = 2, levels of 1, 2 and 5 nodes holding 14 keys
+    BTree tree = build_tree("tests/test_3a.txt");
+    TreeStats s = tree.stats();
+    if (s.height == 3 && s.nodes == 8 && s.keys == 14 && s.fill[3] == 2 && s.fill[6] == 6)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect tree statistics:" << std::endl;
+        s.print();
+    }
+
+    // the counters only move when the library is built with -DBTREE_STATS
+    reset_op_counters();
+    tree.remove(9);
+    OpCounters ops = op_counters();
+    if (!ops.enabled || (ops.count[REMOVE_CASE_1] == 1 && ops.count[NODES_VISITED] == 3))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect operation counters:" << std::endl;
+        tree.stats().print();
+    }
+
+    std::cout << "Passed " << correct_count << "/2 tests in test_stats" << std::endl;
+
+    correct += correct_count;
+    total += 2;
+}
+
+void test_lazy(int &correct, int &total)
+{
+    int correct_count = 0;
+    BTree tree = build_tree("tests/test_3a.txt");
+    tree.set_lazy_remove(true);
+    tree.remove(9);
+    tree.remove(15);
+    tree.remove(7); // not in the tree
+
+    // the keys are only marked: the nodes keep all 14 keys, reads skip the marked ones
+    std::vector<int> keys(tree.begin(), tree.end());
+    std::vector<int> expected = {3, 4, 5, 8, 10, 11, 12, 18, 19, 20, 22, 26};
+    if (keys == expected && !tree.contains(9) && tree.stats().keys == 14 && tree.tombstone_count() == 2)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect keys after lazy removes" << std::endl;
+    }
+
+    // inserting a marked key clears the mark
+    tree.insert(15);
+    if (tree.contains(15) && tree.tombstone_count() == 1)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "insert did not bring back a lazily removed key" << std::endl;
+    }
+
+    // compaction takes at most budget keys per call
+    size_t left = tree.compact(0);
+    left += tree.compact(5);
+    if (left == 1 && tree.stats().keys == 13 && !tree.contains(9))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect compaction:" << std::endl
+                  << tree_str(tree) << std::endl;
+    }
+
+    // a buffered insert of a tombstoned key is newer than the tombstone, compact keeps the key and applies no message
+    BTree mixed = build_tree("tests/test_3a.txt");
+    mixed.set_lazy_remove(true);
+    mixed.remove(9);
+    mixed.remove(20);
+    mixed.set_buffered(true);
+    mixed.insert(9);
+    mixed.insert(30);
+    left = mixed.compact(10);
+    bool kept = left == 0 && mixed.contains(9) && !mixed.contains(20) && mixed.pending_messages() == 2;
+    mixed.set_buffered(false);
+    std::vector<int> mixed_keys(mixed.begin(), mixed.end());
+    if (kept && mixed_keys == std::vector<int>({3, 4, 5, 8, 9, 10, 11, 12, 15, 18, 19, 22, 26, 30}))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect compaction with a buffered insert of a tombstoned key" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/4 tests in test_lazy" << std::endl;
+
+    correct += correct_count;
+    total += 4;
+}
+
+void test_remove_range(int &correct, int &total)
+{
+    int correct_count = 0;
+    // keys 8 .. 19 span both children of the root: the middle subtrees go whole, the two boundary paths are repaired
+    BTree tree = build_tree("tests/test_3a.txt");
+    size_t removed = tree.remove_range(8, 20);
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_7a.txt", "incorrect result removing the range 8 .. 19", correct_count);
+
+    if (removed == 8)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "remove_range reported " << removed << " removed keys, expected 8" << std::endl;
+    }
+
+    // hi is not removed, like count_range does not count it, a range around every key empties the tree and an empty
+    // range changes nothing
+    size_t none = tree.remove_range(30, 20) + tree.remove_range(22, 22);
+    size_t below_26 = tree.remove_range(22, 26);
+    bool kept_26 = tree.contains(26);
+    removed = tree.remove_range(-100, 100);
+    if (none == 0 && below_26 == 1 && kept_26 && removed == 5 && tree_str(tree).empty())
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result removing every key with one range:" << std::endl
+                  << tree_str(tree) << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_remove_range" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_frozen(int &correct, int &total)
+{
+    int correct_count = 0;
+    BTree tree = build_tree("tests/test_3a.txt");
+    FrozenBTree frozen = tree.freeze();
+    std::vector<int> keys(frozen.keys().begin(), frozen.keys().end());
+    std::vector<int> expected = {3, 4, 5, 8, 9, 10, 11, 12, 15, 18, 19, 20, 22, 26};
+    bool found = frozen.contains(3) && frozen.contains(12) && frozen.contains(26) && !frozen.contains(2) &&
+                 !frozen.contains(13) && !frozen.contains(27);
+    if (keys == expected && found && frozen.lower_bound(13) == 8 && frozen.lower_bound(27) == 14)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result searching a frozen tree" << std::endl;
+    }
+
+    // the saved blocks are read back as they are, a file of another kind is rejected
+    frozen.save("test_frozen.bin");
+    FrozenBTree loaded;
+    bool opened = loaded.load("test_frozen.bin");
+    std::ostringstream errors;
+    std::streambuf *oldBuf = std::cerr.rdbuf(errors.rdbuf());
+    FrozenBTree wrong;
+    bool wrong_opened = wrong.load("tests/test_3a.txt");
+    // a file one block shorter or longer than its header says is rejected before the blocks are read
+    auto saved_bytes = std::filesystem::file_size("test_frozen.bin");
+    std::filesystem::resize_file("test_frozen.bin", saved_bytes - sizeof(FrozenBlock));
+    bool short_opened = wrong.load("test_frozen.bin");
+    std::filesystem::resize_file("test_frozen.bin", saved_bytes + sizeof(FrozenBlock));
+    bool long_opened = wrong.load("test_frozen.bin");
+    std::cerr.rdbuf(oldBuf);
+    std::remove("test_frozen.bin");
+    std::vector<int> loaded_keys(loaded.keys().begin(), loaded.keys().end());
+    bool rejected = !wrong_opened && !short_opened && !long_opened && wrong.size() == 0;
+    if (opened && loaded_keys == expected && loaded.contains(19) && rejected)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result saving and loading a frozen tree" << std::endl;
+    }
+
+    // thawing builds a full tree of the new degree
+    BTree thawed(loaded, 2);
+    std::string result = tree_str(thawed);
+    check_result(result, "results/test_8a.txt", "incorrect result thawing a frozen tree", correct_count);
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_frozen" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_order(int &correct, int &total)
+{
+    int correct_count = 0;
+    // keys of test_3a: 3 4 5 8 9 10 11 12 15 18 19 20 22 26
+    BTree tree = build_tree("tests/test_3a.txt");
+    tree.set_order_stats(true);
+    bool ranks = tree.rank(3) == 0 && tree.rank(12) == 7 && tree.rank(13) == 8 && tree.rank(100) == 14 &&
+                 *tree.select(0) == 3 && *tree.select(7) == 12 && *tree.select(13) == 26 && tree.select(14) == tree.end() &&
+                 tree.count_range(8, 20) == 8 && tree.count_range(20, 8) == 0;
+    if (ranks)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect rank, select or count_range on test_3a" << std::endl;
+    }
+
+    // the counts follow splits, merges, borrows and batch removes, the shape is the same as without them
+    tree.remove(12);
+    tree.remove(4);
+    tree.insert(13);
+    std::vector<int> batch = {8, 9, 10};
+    tree.remove_many(batch);
+    tree.remove_range(19, 21);
+    BTree plain = build_tree("tests/test_3a.txt");
+    plain.remove(12);
+    plain.remove(4);
+    plain.insert(13);
+    plain.remove_many(batch);
+    plain.remove_range(19, 21);
+    // left: 3 5 11 13 15 18 22 26
+    bool updated = tree_str(tree) == tree_str(plain) && tree.rank(15) == 4 && *tree.select(3) == 13 &&
+                   tree.count_range(0, 100) == 8 && tree.count_range(11, 22) == 4;
+    if (updated)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect order statistics after inserts and removes:" << std::endl
+                  << tree_str(tree) << std::endl;
+    }
+
+    // iterating on from select is a range scan by position
+    std::vector<int> page;
+    for (auto it = tree.select(2); it != tree.end() && page.size() < 3; ++it)
+    {
+        page.push_back(*it);
+    }
+    if (page == std::vector<int>({11, 13, 15}))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect keys after select(2)" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_order" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_paged(int &correct, int &total)
+{
+    int correct_count = 0;
+    // a pool of 4 pages is far smaller than the tree, so pages are evicted and read back all the time
+    std::remove("test_paged.bin");
+    std::string expected;
+    std::string result;
+    {
+        PagedBTree paged("test_paged.bin", 2, 4);
+        BTree tree(2);
+        for (int i = 0; i < 200; i++)
+        {
+            paged.insert(i * 37 % 211);
+            tree.insert(i * 37 % 211);
+        }
+        for (int i = 0; i < 200; i += 3)
+        {
+            paged.remove(i * 37 % 211);
+            tree.remove(i * 37 % 211);
+        }
+        expected = tree_str(tree);
+        result = tree_str(paged);
+        BufferPoolStats stats = paged.stats();
+        if (result == expected && stats.evictions > 0 && stats.writes > 0 && stats.frames == 4)
+        {
+            correct_count += 1;
+        }
+        else
+        {
+            std::cout << "paged tree differs from the in-memory tree after the same inserts and removes" << std::endl;
+            stats.print();
+        }
+    }
+
+    // the destructor flushed, reopening reads the same tree back (the degree comes from the file)
+    PagedBTree reopened("test_paged.bin", 3, 4);
+    result = tree_str(reopened);
+    bool found = reopened.contains(37) && !reopened.contains(0) && !reopened.contains(211);
+    if (reopened.degree() == 2 && result == expected && found && reopened.stats().reads > 0)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect paged tree after reopening the file" << std::endl;
+    }
+
+    // removing every key frees every page, new pages come from the free list instead of growing the file
+    for (int i = 0; i < 211; i++)
+    {
+        reopened.remove(i);
+    }
+    reopened.insert(5);
+    reopened.flush();
+    auto size_before = std::filesystem::file_size("test_paged.bin");
+    for (int i = 0; i < 100; i++)
+    {
+        reopened.insert(i);
+    }
+    reopened.flush();
+    auto size_after = std::filesystem::file_size("test_paged.bin");
+    if (reopened.contains(5) && reopened.contains(99) && size_after == size_before)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "paged tree did not reuse freed pages" << std::endl;
+    }
+    std::remove("test_paged.bin");
+
+    // a root link past the end of the file: the page cannot be read, so every operation stops and nothing is written
+    std::remove("test_paged_bad.bin");
+    {
+        PagedBTree bad("test_paged_bad.bin", 2, 4);
+        for (int i = 0; i < 50; i++)
+        {
+            bad.insert(i);
+        }
+    }
+    PagedHeader header;
+    std::fstream file("test_paged_bad.bin", std::ios::in | std::ios::out | std::ios::binary);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    header.root = header.page_count + 10;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    auto bad_size = std::filesystem::file_size("test_paged_bad.bin");
+    bool stopped;
+    {
+        PagedBTree bad("test_paged_bad.bin", 2, 4);
+        bool opened = bad.is_open();
+        bad.insert(60);
+        bad.remove(7);
+        stopped = opened && !bad.is_open() && !bad.contains(7) && !bad.flush();
+    }
+    if (stopped && std::filesystem::file_size("test_paged_bad.bin") == bad_size)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "paged tree kept going after a page could not be read" << std::endl;
+    }
+    std::remove("test_paged_bad.bin");
+
+    std::cout << "Passed " << correct_count << "/4 tests in test_paged" << std::endl;
+
+    correct += correct_count;
+    total += 4;
+}
+
+void test_buffered(int &correct, int &total)
+{
+    int correct_count = 0;
+    BTree tree = build_tree("tests/test_3a.txt");
+    tree.set_buffered(true, 2);
+
+    // the third message overflows the root's buffer: 7 and 9 go down to the buffer of the node [5], no key moves
+    tree.remove(9);
+    tree.remove(15);
+    tree.insert(7);
+    bool reads = tree.contains(7) && !tree.contains(9) && !tree.contains(15) && tree.contains(12);
+    if (reads && tree.pending_messages() == 3 && tree.stats().keys == 14)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect buffers after three updates" << std::endl;
+    }
+
+    // 1 and 2 fill the buffer of [5] past 2 as well, the leaf [3,4] takes both and splits on the way
+    tree.insert(1);
+    tree.insert(2);
+    reads = tree.contains(1) && tree.contains(2) && tree.contains(7) && !tree.contains(9) && !tree.contains(15);
+    if (reads && tree.pending_messages() == 3 && tree.stats().keys == 16)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect flush into a leaf:" << std::endl
+                  << tree.pending_messages() << " messages pending" << std::endl;
+    }
+
+    // scans both ways merge the pending messages into the node keys and apply none of them
+    std::vector<int> keys(tree.begin(), tree.end());
+    std::vector<int> expected = {1, 2, 3, 4, 5, 7, 8, 10, 11, 12, 18, 19, 20, 22, 26};
+    std::vector<int> backward;
+    BTree::Cursor cur(tree);
+    for (bool ok = cur.seek_last(); ok; ok = cur.prev())
+    {
+        backward.push_back(cur.key());
+    }
+    std::reverse(backward.begin(), backward.end());
+    bool bounds = *tree.lower_bound(6) == 7 && *tree.lower_bound(9) == 10 && tree.lower_bound(27) == tree.end();
+    if (keys == expected && backward == expected && bounds && tree.pending_messages() == 3)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect keys scanned with messages pending" << std::endl;
+    }
+
+    // lookup_many reads the messages like contains
+    std::vector<int> probes = {7, 9, 15, 1, 12, 30};
+    bool found[6];
+    tree.lookup_many(probes, found);
+    bool lookups = found[0] && !found[1] && !found[2] && found[3] && found[4] && !found[5];
+    if (lookups && tree.pending_messages() == 3)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect lookup_many with messages pending" << std::endl;
+    }
+
+    tree.flush_messages();
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_9a.txt", "incorrect result after buffered updates", correct_count);
+
+    std::cout << "Passed " << correct_count << "/5 tests in test_buffered" << std::endl;
+
+    correct += correct_count;
+    total += 5;
+}
+
+void test_bulk_load(int &correct, int &total)
+{
+    int correct_count = 0;
+    std::vector<int> sorted;
+    for (int k = 1; k <= 20; k++)
+    {
+        sorted.push_back(k);
+    }
+
+    // full nodes: six leaves of 3 or 2 keys under two parents
+    BTree tree(2);
+    tree.bulk_load(sorted);
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_10a.txt", "incorrect result bulk loading 1 .. 20 into full nodes", correct_count);
+
+    // half full: seven leaves of 2 keys, every internal node between 2 and 3 children
+    tree.bulk_load(sorted, 0.5);
+    result = tree_str(tree);
+    check_result(result, "results/test_10b.txt", "incorrect result bulk loading 1 .. 20 half full", correct_count);
+
+    // keys that are not strictly ascending are refused and the tree keeps its keys
+    std::vector<int> unsorted = {1, 3, 2};
+    bool refused = !tree.bulk_load(unsorted) && tree.contains(20) && !tree.contains(21);
+    tree.insert(21);
+    tree.remove(10);
+    if (refused && tree.contains(21) && !tree.contains(10))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect bulk load of unsorted keys or update after a bulk load" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_bulk_load" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_values(int &correct, int &total)
+{
+    int correct_count = 0;
+
+    // values ride along with their keys: same shape as a tree of plain keys, every key finds its own value
+    FixedBTree<int, 2, std::string> named;
+    BTree plain(2);
+    for (int k = 1; k <= 40; k++)
+    {
+        named.insert(k * 7 % 41, "v" + std::to_string(k * 7 % 41));
+        plain.insert(k * 7 % 41);
+    }
+    for (int k = 3; k <= 40; k += 3)
+    {
+        named.remove(k);
+        plain.remove(k);
+    }
+    named.insert(7, "seven");
+    bool values_ok = tree_str(named) == tree_str(plain) && *named.find(7) == "seven" && named.find(9) == nullptr;
+    for (int k = 1; k <= 40; k++)
+    {
+        if (k % 3 != 0 && k != 7 && (named.find(k) == nullptr || *named.find(k) != "v" + std::to_string(k)))
+        {
+            values_ok = false;
+        }
+    }
+    if (values_ok)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect values after inserts and removes with a value type" << std::endl;
+    }
+
+    // move-only values inline, and a value too big for the node that is kept behind a pointer
+    static_assert(!ValueSlot<std::array<int, 16>>::INLINE, "a 64 byte value should be stored out of line");
+    FixedBTree<int, 2, std::unique_ptr<int>> owned;
+    FixedBTree<int, 2, std::array<int, 16>> big;
+    for (int k = 1; k <= 30; k++)
+    {
+        owned.insert(k, std::make_unique<int>(k * 10));
+        std::array<int, 16> row;
+        row.fill(k);
+        big.insert(k, row);
+    }
+    for (int k = 2; k <= 30; k += 2)
+    {
+        owned.remove(k);
+        big.remove(k);
+    }
+    bool moved_ok = true;
+    for (int k = 1; k <= 30; k++)
+    {
+        bool kept = k % 2 == 1;
+        std::unique_ptr<int> *p = owned.find(k);
+        std::array<int, 16> *row = big.find(k);
+        if (kept != (p != nullptr) || kept != (row != nullptr) || (kept && (**p != k * 10 || (*row)[15] != k)))
+        {
+            moved_ok = false;
+        }
+    }
+    if (moved_ok)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect move-only or out of line values" << std::endl;
+    }
+
+    // string keys that share their first 8 bytes, found through borrowed views
+    FixedBTree<PrefixKey, 2, int> paths;
+    std::vector<std::string> names;
+    for (int k = 0; k < 40; k++)
+    {
+        names.push_back("/usr/lib/" + std::to_string(1000 + k * 17 % 40));
+    }
+    names.push_back("/usr/li");
+    names.push_back(std::string("/usr/lib\0", 9));
+    for (size_t k = 0; k < names.size(); k++)
+    {
+        paths.insert(PrefixKey(names[k]), (int)k);
+    }
+    for (size_t k = 0; k < names.size(); k += 2)
+    {
+        paths.remove(PrefixKey::view(names[k]));
+    }
+    bool keys_ok = !paths.contains(PrefixKey::view("/usr/lib")) && !paths.contains(PrefixKey::view("/usr/lib/10"));
+    for (size_t k = 0; k < names.size(); k++)
+    {
+        int *v = paths.find(PrefixKey::view(names[k]));
+        if ((k % 2 == 1) != (v != nullptr) || (v && *v != (int)k))
+        {
+            keys_ok = false;
+        }
+    }
+    if (keys_ok && PrefixKey(names[1]).str() == names[1] && PrefixKey("/usr/li").str() == "/usr/li")
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect lookups with string keys" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_values" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
+void test_delete_policy(int &correct, int &total)
+{
+    int correct_count = 0;
+
+    // a miss changes nothing: strict CLRS would already borrow into [5] on the way down
+    BTree tree = build_tree("tests/test_3a.txt");
+    tree.set_delete_policy(DeletePolicy::MergeAtEmpty);
+    std::string before = tree_str(tree);
+    tree.remove(7);
+    if (tree_str(tree) == before)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result removing a missing key under a relaxed policy" << std::endl;
+    }
+
+    // 8 leaves [9] alone, 9 empties the leaf (borrow from the left), 3 empties [3] (merge, then the parent
+    // runs empty and borrows from the root's right child)
+    tree.remove(8);
+    tree.remove(9);
+    tree.remove(3);
+    std::string result = tree_str(tree);
+    check_result(result, "results/test_11a.txt", "incorrect result in merge at empty removes", correct_count);
+
+    // sparse subtrees are rebuilt packed once their nodes are less than half full on average
+    BTree rebuilt(3);
+    BTree sparse(3);
+    for (int k = 1; k <= 400; k++)
+    {
+        rebuilt.insert(k);
+        sparse.insert(k);
+    }
+    rebuilt.set_delete_policy(DeletePolicy::MinFill, 1, 0.5);
+    sparse.set_delete_policy(DeletePolicy::MinFill, 1);
+    for (int k = 1; k <= 400; k++)
+    {
+        if (k % 9 != 0)
+        {
+            rebuilt.remove(k);
+            sparse.remove(k);
+        }
+    }
+    std::vector<int> kept(rebuilt.begin(), rebuilt.end());
+    bool kept_ok = kept.size() == 44 && kept.front() == 9 && kept.back() == 396;
+    if (kept_ok && rebuilt.rebuild_count() > 0 && rebuilt.stats().nodes < sparse.stats().nodes)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect rebuild of sparse subtrees" << std::endl;
+    }
+
+    // back to strict: every node but the root holds t-1 = 2 keys again (fill[2]: nodes with 1 of 5 keys)
+    sparse.set_delete_policy(DeletePolicy::Strict);
+    TreeStats s = sparse.stats();
+    std::vector<int> strict_keys(sparse.begin(), sparse.end());
+    if (s.fill[0] == 0 && s.fill[2] <= 1 && strict_keys == kept)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect fill up when switching back to the strict policy" << std::endl;
+        s.print();
+    }
+
+    // a relaxed tree saved as an image or dumped as text is filled up again when it is read back, so the strict
+    // removes of the tree that reads it find every node with t-1 keys
+    BTree relaxed(3);
+    for (int k = 0; k < 200; k++)
+    {
+        relaxed.insert(k);
+    }
+    relaxed.set_delete_policy(DeletePolicy::MergeAtEmpty);
+    std::vector<int> expected;
+    for (int k = 0; k < 200; k++)
+    {
+        if (k % 4 != 0)
+        {
+            relaxed.remove(k);
+        }
+        else if (k % 8 != 0)
+        {
+            expected.push_back(k);
+        }
+    }
+    relaxed.save_image("test_relaxed.bin");
+    std::ofstream text("test_relaxed.txt");
+    relaxed.dump(text, DumpFormat::Loader);
+    text.close();
+    BTree opened(3);
+    bool mapped = opened.open_image("test_relaxed.bin");
+    BTree loaded = build_tree("test_relaxed.txt");
+    std::remove("test_relaxed.bin");
+    std::remove("test_relaxed.txt");
+    for (BTree *persisted : {&opened, &loaded})
+    {
+        for (int k = 0; k < 200; k += 8)
+        {
+            persisted->remove(k);
+            persisted->remove(k + 1); // already gone
+        }
+        std::vector<int> left(persisted->begin(), persisted->end());
+        TreeStats filled = persisted->stats();
+        if ((persisted != &opened || mapped) && left == expected && filled.fill[0] == 0 && filled.fill[2] <= 1)
+        {
+            correct_count += 1;
+        }
+        else
+        {
+            std::cout << "incorrect removes from a relaxed tree read back from " << (persisted == &opened ? "an image" : "a dump")
+                      << std::endl;
+        }
+    }
+
+    std::cout << "Passed " << correct_count << "/6 tests in test_delete_policy" << std::endl;
+
+    correct += correct_count;
+    total += 6;
+}
+
+void test_split_join(int &correct, int &total)
+{
+    int correct_count = 0;
+
+    // 12 sits in the leaf [11,12]: the path is cut in two and each side glued back into a valid tree
+    BTree tree = build_tree("tests/test_3a.txt");
+    BTree upper = tree.split_at(12);
+    check_result(tree_str(tree), "results/test_12a.txt", "incorrect keys below the split", correct_count);
+    check_result(tree_str(upper), "results/test_12b.txt", "incorrect keys from the split up", correct_count);
+
+    // joining them again takes 12 out of the right tree to glue the two roots
+    BTree::join(tree, upper);
+    check_result(tree_str(tree), "results/test_12c.txt", "incorrect join of the two halves", correct_count);
+
+    // larger trees with order statistics: a snapshot keeps the old keys, an overlapping join is refused,
+    // a join of trees of different heights keeps every count right, and no node is lost on the way
+    BTree big(3);
+    big.set_order_stats(true);
+    for (int k = 1; k <= 1000; k++)
+    {
+        big.insert(k);
+    }
+    BTree::Snapshot before = big.snapshot();
+    BTree high = big.split_at(401);
+    BTree low(3);
+    low.set_order_stats(true);
+    for (int k = -50; k <= 0; k++)
+    {
+        low.insert(k);
+    }
+    bool refused = !BTree::join(high, big);
+    bool joined = BTree::join(low, big) && BTree::join(low, high);
+    std::vector<int> keys(low.begin(), low.end());
+    std::vector<int> old_keys(before.begin(), before.end());
+    bool ranks = low.rank(1) == 51 && low.rank(401) == 451 && low.count_range(300, 700) == 400;
+    if (refused && joined && keys.size() == 1051 && keys.front() == -50 && keys.back() == 1000 &&
+        std::is_sorted(keys.begin(), keys.end()) && old_keys.size() == 1000 && ranks && big.node_count() == 0 &&
+        high.node_count() == 0)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect split and join of large trees" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/4 tests in test_split_join" << std::endl;
+
+    correct += correct_count;
+    total += 4;
+}
+
+void test_compact_nodes(int &correct, int &total)
+{
+    int correct_count = 0;
+
+    // a leaf has no child pointers, so splitting the only leaf adds an internal block larger than a leaf's
+    BTree tree(16);
+    for (int k = 1; k <= 31; k++)
+    {
+        tree.insert(k);
+    }
+    TreeStats one = tree.stats();
+    tree.insert(32);
+    TreeStats split = tree.stats();
+    TreeStats loaded = BTree("tests/test_3a.txt").stats();
+    if (one.leaves == 1 && split.leaves == 2 && split.nodes == 3 &&
+        split.node_bytes - 2 * one.node_bytes > one.node_bytes && loaded.leaves == 5 && loaded.nodes == 8)
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result sizing leaf and internal node blocks" << std::endl;
+    }
+
+    // keys 3 apart pack into 1 byte each, keys 100000 apart would not get smaller and stay plain
+    std::vector<int> keys;
+    std::vector<int> sparse;
+    for (int i = 0; i < 10000; i++)
+    {
+        keys.push_back(3 * i);
+        sparse.push_back(100000 * i);
+    }
+    FrozenBTree plain(keys);
+    FrozenBTree packed(keys, FrozenEncoding::FrameOfReference);
+    FrozenBTree spread(sparse, FrozenEncoding::FrameOfReference);
+    bool same = true;
+    for (int k = -1; k <= 30001; k++)
+    {
+        same = same && packed.lower_bound(k) == plain.lower_bound(k) && packed.contains(k) == plain.contains(k);
+    }
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        same = same && packed.key(i) == keys[i];
+    }
+    if (same && packed.key_encoding() == FrozenEncoding::FrameOfReference && packed.keys().empty() &&
+        2 * packed.bytes() < plain.bytes() && spread.key_encoding() == FrozenEncoding::Plain && spread.contains(500000))
+    {
+        correct_count += 1;
+    }
+    else
+    {
+        std::cout << "incorrect result searching frame of reference keys" << std::endl;
+    }
+
+    // packed keys are saved as plain blocks, thawing decodes them
+    packed.save("test_compact.bin");
+    FrozenBTree reloaded;
+    bool opened = reloaded.load("test_compact.bin");
+    std::remove("test_compact.bin");
+    std::vector<int> reloaded_keys(reloaded.keys().begin(), reloaded.keys().end());
+    BTree small = build_tree("tests/test_3a.txt");
+    BTree thawed(small.freeze(FrozenEncoding::FrameOfReference), 2);
+    std::string result = tree_str(thawed);
+    if (opened && reloaded_keys == keys)
+    {
+        check_result(result, "results/test_8a.txt", "incorrect result thawing frame of reference keys", correct_count);
+    }
+    else
+    {
+        std::cout << "incorrect result saving frame of reference keys" << std::endl;
+    }
+
+    std::cout << "Passed " << correct_count << "/3 tests in test_compact_nodes" << std::endl;
+
+    correct += correct_count;
+    total += 3;
+}
+
 int main()
 {
     int all_passed = 0;
@@ -185,6 +1609,28 @@ int main()
     test_2c(all_passed, all_total);
     test_3a(all_passed, all_total);
     test_3b(all_passed, all_total);
+    test_insert(all_passed, all_total);
+    test_lookup(all_passed, all_total);
+    test_cursor(all_passed, all_total);
+    test_fixed(all_passed, all_total);
+    test_image(all_passed, all_total);
+    test_load(all_passed, all_total);
+    test_remove_many(all_passed, all_total);
+    test_concurrent(all_passed, all_total);
+    test_snapshot(all_passed, all_total);
+    test_dump(all_passed, all_total);
+    test_stats(all_passed, all_total);
+    test_lazy(all_passed, all_total);
+    test_remove_range(all_passed, all_total);
+    test_frozen(all_passed, all_total);
+    test_order(all_passed, all_total);
+    test_paged(all_passed, all_total);
+    test_buffered(all_passed, all_total);
+    test_bulk_load(all_passed, all_total);
+    test_values(all_passed, all_total);
+    test_delete_policy(all_passed, all_total);
+    test_split_join(all_passed, all_total);
+    test_compact_nodes(all_passed, all_total);
 
     std::cout << "\nPassed a total of " << all_passed << "/" << all_total << " tests." << std::endl;
 